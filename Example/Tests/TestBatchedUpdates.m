@@ -0,0 +1,144 @@
+//
+//  TestBatchedUpdates.m
+//  Panopticon Example
+//
+//  Created by Pierre Houston on 2016-05-29.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+@import XCTest;
+#import <Panopticon/Panopticon.h>
+#import "ModelObject.h"
+
+@interface TestBatchedUpdates : XCTestCase
+@property (nonatomic) ModelObject *modelObject;
+@end
+
+@implementation TestBatchedUpdates
+
+- (void)setUp
+{
+    [super setUp];
+    self.modelObject = [[ModelObject alloc] init];
+    self.modelObject.name = @"first";
+}
+
+- (void)testSettingsDeliveredOnceWithNetChange
+{
+    NSUInteger __block callCount = 0;
+    id __block oldValue = nil, newValue = nil;
+    PANKeyValueObservation *observation = [self pan_observeForChanges:self.modelObject toKeyPath:@"name" options:NSKeyValueObservingOptionNew | NSKeyValueObservingOptionOld withBlock:^(id obj, PANObservation *obs) {
+        callCount++;
+        oldValue = ((PANKeyValueObservation *)obs).oldValue;
+        newValue = ((PANKeyValueObservation *)obs).changedValue;
+    }];
+    
+    [Panopticon performBatchedUpdates:^{
+        for (NSUInteger i = 0; i < 1000; i++)
+            self.modelObject.name = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+        XCTAssertEqual(callCount, 0);
+    }];
+    
+    XCTAssertEqual(callCount, 1);
+    XCTAssertEqualObjects(oldValue, @"first");
+    XCTAssertEqualObjects(newValue, @"999");
+    [observation remove];
+}
+
+- (void)testSeveralKeyPathsDeliveredOnceCollated
+{
+    NSUInteger __block callCount = 0;
+    NSArray * __block collated = nil;
+    PANKeyValueObservation *observation = [self pan_observeForChanges:self.modelObject toKeyPaths:@[@"name", @"flag"] withBlock:^(id obj, PANObservation *obs) {
+        callCount++;
+        collated = obs.collated;
+    }];
+    
+    [Panopticon performBatchedUpdates:^{
+        [Panopticon performBatchedUpdates:^{
+            self.modelObject.flag = YES;
+        }];
+        XCTAssertEqual(callCount, 0); // nested, delivered when the outermost ends
+        self.modelObject.name = @"second";
+        self.modelObject.flag = NO;
+    }];
+    
+    XCTAssertEqual(callCount, 1);
+    XCTAssertEqual(collated.count, 2);
+    XCTAssertEqualObjects([collated valueForKey:@"keyPath"], (@[@"flag", @"name"]));
+    [observation remove];
+}
+
+- (void)testChangesDeliveredWhenBatchRaises
+{
+    NSUInteger __block callCount = 0;
+    id __block newValue = nil;
+    PANKeyValueObservation *observation = [self pan_observeForChanges:self.modelObject toKeyPath:@"name" options:NSKeyValueObservingOptionNew withBlock:^(id obj, PANObservation *obs) {
+        callCount++;
+        newValue = ((PANKeyValueObservation *)obs).changedValue;
+    }];
+    
+    XCTAssertThrows([Panopticon performBatchedUpdates:^{
+        self.modelObject.name = @"second";
+        [NSException raise:NSInternalInconsistencyException format:@"failed part way"];
+        self.modelObject.name = @"third";
+    }]);
+    
+    XCTAssertEqual(callCount, 1);
+    XCTAssertEqualObjects(newValue, @"second");
+    self.modelObject.name = @"fourth"; // no longer part of a transaction
+    XCTAssertEqual(callCount, 2);
+    [observation remove];
+}
+
+- (void)testBatchDeliveredAsSnapshotOnQueue
+{
+    dispatch_queue_t queue = dispatch_queue_create("TestBatchedUpdates", DISPATCH_QUEUE_SERIAL);
+    XCTestExpectation *expectation = [self expectationWithDescription:@"batch delivered"];
+    NSArray * __block collated = nil;
+    PANObservation * __block delivered = nil;
+    PANKeyValueObservation *observation = [self pan_observeForChanges:self.modelObject toKeyPaths:@[@"name", @"flag"] options:0 onGCDQueue:queue initiallyPaused:NO withBlock:^(id obj, PANObservation *obs) {
+        collated = obs.collated;
+        delivered = obs;
+        [obs keepSnapshot];
+        [expectation fulfill];
+    }];
+    observation.deliversSnapshots = YES;
+    
+    [Panopticon performBatchedUpdates:^{
+        self.modelObject.name = @"second";
+        self.modelObject.flag = YES;
+    }];
+    
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    XCTAssertEqual(collated.count, 2);
+    XCTAssertNotEqual(delivered, observation);
+    XCTAssertNil(observation.collated);
+    [observation remove];
+}
+
+- (void)testObjectReleasedDuringBatchKeptUntilDelivered
+{
+    ModelObject * __weak weakObject = self.modelObject;
+    NSUInteger __block callCount = 0;
+    id __block changedObject = nil;
+    PANKeyValueObservation *observation = [self pan_observeForChanges:self.modelObject toKeyPath:@"name" withBlock:^(id obj, PANObservation *obs) {
+        callCount++;
+        changedObject = ((PANKeyValueObservation *)obs).object;
+    }];
+    
+    @autoreleasepool {
+        [Panopticon performBatchedUpdates:^{
+            self.modelObject.name = @"second";
+            self.modelObject = nil;
+            XCTAssertNotNil(weakObject); // retained by the transaction
+        }];
+    }
+    
+    XCTAssertEqual(callCount, 1);
+    XCTAssertNotNil(changedObject);
+    XCTAssertEqual(changedObject, weakObject);
+    [observation remove];
+}
+
+@end
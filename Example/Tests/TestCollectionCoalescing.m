@@ -0,0 +1,98 @@
+//
+//  TestCollectionCoalescing.m
+//  Panopticon Example
+//
+//  Created by Pierre Houston on 2016-05-28.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+@import XCTest;
+#import <Panopticon/Panopticon.h>
+
+@interface CollectionOwner : NSObject
+@property (nonatomic) NSMutableArray *items;
+@end
+
+@implementation CollectionOwner
+
+// indexed accessors so that mutableArrayValueForKey: sends insertion, removal & replacement changes
+- (void)insertObject:(id)object inItemsAtIndex:(NSUInteger)index
+{
+    [self.items insertObject:object atIndex:index];
+}
+
+- (void)removeObjectFromItemsAtIndex:(NSUInteger)index
+{
+    [self.items removeObjectAtIndex:index];
+}
+
+- (void)replaceObjectInItemsAtIndex:(NSUInteger)index withObject:(id)object
+{
+    [self.items replaceObjectAtIndex:index withObject:object];
+}
+
+@end
+
+
+@interface TestCollectionCoalescing : XCTestCase
+@property (nonatomic) CollectionOwner *owner;
+@end
+
+@implementation TestCollectionCoalescing
+
+- (void)setUp
+{
+    [super setUp];
+    self.owner = [[CollectionOwner alloc] init];
+    self.owner.items = [NSMutableArray arrayWithObjects:@"a", @"b", @"c", nil];
+}
+
+- (void)testPausedChangesMergeIntoNetDiff
+{
+    NSArray * __block collated = nil;
+    PANKeyValueObservation *observation = [self pan_observeForChanges:self.owner toKeyPath:@"items" options:NSKeyValueObservingOptionNew | NSKeyValueObservingOptionOld initiallyPaused:YES withBlock:^(id obj, PANObservation *obs) {
+        collated = obs.collated;
+    }];
+    observation.coalescesCollectionChanges = YES;
+    
+    NSMutableArray *items = [self.owner mutableArrayValueForKey:@"items"];
+    [items insertObject:@"x" atIndex:0]; // x a b c
+    [items removeObjectAtIndex:2];        // x a c
+    [items replaceObjectAtIndex:1 withObject:@"y"]; // x y c
+    [items insertObject:@"z" atIndex:3]; // x y c z
+    [items removeObjectAtIndex:0];        // y c z
+    
+    observation.paused = NO;
+    XCTAssertEqual(collated.count, 1);
+    id<PANKeyValueChange> change = collated.firstObject;
+    XCTAssertEqual(change.mergedChangeCount, 5);
+    XCTAssertEqualObjects(change.insertedIndexes, [NSIndexSet indexSetWithIndex:2]);
+    XCTAssertEqualObjects(change.insertedValues, @[@"z"]);
+    XCTAssertEqualObjects(change.removedIndexes, [NSIndexSet indexSetWithIndex:1]);
+    XCTAssertEqualObjects(change.removedValues, @[@"b"]);
+    XCTAssertEqualObjects(change.replacedIndexes, [NSIndexSet indexSetWithIndex:0]);
+    [observation remove];
+}
+
+- (void)testSettingStopsMerging
+{
+    NSArray * __block collated = nil;
+    PANKeyValueObservation *observation = [self pan_observeForChanges:self.owner toKeyPath:@"items" initiallyPaused:YES withBlock:^(id obj, PANObservation *obs) {
+        collated = obs.collated;
+    }];
+    observation.coalescesCollectionChanges = YES;
+    
+    NSMutableArray *items = [self.owner mutableArrayValueForKey:@"items"];
+    [items addObject:@"d"];
+    [items addObject:@"e"];
+    self.owner.items = [NSMutableArray array];
+    [items addObject:@"f"];
+    
+    observation.paused = NO;
+    XCTAssertEqual(collated.count, 3);
+    XCTAssertEqual(((id<PANKeyValueChange>)collated[0]).mergedChangeCount, 2);
+    XCTAssertNil(((id<PANKeyValueChange>)collated[1]).insertedIndexes);
+    [observation remove];
+}
+
+@end
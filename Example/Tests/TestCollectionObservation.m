@@ -0,0 +1,162 @@
+//
+//  TestCollectionObservation.m
+//  Panopticon Example
+//
+//  Created by Pierre Houston on 2016-05-29.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+@import XCTest;
+#import <Panopticon/Panopticon.h>
+
+@interface InventoryItem : NSObject
+@property (nonatomic) NSInteger price;
+@end
+
+@implementation InventoryItem
+@end
+
+@interface Inventory : NSObject
+@property (nonatomic) NSMutableArray *items;
+@end
+
+@implementation Inventory
+
+// indexed accessors so that mutableArrayValueForKey: sends insertion, removal & replacement changes
+- (void)insertObject:(id)object inItemsAtIndex:(NSUInteger)index
+{
+    [self.items insertObject:object atIndex:index];
+}
+
+- (void)removeObjectFromItemsAtIndex:(NSUInteger)index
+{
+    [self.items removeObjectAtIndex:index];
+}
+
+- (void)replaceObjectInItemsAtIndex:(NSUInteger)index withObject:(id)object
+{
+    [self.items replaceObjectAtIndex:index withObject:object];
+}
+
+@end
+
+
+@interface TestCollectionObservation : XCTestCase
+@property (nonatomic) Inventory *inventory;
+@property (nonatomic) NSMutableArray *changes;
+@property (nonatomic) PANKeyValueCollectionObservation *observation;
+@end
+
+@implementation TestCollectionObservation
+
+- (void)setUp
+{
+    [super setUp];
+    self.inventory = [[Inventory alloc] init];
+    self.inventory.items = [NSMutableArray arrayWithObjects:[[InventoryItem alloc] init], [[InventoryItem alloc] init], nil];
+    self.changes = [NSMutableArray array];
+    NSMutableArray *changes = self.changes;
+    self.observation = [self pan_observeForChanges:self.inventory toCollectionKeyPath:@"items" elementKeyPaths:@[@"price"] withBlock:^(id obj, PANObservation *obs) {
+        PANKeyValueCollectionObservation *collectionObservation = (PANKeyValueCollectionObservation *)obs;
+        [changes addObject:@[collectionObservation.keyPath, @(collectionObservation.elementIndex)]];
+    }];
+}
+
+- (void)tearDown
+{
+    [self.observation remove];
+    [super tearDown];
+}
+
+- (void)testStoppedThroughKeyValueObservationMethod
+{
+    XCTAssertTrue([self pan_stopObservingForChanges:self.inventory toKeyPath:@"items"]);
+    XCTAssertFalse(self.observation.registered);
+    ((InventoryItem *)self.inventory.items[1]).price = 5;
+    XCTAssertEqual(self.changes.count, 0);
+}
+
+- (void)testElementChangeReportsIndex
+{
+    ((InventoryItem *)self.inventory.items[1]).price = 5;
+    XCTAssertEqualObjects(self.changes, (@[@[@"price", @1]]));
+}
+
+- (void)testInsertedElementIsObserved
+{
+    InventoryItem *item = [[InventoryItem alloc] init];
+    [[self.inventory mutableArrayValueForKey:@"items"] insertObject:item atIndex:0];
+    item.price = 3;
+    XCTAssertEqualObjects(self.changes, (@[@[@"items", @(NSNotFound)], @[@"price", @0]]));
+    XCTAssertEqual(self.observation.elements.count, 3);
+}
+
+- (void)testRemovedElementIsNoLongerObserved
+{
+    InventoryItem *item = self.inventory.items[0];
+    [[self.inventory mutableArrayValueForKey:@"items"] removeObjectAtIndex:0];
+    item.price = 3;
+    ((InventoryItem *)self.inventory.items[0]).price = 4;
+    XCTAssertEqualObjects(self.changes, (@[@[@"items", @(NSNotFound)], @[@"price", @0]]));
+}
+
+- (void)testReplacingCollectionObservesNewElements
+{
+    InventoryItem *oldItem = self.inventory.items[0];
+    InventoryItem *newItem = [[InventoryItem alloc] init];
+    self.inventory.items = [NSMutableArray arrayWithObjects:oldItem, newItem, nil];
+    newItem.price = 1;
+    oldItem.price = 2;
+    XCTAssertEqualObjects(self.changes, (@[@[@"items", @(NSNotFound)], @[@"price", @1], @[@"price", @0]]));
+}
+
+- (void)testReplacedElementReportsIndex
+{
+    InventoryItem *item = [[InventoryItem alloc] init];
+    [[self.inventory mutableArrayValueForKey:@"items"] replaceObjectAtIndex:0 withObject:item];
+    ((InventoryItem *)self.inventory.items[1]).price = 2;
+    item.price = 3;
+    XCTAssertEqualObjects(self.changes, (@[@[@"items", @(NSNotFound)], @[@"price", @1], @[@"price", @0]]));
+}
+
+- (void)testRepeatedElementReportsAllIndexes
+{
+    InventoryItem *item = self.inventory.items[0];
+    [[self.inventory mutableArrayValueForKey:@"items"] insertObject:item atIndex:2];
+    __block NSIndexSet *elementIndexes = nil;
+    PANKeyValueCollectionObservation *observation = [self pan_observeForChanges:self.inventory toCollectionKeyPath:@"items" elementKeyPaths:@[@"price"] withBlock:^(id obj, PANObservation *obs) {
+        elementIndexes = ((PANKeyValueCollectionObservation *)obs).elementIndexes;
+    }];
+    item.price = 3;
+    [observation remove];
+    XCTAssertEqual(elementIndexes.count, 2);
+    XCTAssertTrue([elementIndexes containsIndex:0] && [elementIndexes containsIndex:2]);
+    XCTAssertEqualObjects(self.changes.lastObject, (@[@"price", @0]));
+}
+
+
+- (void)testIndexesFollowInterleavedInsertionsAndRemovals
+{
+    // each element change looks the index up, so the insertions & removals between them shift a map that's in use
+    InventoryItem *first = self.inventory.items[0];
+    InventoryItem *second = self.inventory.items[1];
+    NSMutableArray *items = [self.inventory mutableArrayValueForKey:@"items"];
+    second.price = 1;
+    [items insertObject:[[InventoryItem alloc] init] atIndex:0];
+    second.price = 2;
+    [items insertObject:second atIndex:1];
+    first.price = 3;
+    [items removeObjectAtIndex:0];
+    second.price = 4;
+    [items removeObjectAtIndex:1];
+    second.price = 5;
+    NSMutableArray *elementChanges = [NSMutableArray array];
+    for (NSArray *change in self.changes) {
+        if ([change.firstObject isEqualToString:@"price"])
+            [elementChanges addObject:change.lastObject];
+    }
+    XCTAssertEqualObjects(elementChanges, (@[@1, @2, @2, @0, @0]));
+    XCTAssertEqualObjects(self.observation.elementIndexes, [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, 2)]);
+}
+
+@end
@@ -0,0 +1,106 @@
+//
+//  TestDerivedObservation.m
+//  Panopticon Example
+//
+//  Created by Pierre Houston on 2016-05-28.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+@import XCTest;
+#import <Panopticon/Panopticon.h>
+
+@interface LineItem : NSObject
+@property (nonatomic) NSInteger price;
+@property (nonatomic) NSInteger quantity;
+@end
+
+@implementation LineItem
+@end
+
+
+@interface TestDerivedObservation : XCTestCase
+@property (nonatomic) NSArray *items;
+@end
+
+@implementation TestDerivedObservation
+
+- (void)setUp
+{
+    [super setUp];
+    NSMutableArray *items = [NSMutableArray array];
+    for (NSInteger i = 1; i <= 3; i++) {
+        LineItem *item = [[LineItem alloc] init];
+        item.price = i * 10;
+        item.quantity = 1;
+        [items addObject:item];
+    }
+    self.items = items;
+}
+
+- (void)testTotalRecomputedIncrementallyAndNotifiedOnChange
+{
+    NSArray *items = self.items;
+    NSMutableArray *contributions = [NSMutableArray array]; // memoized per input, updated only for changed inputs
+    NSMutableArray *changedInputs = [NSMutableArray array];
+    NSMutableArray *totals = [NSMutableArray array];
+    
+    PANDerivedObservation *observation = [self pan_observeDerivedValueOfObjects:items keyPaths:@[@"price", @"quantity"] computedBy:^id(NSNumber *previousTotal, NSIndexSet *changed) {
+        [changedInputs addObject:changed];
+        NSInteger total = previousTotal.integerValue;
+        for (NSUInteger i = changed.firstIndex; i != NSNotFound; i = [changed indexGreaterThanIndex:i]) {
+            LineItem *item = items[i];
+            NSInteger contribution = item.price * item.quantity;
+            if (i < contributions.count) {
+                total -= [contributions[i] integerValue];
+                contributions[i] = @(contribution);
+            }
+            else {
+                [contributions addObject:@(contribution)];
+            }
+            total += contribution;
+        }
+        return @(total);
+    } withBlock:^(id obj, PANObservation *obs) {
+        [totals addObject:((PANKeyValueObservation *)obs).changedValue];
+    }];
+    XCTAssertEqualObjects(observation.value, @60);
+    XCTAssertEqual(totals.count, 0);
+    
+    ((LineItem *)items[1]).quantity = 2;
+    XCTAssertEqualObjects(changedInputs.lastObject, [NSIndexSet indexSetWithIndex:1]);
+    XCTAssertEqualObjects(totals, @[@80]);
+    
+    ((LineItem *)items[2]).price = 30; // unchanged total, recomputed without calling the block
+    XCTAssertEqual(observation.computeCount, 3);
+    XCTAssertEqualObjects(totals, @[@80]);
+    
+    [observation remove];
+    ((LineItem *)items[0]).price = 0;
+    XCTAssertEqual(observation.computeCount, 3);
+}
+
+- (void)testChangesBeforeQueuedComputeAreOneBatch
+{
+    NSOperationQueue *queue = [[NSOperationQueue alloc] init];
+    queue.maxConcurrentOperationCount = 1;
+    queue.suspended = YES;
+    NSArray *items = self.items;
+    NSUInteger __block callCount = 0;
+    
+    PANDerivedObservation *observation = [self pan_observeDerivedValueOfObjects:items keyPaths:@[@"price"] computedBy:^id(id previousValue, NSIndexSet *changed) {
+        return [items valueForKeyPath:@"@sum.price"];
+    } onQueue:queue withBlock:^(id obj, PANObservation *obs) {
+        callCount++;
+    }];
+    for (LineItem *item in items)
+        item.price += 1;
+    
+    queue.suspended = NO;
+    [queue waitUntilAllOperationsAreFinished];
+    XCTAssertEqual(observation.computeCount, 2);
+    XCTAssertEqual(callCount, 1);
+    XCTAssertEqualObjects(observation.value, @63);
+    [observation remove];
+}
+
+@end
@@ -0,0 +1,60 @@
+//
+//  TestKeyValueFiltering.m
+//  Panopticon Example
+//
+//  Created by Pierre Houston on 2016-05-27.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+@import XCTest;
+#import <Panopticon/Panopticon.h>
+#import "ModelObject.h"
+
+@interface TestKeyValueFiltering : XCTestCase
+@property (nonatomic) ModelObject *modelObject;
+@property (nonatomic) NSMutableArray *values;
+@end
+
+@implementation TestKeyValueFiltering
+
+- (void)setUp
+{
+    [super setUp];
+    self.modelObject = [[ModelObject alloc] init];
+    self.values = [NSMutableArray array];
+}
+
+- (PANKeyValueObservation *)observeNameWithFilter:(PANKeyValueChangeFilter)filter
+{
+    PANKeyValueObservation *observation = [self pan_observeForChanges:self.modelObject toKeyPath:@"name" withBlock:^(TestKeyValueFiltering *test, PANObservation *obs) {
+        [test.values addObject:((PANKeyValueObservation *)obs).changedValue];
+    }];
+    observation.changeFilter = filter;
+    return observation;
+}
+
+- (void)testEqualValuesDropped
+{
+    PANKeyValueObservation *observation = [self observeNameWithFilter:PANKeyValueChangeFilterEqualValues];
+    for (NSString *name in @[@"a", @"a", @"b", @"b", @"b", @"a"])
+        self.modelObject.name = [NSMutableString stringWithString:name];
+    
+    XCTAssertEqualObjects(self.values, (@[@"a", @"b", @"a"]));
+    XCTAssertEqual(observation.suppressedChangeCount, 3);
+    [observation remove];
+}
+
+- (void)testIdenticalValuesDropped
+{
+    PANKeyValueObservation *observation = [self observeNameWithFilter:PANKeyValueChangeFilterIdenticalValues];
+    NSString *name = @"too long to be a tagged pointer string"; // so copies aren't identical
+    self.modelObject.name = [NSMutableString stringWithString:name];
+    self.modelObject.name = [NSMutableString stringWithString:name];
+    self.modelObject.name = self.modelObject.name;
+    
+    XCTAssertEqual(self.values.count, 2);
+    XCTAssertEqual(observation.suppressedChangeCount, 1);
+    [observation remove];
+}
+
+@end
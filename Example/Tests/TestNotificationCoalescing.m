@@ -0,0 +1,96 @@
+//
+//  TestNotificationCoalescing.m
+//  Panopticon Example
+//
+//  Created by Pierre Houston on 2016-05-31.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+@import XCTest;
+#import <Panopticon/Panopticon.h>
+
+static NSString * const coalescedNotification = @"PANTestCoalescedNotification";
+
+@interface TestNotificationCoalescing : XCTestCase
+@property (nonatomic) dispatch_queue_t deliveryQueue;
+@property (nonatomic) NSMutableArray *deliveries;
+@end
+
+@implementation TestNotificationCoalescing
+
+- (void)setUp
+{
+    [super setUp];
+    self.deliveryQueue = dispatch_queue_create("coalescing", DISPATCH_QUEUE_SERIAL);
+    self.deliveries = [NSMutableArray array];
+}
+
+- (void)tearDown
+{
+    [self pan_stopObservingAllNotificationsNamed:coalescedNotification];
+    [super tearDown];
+}
+
+- (void)observeCoalescing:(PANNotificationCoalescing)coalescing
+{
+    NSMutableArray *deliveries = self.deliveries;
+    [self pan_observeAllNotificationsNamed:coalescedNotification onGCDQueue:self.deliveryQueue coalescing:coalescing withBlock:^(id obj, PANObservation *obs) {
+        PANNotificationObservation *notificationObservation = (PANNotificationObservation *)obs;
+        [deliveries addObject:@[notificationObservation.userInfo[@"index"], @(notificationObservation.coalescedCount)]];
+    }];
+}
+
+// posts while the delivery queue is suspended all wait for delivery together
+- (void)postWhileQueueSuspended:(void (^)(void))posts
+{
+    dispatch_suspend(self.deliveryQueue);
+    posts();
+    dispatch_resume(self.deliveryQueue);
+    dispatch_sync(self.deliveryQueue, ^{});
+}
+
+- (void)testPostsByNameMergedIntoLatest
+{
+    NSObject *poster = [[NSObject alloc] init];
+    NSObject *otherPoster = [[NSObject alloc] init];
+    [self observeCoalescing:PANNotificationCoalescingByName];
+
+    [self postWhileQueueSuspended:^{
+        for (NSUInteger i = 0; i < 5; i++)
+            [(i % 2 == 0 ? poster : otherPoster) pan_postNotificationNamed:coalescedNotification userInfo:@{ @"index": @(i) }];
+    }];
+    XCTAssertEqualObjects(self.deliveries, (@[@[@4, @4]]));
+
+    // once delivered, the next post waits for its own delivery
+    [self postWhileQueueSuspended:^{
+        [poster pan_postNotificationNamed:coalescedNotification userInfo:@{ @"index": @5 }];
+    }];
+    XCTAssertEqualObjects(self.deliveries, (@[@[@4, @4], @[@5, @0]]));
+}
+
+- (void)testPostsByNameAndObjectMergedPerObject
+{
+    NSObject *poster = [[NSObject alloc] init];
+    NSObject *otherPoster = [[NSObject alloc] init];
+    [self observeCoalescing:PANNotificationCoalescingByNameAndObject];
+
+    [self postWhileQueueSuspended:^{
+        for (NSUInteger i = 0; i < 6; i++)
+            [(i % 2 == 0 ? poster : otherPoster) pan_postNotificationNamed:coalescedNotification userInfo:@{ @"index": @(i) }];
+    }];
+    XCTAssertEqualObjects(self.deliveries, (@[@[@4, @2], @[@5, @2]]));
+}
+
+- (void)testPostsNotMergedByDefault
+{
+    NSObject *poster = [[NSObject alloc] init];
+    [self observeCoalescing:PANNotificationCoalescingNone];
+
+    [self postWhileQueueSuspended:^{
+        for (NSUInteger i = 0; i < 3; i++)
+            [poster pan_postNotificationNamed:coalescedNotification userInfo:@{ @"index": @(i) }];
+    }];
+    XCTAssertEqualObjects(self.deliveries, (@[@[@0, @0], @[@1, @0], @[@2, @0]]));
+}
+
+@end
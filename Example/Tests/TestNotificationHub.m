@@ -0,0 +1,70 @@
+//
+//  TestNotificationHub.m
+//  Panopticon Example
+//
+//  Created by Pierre Houston on 2016-05-30.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+@import XCTest;
+#import <Panopticon/Panopticon.h>
+
+static NSString * const hubNotification = @"PANTestHubNotification";
+
+@interface TestNotificationHub : XCTestCase
+@end
+
+@implementation TestNotificationHub
+
+- (void)setUp
+{
+    [super setUp];
+    [[PANNotificationHub defaultHub] registerName:hubNotification];
+}
+
+- (void)testRegisteredNameIsInterned
+{
+    NSString *name = [NSMutableString stringWithString:hubNotification];
+    XCTAssertEqual([[PANNotificationHub defaultHub] registerName:name], [[PANNotificationHub defaultHub] registerName:hubNotification]);
+    XCTAssertTrue([[PANNotificationHub defaultHub] isRegisteredName:name]);
+    XCTAssertFalse([[PANNotificationHub defaultHub] isRegisteredName:@"PANTestUnregisteredNotification"]);
+}
+
+- (void)testPostReachesObservationsOfAnyAndOfPostingObject
+{
+    NSObject *poster = [[NSObject alloc] init];
+    NSObject *otherPoster = [[NSObject alloc] init];
+    NSMutableArray *received = [NSMutableArray array];
+    [self pan_observeAllNotificationsNamed:hubNotification withBlock:^(id obj, PANObservation *obs) {
+        [received addObject:@"any"];
+    }];
+    [self pan_observeForNotifications:poster named:hubNotification withBlock:^(id obj, PANObservation *obs) {
+        [received addObject:@"poster"];
+    }];
+
+    [poster pan_postNotificationNamed:hubNotification];
+    [otherPoster pan_postNotificationNamed:hubNotification];
+    XCTAssertEqualObjects(received, (@[@"any", @"poster", @"any"]));
+
+    [self pan_stopObservingAllNotificationsNamed:hubNotification];
+    [self pan_stopObservingForNotifications:poster named:hubNotification];
+    [poster pan_postNotificationNamed:hubNotification];
+    XCTAssertEqual(received.count, 3);
+}
+
+- (void)testNotificationMadeWhenRead
+{
+    NSObject *poster = [[NSObject alloc] init];
+    NSNotification * __block notification = nil;
+    [self pan_observeForNotifications:poster named:hubNotification withBlock:^(id obj, PANObservation *obs) {
+        notification = ((PANNotificationObservation *)obs).notification;
+    }];
+
+    XCTAssertTrue([[PANNotificationHub defaultHub] postNotificationName:hubNotification object:poster userInfo:@{ @"key": @1 }]);
+    XCTAssertEqualObjects(notification.name, hubNotification);
+    XCTAssertEqual(notification.object, poster);
+    XCTAssertEqualObjects(notification.userInfo, @{ @"key": @1 });
+    [self pan_stopObservingForNotifications:poster named:hubNotification];
+}
+
+@end
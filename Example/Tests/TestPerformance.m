@@ -0,0 +1,940 @@
+//
+//  TestPerformance.m
+//  Panopticon Example
+//
+//  Created by Pierre Houston on 2016-05-16.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+//  Benchmarks for internals where a faster implementation replaced a simpler one. Where useful the old
+//  implementation is reproduced here so both can be measured under the same load.
+
+@import XCTest;
+#import <Panopticon/Panopticon.h>
+#import <Panopticon/PANObservationRegistry.h>
+#import <Panopticon/PANObservation+Private.h>
+#import <Panopticon/PANNotificationObservation+Private.h>
+#import <Panopticon/PANNotificationDispatcher.h>
+#import <Panopticon/PANKeyValueObservation+Private.h>
+#import <objc/runtime.h>
+#import <stdatomic.h>
+#import "ModelObject.h"
+
+static NSString * const benchmarkNotification = @"PANBenchmarkNotification";
+static const NSUInteger registryIterationsPerThread = 20000;
+static const NSUInteger registrySharedObjectCount = 4;
+static const NSUInteger lookupObservationCount = 10000;
+static const NSUInteger lookupCount = 1000;
+static const NSUInteger mailboxEventsPerProducer = 20000;
+static const NSUInteger allocationTriggerCount = 100000;
+static const NSUInteger allocationSlack = 1000; // one-time setup like the first timestamp, lazily created caches
+static const NSUInteger queuedAllocationTriggerCount = 10000; // each waits in the mailbox, holding its change
+static const NSUInteger deallocInstanceCount = 200000;
+static const NSUInteger suspensionObservationCount = 100000;
+static const NSUInteger suspensionCount = 10;
+static const NSUInteger keyValueChangeCount = 10000;
+
+
+#pragma mark - legacy registry
+
+// the observation storage used before PANObservationRegistry: @synchronized on the object and on a mutable set,
+// copying the set on every lookup
+static const int LegacyObservationSetKeyVar;
+static void *LegacyObservationSetKey = (void *)&LegacyObservationSetKeyVar;
+
+static void legacyStoreObservation(PANObservation *observation, id associationTarget)
+{
+    NSMutableSet *observationSet = nil;
+    @synchronized(associationTarget) {
+        observationSet = objc_getAssociatedObject(associationTarget, LegacyObservationSetKey);
+        if (observationSet == nil) {
+            observationSet = [NSMutableSet set];
+            objc_setAssociatedObject(associationTarget, LegacyObservationSetKey, observationSet, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+        }
+    }
+    @synchronized(observationSet) {
+        [observationSet addObject:observation];
+    }
+}
+
+static void legacyRemoveObservation(PANObservation *observation, id associationTarget)
+{
+    NSMutableSet *observationSet = nil;
+    @synchronized(associationTarget) {
+        observationSet = objc_getAssociatedObject(associationTarget, LegacyObservationSetKey);
+    }
+    @synchronized(observationSet) {
+        [observationSet removeObject:observation];
+    }
+}
+
+static NSSet *legacyObservations(id associationTarget)
+{
+    NSMutableSet *observationSet = nil;
+    @synchronized(associationTarget) {
+        observationSet = objc_getAssociatedObject(associationTarget, LegacyObservationSetKey);
+    }
+    if (observationSet != nil) {
+        @synchronized(observationSet) {
+            observationSet = [observationSet copy];
+        }
+    }
+    return observationSet;
+}
+
+
+#pragma mark -
+
+@interface TestRegistryPerformance : XCTestCase
+@property (nonatomic) NSArray *sharedObjects;
+@end
+
+@implementation TestRegistryPerformance
+
+- (void)setUp
+{
+    [super setUp];
+    NSMutableArray *objects = [NSMutableArray array];
+    for (NSUInteger i = 0; i < registrySharedObjectCount; i++)
+        [objects addObject:[NSObject new]];
+    self.sharedObjects = objects;
+}
+
+// run on `threadCount` threads at once, each doing a store, a lookup and a removal per iteration against one of a
+// few objects shared by all threads, with 3 other observations kept in each object to make lookups non-trivial
+- (void)measureWithThreadCount:(NSUInteger)threadCount store:(void (^)(PANObservation *, id))store remove:(void (^)(PANObservation *, id))remove lookup:(NSUInteger (^)(id))lookup
+{
+    NSArray *objects = self.sharedObjects;
+    NSMutableArray *observations = [NSMutableArray array];
+    for (NSUInteger t = 0; t < threadCount; t++) {
+        [observations addObject:[[PANNotificationObservation alloc] initWithObject:objects[t % objects.count] name:benchmarkNotification queue:nil gcdQueue:nil block:^(PANObservation *observation) { }]];
+    }
+    NSMutableArray *residents = [NSMutableArray array];
+    for (id object in objects) {
+        for (NSUInteger i = 0; i < 3; i++) {
+            PANObservation *resident = [[PANNotificationObservation alloc] initWithObject:object name:benchmarkNotification queue:nil gcdQueue:nil block:^(PANObservation *observation) { }];
+            [residents addObject:resident];
+            store(resident, object);
+        }
+    }
+
+    dispatch_queue_t queue = dispatch_queue_create("benchmark", DISPATCH_QUEUE_CONCURRENT);
+    [self measureBlock:^{
+        dispatch_group_t group = dispatch_group_create();
+        for (NSUInteger t = 0; t < threadCount; t++) {
+            dispatch_group_async(group, queue, ^{
+                PANObservation *observation = observations[t];
+                NSUInteger found = 0;
+                for (NSUInteger i = 0; i < registryIterationsPerThread; i++) {
+                    id object = objects[(t + i) % objects.count];
+                    store(observation, object);
+                    found += lookup(object);
+                    remove(observation, object);
+                }
+                XCTAssertGreaterThanOrEqual(found, registryIterationsPerThread * 3);
+            });
+        }
+        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    }];
+
+    for (PANObservation *resident in residents)
+        remove(resident, resident.observee);
+}
+
+- (void)measureLegacyWithThreadCount:(NSUInteger)threadCount
+{
+    [self measureWithThreadCount:threadCount store:^(PANObservation *observation, id object) {
+        legacyStoreObservation(observation, object);
+    } remove:^(PANObservation *observation, id object) {
+        legacyRemoveObservation(observation, object);
+    } lookup:^NSUInteger(id object) {
+        return legacyObservations(object).count;
+    }];
+}
+
+- (void)measureRegistryWithThreadCount:(NSUInteger)threadCount
+{
+    [self measureWithThreadCount:threadCount store:^(PANObservation *observation, id object) {
+        [[PANObservationRegistry registryForObject:object] addObservation:observation indexKey:nil];
+    } remove:^(PANObservation *observation, id object) {
+        [[PANObservationRegistry existingRegistryForObject:object] removeObservation:observation];
+    } lookup:^NSUInteger(id object) {
+        return [PANObservationRegistry existingRegistryForObject:object].observations.count;
+    }];
+}
+
+- (void)testLegacyRegistry1Thread   { [self measureLegacyWithThreadCount:1]; }
+- (void)testLegacyRegistry4Threads  { [self measureLegacyWithThreadCount:4]; }
+- (void)testLegacyRegistry16Threads { [self measureLegacyWithThreadCount:16]; }
+
+- (void)testRegistry1Thread   { [self measureRegistryWithThreadCount:1]; }
+- (void)testRegistry4Threads  { [self measureRegistryWithThreadCount:4]; }
+- (void)testRegistry16Threads { [self measureRegistryWithThreadCount:16]; }
+
+@end
+
+
+#pragma mark -
+
+@interface TestLookupPerformance : XCTestCase
+@property (nonatomic) NSObject *observee;
+@property (nonatomic) NSArray *names;
+@end
+
+@implementation TestLookupPerformance
+
+- (void)setUp
+{
+    [super setUp];
+    self.observee = [NSObject new];
+    NSMutableArray *names = [NSMutableArray array];
+    for (NSUInteger i = 0; i < lookupObservationCount; i++)
+        [names addObject:[NSString stringWithFormat:@"%@%lu", benchmarkNotification, (unsigned long)i]];
+    self.names = names;
+}
+
+- (void)tearDown
+{
+    for (NSString *name in self.names)
+        [self pan_stopObservingForNotifications:self.observee named:name];
+    [super tearDown];
+}
+
+- (void)observeAllNames
+{
+    for (NSString *name in self.names)
+        [self pan_observeForNotifications:self.observee named:name withBlock:^(id obj, PANObservation *observation) { }];
+}
+
+- (void)testIndexedFindAmong10k
+{
+    [self observeAllNames];
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < lookupCount; i++) {
+            NSString *name = self.names[(i * 7919) % lookupObservationCount];
+            XCTAssertNotNil([PANNotificationObservation findObservationForObserver:self object:self.observee name:name]);
+        }
+    }];
+}
+
+// the linear scan all find methods used before the index
+- (void)testScanningFindAmong10k
+{
+    [self observeAllNames];
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < lookupCount; i++) {
+            NSString *name = self.names[(i * 7919) % lookupObservationCount];
+            XCTAssertNotNil([PANNotificationObservation findObservationForObserver:self object:self.observee matchingTest:^BOOL(PANObservation *obs) {
+                return [obs isKindOfClass:[PANNotificationObservation class]] && [((PANNotificationObservation *)obs).name isEqualToString:name];
+            }]);
+        }
+    }];
+}
+
+- (void)testStopObserving10k
+{
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        [self observeAllNames];
+        [self startMeasuring];
+        for (NSString *name in self.names)
+            [self pan_stopObservingForNotifications:self.observee named:name];
+        [self stopMeasuring];
+    }];
+}
+
+@end
+
+
+#pragma mark -
+
+@interface TestMailboxPerformance : XCTestCase
+@end
+
+@implementation TestMailboxPerformance
+
+// `producerCount` threads trigger one observation as fast as they can, its block counting deliveries on a serial
+// queue, measured until the last trigger has been delivered
+- (void)measureWithProducerCount:(NSUInteger)producerCount trigger:(void (^)(PANObservation *observation, NSUInteger i))trigger
+{
+    NSUInteger total = producerCount * mailboxEventsPerProducer;
+    NSUInteger __block delivered = 0;
+    dispatch_semaphore_t done = dispatch_semaphore_create(0);
+    dispatch_queue_t deliveryQueue = dispatch_queue_create("delivery", DISPATCH_QUEUE_SERIAL);
+    PANObservation *observation = [[PANNotificationObservation alloc] initWithObject:self name:benchmarkNotification queue:nil gcdQueue:deliveryQueue block:^(PANObservation *obs) {
+        if (++delivered == total)
+            dispatch_semaphore_signal(done);
+    }];
+    
+    dispatch_queue_t producerQueue = dispatch_queue_create("producers", DISPATCH_QUEUE_CONCURRENT);
+    [self measureBlock:^{
+        delivered = 0;
+        uint64_t start = PANTimestampNanosecondsNow();
+        for (NSUInteger p = 0; p < producerCount; p++) {
+            dispatch_async(producerQueue, ^{
+                for (NSUInteger i = 0; i < mailboxEventsPerProducer; i++)
+                    trigger(observation, i);
+            });
+        }
+        dispatch_semaphore_wait(done, DISPATCH_TIME_FOREVER);
+        double seconds = (double)(PANTimestampNanosecondsNow() - start) / NSEC_PER_SEC;
+        NSLog(@"%lu producers: %.0f events/s", (unsigned long)producerCount, total / seconds);
+    }];
+}
+
+- (void)measureMailboxWithProducerCount:(NSUInteger)producerCount
+{
+    [self measureWithProducerCount:producerCount trigger:^(PANObservation *observation, NSUInteger i) {
+        PANObservationEvent event = PANObservationEventMake(nil, nil, nil);
+        [observation triggerEvent:&event synchronously:NO];
+    }];
+}
+
+// the delivery used before the mailbox, a dispatch_async per trigger of a block capturing its values
+- (void)measureDispatchPerTriggerWithProducerCount:(NSUInteger)producerCount
+{
+    [self measureWithProducerCount:producerCount trigger:^(PANObservation *observation, NSUInteger i) {
+        uint64_t timestamp = PANTimestampNanosecondsNow();
+        dispatch_async(observation.gcdQueue, ^{
+            PANObservationEvent event = { nil, observation, nil, timestamp };
+            [observation triggerEvent:&event synchronously:YES];
+        });
+    }];
+}
+
+- (void)testDispatchPerTrigger1Producer   { [self measureDispatchPerTriggerWithProducerCount:1]; }
+- (void)testDispatchPerTrigger2Producers  { [self measureDispatchPerTriggerWithProducerCount:2]; }
+- (void)testDispatchPerTrigger4Producers  { [self measureDispatchPerTriggerWithProducerCount:4]; }
+- (void)testDispatchPerTrigger8Producers  { [self measureDispatchPerTriggerWithProducerCount:8]; }
+- (void)testDispatchPerTrigger16Producers { [self measureDispatchPerTriggerWithProducerCount:16]; }
+
+- (void)testMailbox1Producer   { [self measureMailboxWithProducerCount:1]; }
+- (void)testMailbox2Producers  { [self measureMailboxWithProducerCount:2]; }
+- (void)testMailbox4Producers  { [self measureMailboxWithProducerCount:4]; }
+- (void)testMailbox8Producers  { [self measureMailboxWithProducerCount:8]; }
+- (void)testMailbox16Producers { [self measureMailboxWithProducerCount:16]; }
+
+@end
+
+
+#pragma mark - allocation counting
+
+// libmalloc calls this hook, when set, for every allocation in the process, see <malloc/malloc.h> in the libmalloc
+// sources; only allocations on a thread that has turned counting on are counted
+typedef void (malloc_logger_t)(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t num_hot_frames_to_skip);
+extern malloc_logger_t *malloc_logger;
+#define PAN_MALLOC_LOG_TYPE_ALLOCATE 2
+
+static __thread BOOL countingAllocations;
+static __thread NSUInteger allocationCount;
+
+static void countingMallocLogger(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t num_hot_frames_to_skip)
+{
+    if (countingAllocations && (type & PAN_MALLOC_LOG_TYPE_ALLOCATE))
+        allocationCount++;
+}
+
+// the hook is put back even if the block throws, so a failure doesn't leave every later test counting
+static NSUInteger countAllocations(void (^block)(void))
+{
+    malloc_logger_t *previousLogger = malloc_logger;
+    malloc_logger = countingMallocLogger;
+    allocationCount = 0;
+    countingAllocations = YES;
+    @try {
+        block();
+    }
+    @finally {
+        countingAllocations = NO;
+        malloc_logger = previousLogger;
+    }
+    return allocationCount;
+}
+
+
+@interface TestTriggerAllocations : XCTestCase
+@property (nonatomic) ModelObject *modelObject;
+@property (nonatomic) NSUInteger observedCount;
+@end
+
+@implementation TestTriggerAllocations
+
+- (void)setUp
+{
+    [super setUp];
+    self.modelObject = [[ModelObject alloc] init];
+    self.observedCount = 0;
+}
+
+- (void)observeValueForKeyPath:(NSString *)keyPath ofObject:(id)object change:(NSDictionary *)change context:(void *)context
+{
+    self.observedCount++;
+}
+
+- (void)toggleFlag:(NSUInteger)count
+{
+    for (NSUInteger i = 0; i < count; i++)
+        self.modelObject.flag = !self.modelObject.flag;
+}
+
+- (void)postNotifications:(NSUInteger)count
+{
+    for (NSUInteger i = 0; i < count; i++)
+        [[NSNotificationCenter defaultCenter] postNotificationName:benchmarkNotification object:self.modelObject];
+}
+
+// KVO itself allocates a change dictionary per change, so measure a plain observer first and only hold
+// Panopticon to what it adds beyond that
+- (void)testKeyValueTriggerAllocations
+{
+    [self.modelObject addObserver:self forKeyPath:@"flag" options:NSKeyValueObservingOptionNew context:NULL];
+    [self toggleFlag:1];
+    NSUInteger baseline = countAllocations(^{ [self toggleFlag:allocationTriggerCount]; });
+    [self.modelObject removeObserver:self forKeyPath:@"flag" context:NULL];
+    
+    typeof(self) __weak welf = self;
+    [self pan_observeForChanges:self.modelObject toKeyPath:@"flag" options:NSKeyValueObservingOptionNew withBlock:^(id obj, PANObservation *observation) {
+        welf.observedCount++;
+    }];
+    [self toggleFlag:1];
+    NSUInteger allocations = countAllocations(^{ [self toggleFlag:allocationTriggerCount]; });
+    [self pan_stopObservingForChanges:self.modelObject toKeyPath:@"flag"];
+    
+    XCTAssertEqual(self.observedCount, 2 * (allocationTriggerCount + 1));
+    XCTAssertLessThan(allocations, baseline + allocationSlack);
+}
+
+// same for NSNotificationCenter allocating the NSNotification per post
+- (void)testNotificationTriggerAllocations
+{
+    typeof(self) __weak welf = self;
+    id token = [[NSNotificationCenter defaultCenter] addObserverForName:benchmarkNotification object:self.modelObject queue:nil usingBlock:^(NSNotification *notification) {
+        welf.observedCount++;
+    }];
+    [self postNotifications:1];
+    NSUInteger baseline = countAllocations(^{ [self postNotifications:allocationTriggerCount]; });
+    [[NSNotificationCenter defaultCenter] removeObserver:token];
+    
+    [self pan_observeForNotifications:self.modelObject named:benchmarkNotification withBlock:^(id obj, PANObservation *observation) {
+        welf.observedCount++;
+    }];
+    [self postNotifications:1];
+    NSUInteger allocations = countAllocations(^{ [self postNotifications:allocationTriggerCount]; });
+    [self pan_stopObservingForNotifications:self.modelObject named:benchmarkNotification];
+    
+    XCTAssertEqual(self.observedCount, 2 * (allocationTriggerCount + 1));
+    XCTAssertLessThan(allocations, baseline + allocationSlack);
+}
+
+// triggers delivered on a queue wait in the mailbox, each carried by a pooled detected observation that has to be
+// created while the pool is empty, so allow one per trigger held up by the suspended queue but nothing more
+- (void)testQueuedKeyValueTriggerAllocations
+{
+    [self.modelObject addObserver:self forKeyPath:@"flag" options:NSKeyValueObservingOptionNew context:NULL];
+    [self toggleFlag:1];
+    NSUInteger baseline = countAllocations(^{ [self toggleFlag:queuedAllocationTriggerCount]; });
+    [self.modelObject removeObserver:self forKeyPath:@"flag" context:NULL];
+    
+    dispatch_queue_t queue = dispatch_queue_create("TestTriggerAllocations", DISPATCH_QUEUE_SERIAL);
+    XCTestExpectation *expectation = [self expectationWithDescription:@"queued deliveries"];
+    NSUInteger __block queuedCount = 0;
+    [self pan_observeForChanges:self.modelObject toKeyPath:@"flag" options:NSKeyValueObservingOptionNew onGCDQueue:queue withBlock:^(id obj, PANObservation *observation) {
+        if (++queuedCount == queuedAllocationTriggerCount + 1)
+            [expectation fulfill];
+    }];
+    [self toggleFlag:1];
+    dispatch_sync(queue, ^{});
+    
+    dispatch_suspend(queue);
+    NSUInteger allocations = countAllocations(^{ [self toggleFlag:queuedAllocationTriggerCount]; });
+    dispatch_resume(queue);
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    [self pan_stopObservingForChanges:self.modelObject toKeyPath:@"flag"];
+    
+    XCTAssertEqual(self.observedCount, queuedAllocationTriggerCount + 1);
+    XCTAssertEqual(queuedCount, queuedAllocationTriggerCount + 1);
+    XCTAssertLessThan(allocations, baseline + queuedAllocationTriggerCount + allocationSlack);
+}
+
+@end
+
+
+#pragma mark - dealloc throughput
+
+// never observed themselves, they only share a class with an instance that was
+@interface SwizzledDeallocObject : NSObject
+@end
+@implementation SwizzledDeallocObject
+@end
+
+@interface SentinelDeallocObject : NSObject
+@end
+@implementation SentinelDeallocObject
+@end
+
+@interface PANObservation (LegacyDeallocSwizzling)
++ (void)swizzleDeallocIfNeededForClass:(Class)class;
+@end
+
+
+@interface TestDeallocPerformance : XCTestCase
+@end
+
+@implementation TestDeallocPerformance
+
+- (void)measureDeallocOfClass:(Class)class
+{
+    [self measureBlock:^{
+        uint64_t start = PANTimestampNanosecondsNow();
+        for (NSUInteger i = 0; i < deallocInstanceCount; i++) {
+            @autoreleasepool {
+                (void)[[class alloc] init];
+            }
+        }
+        double seconds = (double)(PANTimestampNanosecondsNow() - start) / NSEC_PER_SEC;
+        NSLog(@"%@: %.0f deallocs/s", NSStringFromClass(class), deallocInstanceCount / seconds);
+    }];
+}
+
+// automatic removal as it was before the registry became the sentinel, every instance of an observer's or
+// observee's class runs the swizzled dealloc and looks for observations
+- (void)testDeallocOfUnobservedInstancesOfSwizzledClass
+{
+    [PANObservation swizzleDeallocIfNeededForClass:[SwizzledDeallocObject class]];
+    [self measureDeallocOfClass:[SwizzledDeallocObject class]];
+}
+
+- (void)testDeallocOfUnobservedInstancesOfObserverClass
+{
+    SentinelDeallocObject *observer = [[SentinelDeallocObject alloc] init];
+    [observer pan_observeAllNotificationsNamed:benchmarkNotification withBlock:^(id obj, PANObservation *observation) { }];
+    [self measureDeallocOfClass:[SentinelDeallocObject class]];
+    [observer pan_stopObservingAllNotificationsNamed:benchmarkNotification];
+}
+
+@end
+
+
+#pragma mark - suspending everything
+
+@interface TestSuspensionPerformance : XCTestCase
+@property (nonatomic) NSObject *observee; // kept for the whole test, its observations are removed when it's freed
+@end
+
+@implementation TestSuspensionPerformance
+
+- (void)setUp
+{
+    [super setUp];
+    self.observee = [NSObject new];
+    for (NSUInteger i = 0; i < suspensionObservationCount; i++)
+        [self pan_observeForNotifications:self.observee named:[NSString stringWithFormat:@"%@%lu", benchmarkNotification, (unsigned long)i] withBlock:^(id obj, PANObservation *observation) { }];
+}
+
+- (void)tearDown
+{
+    [self pan_removeAllObservations];
+    self.observee = nil;
+    [super tearDown];
+}
+
+- (void)testSuspendAndResumeAmong100k
+{
+    XCTAssertEqual([PANObservation associatedObservationsForObserver:self].count, suspensionObservationCount);
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < suspensionCount; i++) {
+            [PANObservation suspendAllObservations];
+            [PANObservation resumeAllObservations];
+        }
+    }];
+}
+
+// what was needed before the global gate, setting inactive on every observation
+- (void)testSettingInactiveOnEachAmong100k
+{
+    NSArray *observations = [PANObservation associatedObservationsForObserver:self];
+    XCTAssertEqual(observations.count, suspensionObservationCount);
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < suspensionCount; i++) {
+            for (PANObservation *observation in observations)
+                observation.inactive = YES;
+            for (PANObservation *observation in observations)
+                observation.inactive = NO;
+        }
+    }];
+}
+
+@end
+
+
+#pragma mark - key value fan out
+
+// adds itself as a Foundation KVO observer, as each PANKeyValueObservation did before the dispatcher
+@interface DirectKeyValueObserver : NSObject
+@property (nonatomic) NSUInteger changeCount;
+@end
+
+@implementation DirectKeyValueObserver
+- (void)observeValueForKeyPath:(NSString *)keyPath ofObject:(id)object change:(NSDictionary *)change context:(void *)context
+{
+    self.changeCount++;
+}
+@end
+
+
+@interface TestKeyValueDispatchPerformance : XCTestCase
+@property (nonatomic) ModelObject *modelObject;
+@end
+
+@implementation TestKeyValueDispatchPerformance
+
+- (void)setUp
+{
+    [super setUp];
+    self.modelObject = [[ModelObject alloc] init];
+}
+
+- (void)measureChanges
+{
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < keyValueChangeCount; i++)
+            self.modelObject.flag = !self.modelObject.flag;
+    }];
+}
+
+- (void)measureBatchedChanges
+{
+    [self measureBlock:^{
+        [Panopticon performBatchedUpdates:^{
+            for (NSUInteger i = 0; i < keyValueChangeCount; i++)
+                self.modelObject.flag = !self.modelObject.flag;
+        }];
+    }];
+}
+
+- (void)measureDispatcherWithObservationCount:(NSUInteger)count
+{
+    [self measureDispatcherWithObservationCount:count batched:NO];
+}
+
+- (void)measureDispatcherWithObservationCount:(NSUInteger)count batched:(BOOL)batched
+{
+    NSUInteger __block changeCount = 0;
+    NSMutableArray *observations = [NSMutableArray array];
+    for (NSUInteger i = 0; i < count; i++) {
+        PANKeyValueObservation *observation = [[PANKeyValueObservation alloc] initWithObject:self.modelObject keyPaths:@[@"flag"] options:0 queue:nil gcdQueue:nil block:^(PANObservation *obs) {
+            changeCount++;
+        }];
+        [observation register];
+        [observations addObject:observation];
+    }
+    if (batched) {
+        [self measureBatchedChanges];
+        XCTAssertGreaterThanOrEqual(changeCount, count); // once per observation per measurement
+    }
+    else {
+        [self measureChanges];
+        XCTAssertGreaterThanOrEqual(changeCount, count * keyValueChangeCount);
+    }
+    for (PANObservation *observation in observations)
+        [observation remove];
+}
+
+- (void)measureDirectWithObserverCount:(NSUInteger)count
+{
+    NSMutableArray *observers = [NSMutableArray array];
+    for (NSUInteger i = 0; i < count; i++) {
+        DirectKeyValueObserver *observer = [[DirectKeyValueObserver alloc] init];
+        [self.modelObject addObserver:observer forKeyPath:@"flag" options:0 context:NULL];
+        [observers addObject:observer];
+    }
+    [self measureChanges];
+    for (DirectKeyValueObserver *observer in observers)
+        [self.modelObject removeObserver:observer forKeyPath:@"flag" context:NULL];
+}
+
+- (void)testDispatcher1Observation    { [self measureDispatcherWithObservationCount:1]; }
+- (void)testDispatcher10Observations  { [self measureDispatcherWithObservationCount:10]; }
+- (void)testDispatcher100Observations { [self measureDispatcherWithObservationCount:100]; }
+
+- (void)testBatched100Observations { [self measureDispatcherWithObservationCount:100 batched:YES]; }
+
+- (void)testDirectKVO1Observer    { [self measureDirectWithObserverCount:1]; }
+- (void)testDirectKVO10Observers  { [self measureDirectWithObserverCount:10]; }
+- (void)testDirectKVO100Observers { [self measureDirectWithObserverCount:100]; }
+
+@end
+
+
+#pragma mark - key paths of a collection's elements
+
+static const NSUInteger collectionElementCount = 10000;
+static const NSUInteger collectionMutationCount = 50;
+static const NSUInteger elementChangeCount = 1000;
+
+@interface BenchmarkElement : NSObject
+@property (nonatomic) NSInteger value;
+@end
+
+@implementation BenchmarkElement
+@end
+
+@interface BenchmarkCollectionOwner : NSObject
+@property (nonatomic) NSMutableArray *elements;
+@end
+
+@implementation BenchmarkCollectionOwner
+
+- (void)insertObject:(id)object inElementsAtIndex:(NSUInteger)index
+{
+    [self.elements insertObject:object atIndex:index];
+}
+
+- (void)removeObjectFromElementsAtIndex:(NSUInteger)index
+{
+    [self.elements removeObjectAtIndex:index];
+}
+
+- (void)replaceObjectInElementsAtIndex:(NSUInteger)index withObject:(id)object
+{
+    [self.elements replaceObjectAtIndex:index withObject:object];
+}
+
+@end
+
+
+@interface TestCollectionObservationPerformance : XCTestCase
+@property (nonatomic) BenchmarkCollectionOwner *owner;
+@end
+
+@implementation TestCollectionObservationPerformance
+
+- (void)setUp
+{
+    [super setUp];
+    self.owner = [[BenchmarkCollectionOwner alloc] init];
+    self.owner.elements = [NSMutableArray arrayWithCapacity:collectionElementCount];
+    for (NSUInteger i = 0; i < collectionElementCount; i++)
+        [self.owner.elements addObject:[[BenchmarkElement alloc] init]];
+}
+
+// the same pseudo-random insertions, removals & replacements each run, interleaved with changes to elements
+- (void)mutate
+{
+    NSMutableArray *elements = [self.owner mutableArrayValueForKey:@"elements"];
+    uint32_t seed = 1;
+    for (NSUInteger i = 0; i < collectionMutationCount; i++) {
+        seed = seed * 1103515245 + 12345;
+        NSUInteger index = seed % self.owner.elements.count;
+        switch (i % 3) {
+            case 0: [elements insertObject:[[BenchmarkElement alloc] init] atIndex:index]; break;
+            case 1: [elements removeObjectAtIndex:index]; break;
+            default: [elements replaceObjectAtIndex:index withObject:[[BenchmarkElement alloc] init]]; break;
+        }
+        for (NSUInteger j = 0; j < elementChangeCount / collectionMutationCount; j++) {
+            seed = seed * 1103515245 + 12345;
+            ((BenchmarkElement *)self.owner.elements[seed % self.owner.elements.count]).value++;
+        }
+    }
+}
+
+- (void)testCollectionObservation
+{
+    NSUInteger __block changeCount = 0;
+    PANKeyValueCollectionObservation *observation = [self pan_observeForChanges:self.owner toCollectionKeyPath:@"elements" elementKeyPaths:@[@"value"] withBlock:^(id obj, PANObservation *obs) {
+        changeCount++;
+    }];
+    [self measureBlock:^{
+        [self mutate];
+    }];
+    XCTAssertGreaterThanOrEqual(changeCount, collectionMutationCount + elementChangeCount);
+    [observation remove];
+}
+
+// an observation per element, all remade whenever the collection changes
+- (void)testRebuildingElementObservations
+{
+    NSUInteger __block changeCount = 0;
+    NSMutableArray *elementObservations = [NSMutableArray array];
+    void (^rebuild)(void) = ^{
+        for (PANObservation *elementObservation in elementObservations)
+            [elementObservation remove];
+        [elementObservations removeAllObjects];
+        for (BenchmarkElement *element in self.owner.elements) {
+            [elementObservations addObject:[self pan_observeForChanges:element toKeyPath:@"value" withBlock:^(id obj, PANObservation *obs) {
+                changeCount++;
+            }]];
+        }
+    };
+    rebuild();
+    PANKeyValueObservation *observation = [self pan_observeForChanges:self.owner toKeyPath:@"elements" withBlock:^(id obj, PANObservation *obs) {
+        changeCount++;
+        rebuild();
+    }];
+    [self measureBlock:^{
+        [self mutate];
+    }];
+    XCTAssertGreaterThanOrEqual(changeCount, collectionMutationCount + elementChangeCount);
+    [observation remove];
+    for (PANObservation *elementObservation in elementObservations)
+        [elementObservation remove];
+}
+
+@end
+
+
+#pragma mark - notification registrations
+
+static const NSUInteger notificationRegistrationCycles = 10000;
+static const NSUInteger notificationPostCount = 10000;
+
+@interface TestNotificationRegistrationPerformance : XCTestCase
+@end
+
+@implementation TestNotificationRegistrationPerformance
+
+- (CFAbsoluteTime)timePosts
+{
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger i = 0; i < notificationPostCount; i++)
+        [[NSNotificationCenter defaultCenter] postNotificationName:benchmarkNotification object:self];
+    return CFAbsoluteTimeGetCurrent() - start;
+}
+
+// before each observation's notification center registration was removed with the token it returned, they
+// piled up and every post paid for all the observations ever removed
+- (void)testPostCostFlatAfterRegistrationCycles
+{
+    NSUInteger __block postCount = 0;
+    [self pan_observeForNotifications:self named:benchmarkNotification withBlock:^(id obj, PANObservation *observation) {
+        postCount++;
+    }];
+    CFAbsoluteTime before = [self timePosts];
+    NSUInteger registeredNameCount = [PANNotificationDispatcher sharedDispatcher].registeredNameCount;
+
+    for (NSUInteger i = 0; i < notificationRegistrationCycles; i++) {
+        @autoreleasepool {
+            NSObject *observer = [[NSObject alloc] init];
+            [observer pan_observeForNotifications:self named:benchmarkNotification withBlock:^(id obj, PANObservation *observation) { }];
+            [observer pan_stopObservingForNotifications:self named:benchmarkNotification];
+        }
+    }
+    XCTAssertEqual([PANNotificationDispatcher sharedDispatcher].registeredNameCount, registeredNameCount);
+
+    CFAbsoluteTime after = [self timePosts];
+    XCTAssertEqual(postCount, notificationPostCount * 2);
+    XCTAssertLessThan(after, before * 3 + 0.01);
+    [self pan_stopObservingForNotifications:self named:benchmarkNotification];
+}
+
+@end
+
+
+#pragma mark - notification hub
+
+static NSString * const hubBenchmarkNotification = @"PANHubBenchmarkNotification";
+static const NSUInteger hubPostsPerThread = 20000;
+
+@interface TestNotificationHubPerformance : XCTestCase
+@end
+
+@implementation TestNotificationHubPerformance
+
+// `threadCount` threads post as fast as they can to one observation of any object called on the posting thread
+- (void)measureWithThreadCount:(NSUInteger)threadCount name:(NSString *)name post:(void (^)(NSString *name, id object))post
+{
+    NSUInteger total = threadCount * hubPostsPerThread;
+    PANObservation *observation = [[PANNotificationObservation alloc] initWithObserver:self object:nil name:name queue:nil gcdQueue:nil block:^(id obj, PANObservation *obs) { }];
+    [observation register];
+
+    dispatch_queue_t queue = dispatch_queue_create("posters", DISPATCH_QUEUE_CONCURRENT);
+    [self measureBlock:^{
+        uint64_t start = PANTimestampNanosecondsNow();
+        dispatch_group_t group = dispatch_group_create();
+        for (NSUInteger t = 0; t < threadCount; t++) {
+            dispatch_group_async(group, queue, ^{
+                for (NSUInteger i = 0; i < hubPostsPerThread; i++)
+                    post(name, self);
+            });
+        }
+        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+        double seconds = (double)(PANTimestampNanosecondsNow() - start) / NSEC_PER_SEC;
+        NSLog(@"%lu threads: %.0f posts/s", (unsigned long)threadCount, total / seconds);
+    }];
+    [observation remove];
+}
+
+- (void)measureHubWithThreadCount:(NSUInteger)threadCount
+{
+    NSString *name = [[PANNotificationHub defaultHub] registerName:hubBenchmarkNotification];
+    [self measureWithThreadCount:threadCount name:name post:^(NSString *postedName, id object) {
+        [[PANNotificationHub defaultHub] postNotificationName:postedName object:object userInfo:nil];
+    }];
+}
+
+- (void)measureNotificationCenterWithThreadCount:(NSUInteger)threadCount
+{
+    [self measureWithThreadCount:threadCount name:benchmarkNotification post:^(NSString *postedName, id object) {
+        [[NSNotificationCenter defaultCenter] postNotificationName:postedName object:object userInfo:nil];
+    }];
+}
+
+- (void)testHub1Thread    { [self measureHubWithThreadCount:1]; }
+- (void)testHub2Threads   { [self measureHubWithThreadCount:2]; }
+- (void)testHub4Threads   { [self measureHubWithThreadCount:4]; }
+- (void)testHub8Threads   { [self measureHubWithThreadCount:8]; }
+- (void)testHub16Threads  { [self measureHubWithThreadCount:16]; }
+
+- (void)testNotificationCenter1Thread    { [self measureNotificationCenterWithThreadCount:1]; }
+- (void)testNotificationCenter2Threads   { [self measureNotificationCenterWithThreadCount:2]; }
+- (void)testNotificationCenter4Threads   { [self measureNotificationCenterWithThreadCount:4]; }
+- (void)testNotificationCenter8Threads   { [self measureNotificationCenterWithThreadCount:8]; }
+- (void)testNotificationCenter16Threads  { [self measureNotificationCenterWithThreadCount:16]; }
+
+@end
+
+
+#pragma mark - notification coalescing
+
+static const NSUInteger coalescingBurstPosts = 10000;
+static _Atomic(NSUInteger) coalescingDeliveries; // counted on the delivery queue, read on the test's thread
+
+@interface TestNotificationCoalescingPerformance : XCTestCase
+@end
+
+@implementation TestNotificationCoalescingPerformance
+
+// a burst of posts while the queue's busy, then counts the deliveries once it catches up. the mailbox is drained
+// in slices that each re-enqueue the next, so wait for the expected count rather than for the queue to be idle
+- (void)measureBurstWithCoalescing:(PANNotificationCoalescing)coalescing expectedDeliveries:(NSUInteger)expectedDeliveries
+{
+    dispatch_queue_t queue = dispatch_queue_create("deliveries", DISPATCH_QUEUE_SERIAL);
+    dispatch_semaphore_t caughtUp = dispatch_semaphore_create(0);
+    [self pan_observeForNotifications:self named:benchmarkNotification onGCDQueue:queue coalescing:coalescing withBlock:^(id obj, PANObservation *obs) {
+        if (atomic_fetch_add(&coalescingDeliveries, 1) + 1 == expectedDeliveries)
+            dispatch_semaphore_signal(caughtUp);
+    }];
+
+    [self measureBlock:^{
+        atomic_store(&coalescingDeliveries, 0);
+        dispatch_suspend(queue);
+        for (NSUInteger i = 0; i < coalescingBurstPosts; i++)
+            [self pan_postNotificationNamed:benchmarkNotification userInfo:@{ @"index": @(i) }];
+        dispatch_resume(queue);
+        long timedOut = dispatch_semaphore_wait(caughtUp, dispatch_time(DISPATCH_TIME_NOW, 10 * NSEC_PER_SEC));
+        XCTAssertEqual(timedOut, 0);
+        dispatch_sync(queue, ^{}); // any delivery beyond those expected would have been queued by now
+        XCTAssertEqual(atomic_load(&coalescingDeliveries), expectedDeliveries);
+    }];
+    [self pan_stopObservingForNotifications:self named:benchmarkNotification];
+}
+
+- (void)testCoalescedBurst
+{
+    [self measureBurstWithCoalescing:PANNotificationCoalescingByName expectedDeliveries:1];
+}
+
+- (void)testUncoalescedBurst
+{
+    [self measureBurstWithCoalescing:PANNotificationCoalescingNone expectedDeliveries:coalescingBurstPosts];
+}
+
+@end
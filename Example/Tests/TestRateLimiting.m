@@ -0,0 +1,127 @@
+//
+//  TestRateLimiting.m
+//  Panopticon Example
+//
+//  Created by Pierre Houston on 2016-05-24.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+@import XCTest;
+#import <Panopticon/Panopticon.h>
+#import <Panopticon/PANObservationScheduler.h>
+#import "ModelObject.h"
+
+static const uint64_t millisecond = NSEC_PER_MSEC;
+
+@interface TestRateLimiting : XCTestCase
+@property (nonatomic) ModelObject *modelObject;
+@property (nonatomic) PANObservationScheduler *scheduler;
+@property (nonatomic) NSUInteger deliveredCount;
+@end
+
+@implementation TestRateLimiting
+
+- (void)setUp
+{
+    [super setUp];
+    self.modelObject = [[ModelObject alloc] init];
+    self.scheduler = [[PANObservationScheduler alloc] initWithVirtualTime];
+    [PANObservationScheduler setSharedScheduler:self.scheduler];
+    self.deliveredCount = 0;
+}
+
+- (void)tearDown
+{
+    [PANObservationScheduler setSharedScheduler:nil];
+    [super tearDown];
+}
+
+- (PANObservation *)observeWithRateLimiting:(PANRateLimiting)rateLimiting
+{
+    // no queue, so held back triggers are delivered synchronously as virtual time advances
+    typeof(self) __weak welf = self;
+    PANObservation *observation = [self pan_observeForNotifications:self.modelObject named:NameChangedNotification withBlock:^(id obj, PANObservation *obs) {
+        welf.deliveredCount++;
+    }];
+    observation.rateLimiting = rateLimiting;
+    observation.rateLimitInterval = 0.1;
+    return observation;
+}
+
+// trigger every `step` ms until `duration` ms, then let another 500ms pass
+- (void)triggerEvery:(uint64_t)step until:(uint64_t)duration
+{
+    for (uint64_t t = 0; t < duration; t += step) {
+        self.modelObject.name = @""; // should trigger notification, see -[ModelObject setName]
+        [self.scheduler advanceTimeByNanoseconds:step * millisecond];
+    }
+    [self.scheduler advanceTimeByNanoseconds:500 * millisecond];
+}
+
+- (void)testDebounceTrailing
+{
+    [self observeWithRateLimiting:PANRateLimitingDebounceTrailing];
+    self.modelObject.name = @"";
+    [self.scheduler advanceTimeByNanoseconds:50 * millisecond];
+    self.modelObject.name = @"";
+    [self.scheduler advanceTimeByNanoseconds:99 * millisecond];
+    XCTAssertEqual(self.deliveredCount, 0);
+    [self.scheduler advanceTimeByNanoseconds:2 * millisecond];
+    XCTAssertEqual(self.deliveredCount, 1);
+    
+    [self triggerEvery:10 until:1000];
+    XCTAssertEqual(self.deliveredCount, 2);
+}
+
+- (void)testDebounceLeading
+{
+    [self observeWithRateLimiting:PANRateLimitingDebounceLeading];
+    [self triggerEvery:10 until:1000];
+    XCTAssertEqual(self.deliveredCount, 1);
+    [self triggerEvery:200 until:1000];
+    XCTAssertEqual(self.deliveredCount, 6);
+}
+
+- (void)testThrottle
+{
+    [self observeWithRateLimiting:PANRateLimitingThrottle];
+    // right away at 0, then the latest at 100, 200 & 300
+    [self triggerEvery:10 until:260];
+    XCTAssertEqual(self.deliveredCount, 4);
+}
+
+- (void)testSample
+{
+    [self observeWithRateLimiting:PANRateLimitingSample];
+    // at 100, 200, 300, nothing to deliver at 400 so sampling stops
+    [self triggerEvery:30 until:300];
+    XCTAssertEqual(self.deliveredCount, 3);
+}
+
+- (void)testTrailingDeliveryIsSnapshot
+{
+    PANObservation * __block delivered = nil;
+    PANObservation *observation = [self pan_observeForNotifications:self.modelObject named:NameChangedNotification withBlock:^(id obj, PANObservation *obs) {
+        [obs keepSnapshot];
+        delivered = obs;
+    }];
+    observation.rateLimiting = PANRateLimitingDebounceTrailing;
+    observation.rateLimitInterval = 0.1;
+    observation.deliversSnapshots = YES;
+    self.modelObject.name = @"";
+    [self.scheduler advanceTimeByNanoseconds:200 * millisecond];
+    XCTAssertNotNil(delivered);
+    XCTAssertNotEqual(delivered, observation);
+    XCTAssertEqual(delivered.object, self.modelObject);
+}
+
+- (void)testRemoveCancelsPendingDelivery
+{
+    PANObservation *observation = [self observeWithRateLimiting:PANRateLimitingDebounceTrailing];
+    self.modelObject.name = @"";
+    [observation remove];
+    [self.scheduler advanceTimeByNanoseconds:500 * millisecond];
+    XCTAssertEqual(self.deliveredCount, 0);
+}
+
+@end
@@ -18,9 +18,9 @@
 @end
 
 @interface PANObservation (PrivateMethodsExposedForTesting)
-+ (NSSet *)associatedObservationsForObserver:(id)observer;
-+ (NSSet *)associatedObservationsForObservee:(id)object;
-+ (NSSet *)associatedObservationsForObserver:(nullable id)observer observee:(nullable id)observee;
++ (nullable NSArray *)associatedObservationsForObserver:(id)observer;
++ (nullable NSArray *)associatedObservationsForObservee:(id)object;
++ (nullable NSArray *)associatedObservationsForObserver:(nullable id)observer observee:(nullable id)observee;
 @end
 
 
@@ -144,6 +144,21 @@
     XCTAssertEqual(sameobs, observation);
 }
 
+- (void)testNotificationFromOtherObjectNotDelivered
+{
+    NSObject *poster = [[NSObject alloc] init];
+    NSObject *otherPoster = [[NSObject alloc] init];
+    NSUInteger __block count = 0;
+    [self pan_observeForNotifications:poster named:@"blah" withBlock:^(id obj, PANObservation *obs) {
+        count++;
+    }];
+    [[NSNotificationCenter defaultCenter] postNotificationName:@"blah" object:otherPoster]; // should not trigger notification
+    XCTAssertEqual(count, 0);
+    [[NSNotificationCenter defaultCenter] postNotificationName:@"blah" object:poster]; // should trigger notification
+    XCTAssertEqual(count, 1);
+    [self pan_stopObservingForNotifications:poster named:@"blah"];
+}
+
 - (void)testAnyNotification
 {
     typeof(self) __weak welf = self;
@@ -179,6 +194,224 @@
     XCTAssertEqual(samequeue, self.queue);
 }
 
+- (void)testNotificationTimestamp
+{
+    uint64_t __block nanoseconds = 0;
+    NSDate * __block date = nil;
+    [self pan_observeForNotifications:self.modelObject named:NameChangedNotification withBlock:^(id obj, PANObservation *obs) {
+        nanoseconds = obs.timestampNanoseconds;
+        date = obs.timestamp;
+    }];
+    uint64_t before = PANTimestampNanosecondsNow();
+    self.modelObject.name = @""; // should trigger notification, see -[ModelObject setName]
+    uint64_t after = PANTimestampNanosecondsNow();
+    XCTAssertGreaterThanOrEqual(nanoseconds, before);
+    XCTAssertLessThanOrEqual(nanoseconds, after);
+    XCTAssertEqualWithAccuracy(date.timeIntervalSinceNow, 0.0, 1.0);
+}
+
+- (void)testPausedNotificationCollation
+{
+    NSUInteger __block callCount = 0;
+    NSArray * __block collated = nil;
+    [self pan_observeForNotifications:self.modelObject named:NameChangedNotification initiallyPaused:YES withBlock:^(id obj, PANObservation *obs) {
+        callCount++;
+        collated = obs.collated;
+    }];
+    for (NSUInteger i = 0; i < 100; i++)
+        self.modelObject.name = @""; // should trigger notification, see -[ModelObject setName]
+    XCTAssertEqual(callCount, 0);
+
+    [self pan_resumeObservingForNotifications:self.modelObject named:NameChangedNotification];
+    XCTAssertEqual(callCount, 1);
+    XCTAssertEqual(collated.count, 100);
+    XCTAssertEqual(((id<PANDetectedObservation>)collated.lastObject).object, self.modelObject);
+}
+
+- (void)testPausedNotificationCollationLimit
+{
+    NSArray * __block collated = nil;
+    NSUInteger __block dropped = 0;
+    PANObservation *observation = [self pan_observeForNotifications:self.modelObject named:NameChangedNotification initiallyPaused:YES withBlock:^(id obj, PANObservation *obs) {
+        collated = obs.collated;
+        dropped = obs.droppedCount;
+    }];
+    observation.collationLimit = 10;
+    observation.collationOverflowPolicy = PANCollationOverflowKeepFirstAndLast;
+    for (NSUInteger i = 0; i < 100; i++)
+        self.modelObject.name = @""; // should trigger notification, see -[ModelObject setName]
+
+    [self pan_resumeObservingForNotifications:self.modelObject named:NameChangedNotification];
+    XCTAssertEqual(collated.count, 10);
+    XCTAssertEqual(dropped, 90);
+    XCTAssertEqual(observation.droppedCount, 0); // only meaningful within the block
+}
+
+- (void)testSuspendAllObservations
+{
+    NSMutableArray *collatedCounts = [NSMutableArray array];
+    NSUInteger __block uncollatedCallCount = 0;
+    [self pan_observeForNotifications:self.modelObject named:NameChangedNotification withBlock:^(id obj, PANObservation *obs) {
+        [collatedCounts addObject:@(obs.collated.count)];
+    }];
+    PANObservation *uncollated = [self pan_observeAllNotificationsNamed:NameChangedNotification withBlock:^(id obj, PANObservation *obs) {
+        uncollatedCallCount++;
+    }];
+    uncollated.collates = NO;
+    
+    [PANObservation suspendAllObservations];
+    XCTAssertTrue([PANObservation allObservationsSuspended]);
+    for (NSUInteger i = 0; i < 5; i++)
+        self.modelObject.name = @""; // should trigger notification, see -[ModelObject setName]
+    XCTAssertEqual(collatedCounts.count, 0);
+    
+    [PANObservation resumeAllObservations];
+    XCTAssertFalse([PANObservation allObservationsSuspended]);
+    XCTAssertEqualObjects(collatedCounts, @[@5]);
+    XCTAssertEqual(uncollatedCallCount, 0);
+    
+    self.modelObject.name = @"";
+    XCTAssertEqualObjects(collatedCounts, (@[@5, @0]));
+    XCTAssertEqual(uncollatedCallCount, 1);
+}
+
+- (void)testObservationBag
+{
+    PANObservationBag *bag = [[PANObservationBag alloc] init];
+    NSMutableArray *collatedCounts = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 3; i++) {
+        [bag addObservation:[self pan_observeForNotifications:self.modelObject named:NameChangedNotification withBlock:^(id obj, PANObservation *obs) {
+            [collatedCounts addObject:@(obs.collated.count)];
+        }]];
+    }
+    
+    bag.paused = YES;
+    for (NSUInteger i = 0; i < 10; i++)
+        self.modelObject.name = @""; // should trigger notification, see -[ModelObject setName]
+    XCTAssertEqual(collatedCounts.count, 0);
+    
+    bag.paused = NO;
+    XCTAssertEqualObjects(collatedCounts, (@[@10, @10, @10]));
+    
+    NSArray *observations = bag.observations;
+    [bag removeAllObservations];
+    XCTAssertEqual(bag.observations.count, 0);
+    for (PANObservation *observation in observations)
+        XCTAssertFalse(observation.registered);
+    XCTAssertEqual([PANObservation associatedObservationsForObserver:self].count, 0);
+}
+
+- (void)testBatchedNotificationDelivery
+{
+    NSMutableArray *batchCounts = [NSMutableArray array];
+    PANObservation *observation = [self pan_observeForNotifications:self.modelObject named:NameChangedNotification withBlock:^(id obj, PANObservation *obs) {
+        [batchCounts addObject:@(obs.collated.count)];
+    }];
+    observation.batchesDeliveries = YES;
+    observation.maximumBatchSize = 40;
+    for (NSUInteger i = 0; i < 100; i++)
+        self.modelObject.name = @""; // should trigger notification, see -[ModelObject setName]
+    XCTAssertEqual(batchCounts.count, 0);
+    
+    // with no queue, batches are delivered on the main queue
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    XCTAssertEqualObjects(batchCounts, (@[ @40, @40, @20 ]));
+}
+
+// posts 10 notifications while the first delivery is held up, then lets them all through
+- (NSArray *)deliveredWithBackpressurePolicy:(PANBackpressurePolicy)policy observation:(PANObservation * __autoreleasing *)outObservation
+{
+    NSString *name = @"BackpressureTestNotification";
+    dispatch_queue_t queue = dispatch_queue_create("backpressure", DISPATCH_QUEUE_SERIAL);
+    dispatch_semaphore_t gate = dispatch_semaphore_create(0);
+    NSMutableArray *delivered = [NSMutableArray array];
+    PANObservation *observation = [self pan_observeForNotifications:self.modelObject named:name onGCDQueue:queue withBlock:^(id obj, PANObservation *obs) {
+        dispatch_semaphore_wait(gate, DISPATCH_TIME_FOREVER);
+        [delivered addObject:((PANNotificationObservation *)obs).userInfo[@"i"]];
+    }];
+    observation.maximumInFlightDeliveries = 2;
+    observation.backpressurePolicy = policy;
+    
+    for (NSUInteger i = 0; i < 10; i++)
+        [[NSNotificationCenter defaultCenter] postNotificationName:name object:self.modelObject userInfo:@{ @"i": @(i) }];
+    for (NSUInteger i = 0; i < 10; i++)
+        dispatch_semaphore_signal(gate);
+    dispatch_sync(queue, ^{ }); // after the drain
+    [observation remove];
+    
+    *outObservation = observation;
+    return delivered;
+}
+
+- (void)testBackpressureDrop
+{
+    PANObservation *observation = nil;
+    NSArray *delivered = [self deliveredWithBackpressurePolicy:PANBackpressureDropNewest observation:&observation];
+    XCTAssertEqualObjects(delivered, (@[ @0, @1 ]));
+    XCTAssertEqual(observation.backpressureDroppedCount, 8);
+}
+
+- (void)testBackpressureCoalesce
+{
+    PANObservation *observation = nil;
+    NSArray *delivered = [self deliveredWithBackpressurePolicy:PANBackpressureCoalesceIntoNewest observation:&observation];
+    XCTAssertEqualObjects(delivered, (@[ @0, @1, @9 ]));
+    XCTAssertEqual(observation.backpressureCoalescedCount, 7);
+    XCTAssertEqual(observation.backpressureDroppedCount, 0);
+}
+
+- (void)testNotificationSnapshotsOnConcurrentQueue
+{
+    NSString *name = @"SnapshotTestNotification";
+    dispatch_queue_t queue = dispatch_queue_create("snapshots", DISPATCH_QUEUE_CONCURRENT);
+    dispatch_group_t group = dispatch_group_create();
+    NSMutableSet *received = [NSMutableSet set];
+    NSUInteger __block clobbered = 0;
+    PANObservation *observation = [self pan_observeForNotifications:self.modelObject named:name onGCDQueue:queue withBlock:^(id obj, PANObservation *obs) {
+        NSNumber *before = ((PANNotificationObservation *)obs).userInfo[@"i"];
+        [NSThread sleepForTimeInterval:0.001]; // let other deliveries run meanwhile
+        NSNumber *after = ((PANNotificationObservation *)obs).userInfo[@"i"];
+        @synchronized(received) {
+            if (![before isEqual:after])
+                clobbered++;
+            [received addObject:before];
+        }
+        dispatch_group_leave(group);
+    }];
+    observation.deliversSnapshots = YES;
+    
+    for (NSUInteger i = 0; i < 100; i++) {
+        dispatch_group_enter(group);
+        [[NSNotificationCenter defaultCenter] postNotificationName:name object:self.modelObject userInfo:@{ @"i": @(i) }];
+    }
+    dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, 10 * NSEC_PER_SEC));
+    [observation remove];
+    
+    XCTAssertEqual(clobbered, 0);
+    XCTAssertEqual(received.count, 100);
+}
+
+- (void)testKeptSnapshotsNotReused
+{
+    NSString *name = @"KeptSnapshotTestNotification";
+    dispatch_queue_t queue = dispatch_queue_create("snapshots", DISPATCH_QUEUE_SERIAL);
+    NSMutableArray *kept = [NSMutableArray array];
+    PANObservation *observation = [self pan_observeForNotifications:self.modelObject named:name onGCDQueue:queue withBlock:^(id obj, PANObservation *obs) {
+        [obs keepSnapshot];
+        [kept addObject:obs];
+    }];
+    observation.deliversSnapshots = YES;
+    
+    for (NSUInteger i = 0; i < 10; i++)
+        [[NSNotificationCenter defaultCenter] postNotificationName:name object:self.modelObject userInfo:@{ @"i": @(i) }];
+    dispatch_sync(queue, ^{});
+    [observation remove];
+    
+    XCTAssertEqual(kept.count, 10);
+    for (NSUInteger i = 0; i < kept.count; i++)
+        XCTAssertEqualObjects(((PANNotificationObservation *)kept[i]).userInfo[@"i"], @(i));
+}
+
 
 #if 0 // these tests are disabled because addObserver:forKeyPath:.. seems to crash when run in a text case, no workaround found yet
 - (void)testKVO
@@ -281,13 +514,13 @@
     PANObservation *observation1 = [self pan_observeForNotifications:self.modelObject named:NameChangedNotification withBlock:^(id obj, PANObservation *obs) { }];
     PANObservation *observation2 = [self pan_observeAllNotificationsNamed:NameChangedNotification withBlock:^(id obj, PANObservation *obs) { }];
     
-    NSSet *observationsBeforeRemoval = [PANObservation associatedObservationsForObserver:self];
+    NSArray *observationsBeforeRemoval = [PANObservation associatedObservationsForObserver:self];
     XCTAssertTrue([observationsBeforeRemoval containsObject:observation1]);
     XCTAssertTrue([observationsBeforeRemoval containsObject:observation2]);
     
     [observation1 remove];
     
-    NSSet *observationsAfterRemoval = [PANObservation associatedObservationsForObserver:self];
+    NSArray *observationsAfterRemoval = [PANObservation associatedObservationsForObserver:self];
     XCTAssertFalse([observationsAfterRemoval containsObject:observation1]);
     XCTAssertTrue([observationsAfterRemoval containsObject:observation2]);
 }
@@ -297,18 +530,38 @@
     PANObservation *observation1 = [self pan_observeForNotifications:self.modelObject named:NameChangedNotification withBlock:^(id obj, PANObservation *obs) { }];
     PANObservation *observation2 = [self pan_observeAllNotificationsNamed:NameChangedNotification withBlock:^(id obj, PANObservation *obs) { }];
     
-    NSSet *observationsBeforeRemoval = [PANObservation associatedObservationsForObserver:self];
+    NSArray *observationsBeforeRemoval = [PANObservation associatedObservationsForObserver:self];
     XCTAssertTrue([observationsBeforeRemoval containsObject:observation1]);
     XCTAssertTrue([observationsBeforeRemoval containsObject:observation2]);
     
     BOOL found = [self pan_stopObservingForNotifications:self.modelObject named:NameChangedNotification];
     XCTAssertTrue(found);
     
-    NSSet *observationsAfterRemoval = [PANObservation associatedObservationsForObserver:self];
+    NSArray *observationsAfterRemoval = [PANObservation associatedObservationsForObserver:self];
     XCTAssertFalse([observationsAfterRemoval containsObject:observation1]);
     XCTAssertTrue([observationsAfterRemoval containsObject:observation2]);
 }
 
+- (void)testRemoveAllObservations
+{
+    PANObservation *observation1 = [self pan_observeForNotifications:self.modelObject named:NameChangedNotification withBlock:^(id obj, PANObservation *obs) { }];
+    PANObservation *observation2 = [self pan_observeAllNotificationsNamed:NameChangedNotification withBlock:^(id obj, PANObservation *obs) { }];
+    PANObservation *observation3 = [self.modelObject pan_observeAllNotificationsNamed:NameChangedNotification withBlock:^(id obj, PANObservation *obs) { }];
+    observation2.removeAutomatically = NO; // removed regardless
+    
+    [self pan_removeAllObservations];
+    
+    XCTAssertFalse(observation1.registered);
+    XCTAssertFalse(observation2.registered);
+    XCTAssertTrue(observation3.registered);
+    XCTAssertEqual([PANObservation associatedObservationsForObserver:self].count, 0);
+    NSArray *modelObjectObservations = [PANObservation associatedObservationsForObserver:self.modelObject];
+    XCTAssertFalse([modelObjectObservations containsObject:observation1]); // gone from the other object's registry too
+    XCTAssertTrue([modelObjectObservations containsObject:observation3]);
+    
+    [observation3 remove];
+}
+
 - (void)testImplicitRemoval
 {
     PANObservation *observation1, *observation2;
@@ -317,7 +570,7 @@
         observation2 = [self pan_observeAllNotificationsNamed:NameChangedNotification withBlock:^(id obj, PANObservation *obs) { }];
     }
     
-    NSSet *observationsBeforeRemoval = [PANObservation associatedObservationsForObserver:self observee:nil];
+    NSArray *observationsBeforeRemoval = [PANObservation associatedObservationsForObserver:self observee:nil];
     XCTAssertTrue([observationsBeforeRemoval containsObject:observation1]);
     XCTAssertTrue([observationsBeforeRemoval containsObject:observation2]);
     
@@ -326,7 +579,7 @@
     // without use of @autoreleasepool above, the property would have a strong retain by the main autorelease pool until after this method exited
     // so modelObject's dealloc wouldn't run until then, which would mean observation1 would not be removed here and the first assertion below would fail
     
-    NSSet *observationsAfterRemoval = [PANObservation associatedObservationsForObserver:self observee:nil];
+    NSArray *observationsAfterRemoval = [PANObservation associatedObservationsForObserver:self observee:nil];
     XCTAssertFalse([observationsAfterRemoval containsObject:observation1]);
     XCTAssertTrue([observationsAfterRemoval containsObject:observation2]);
 }
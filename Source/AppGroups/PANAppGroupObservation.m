@@ -89,15 +89,7 @@ PAN_ASSUME_NONNULL_BEGIN
             else if (postDatesAndPayloads.count == 1) {
                 // trigger with the single post
                 NSArray *postDateAndPayload = postDatesAndPayloads.firstObject;
-                
-                [self triggerWithSetupBlock:^(id<PANDetectedObservation> obs) {
-                    if (![obs conformsToProtocol:@protocol(PANMutableAppGroupPost)])
-                        return;
-                    id<PANMutableAppGroupPost> post = (id<PANMutableAppGroupPost>)obs;
-                    post.timestamp = postDateAndPayload.firstObject;
-                    post.payload = (postDateAndPayload.count > 1 ? postDateAndPayload[1] : nil);
-                    post.postedGroupIdentifier = groupIdentifier;
-                }];
+                [self triggerWithPostDate:postDateAndPayload.firstObject payload:(postDateAndPayload.count > 1 ? postDateAndPayload[1] : nil) groupIdentifier:groupIdentifier];
             }
             else {
                 // ensure paused then trigger with each post in order
@@ -105,16 +97,8 @@ PAN_ASSUME_NONNULL_BEGIN
                 if (!wasPaused)
                     self.paused = YES;
                 
-                for (NSArray *postDateAndPayload in postDatesAndPayloads) {
-                    [self triggerWithSetupBlock:^(id<PANDetectedObservation> obs) {
-                        if (![obs conformsToProtocol:@protocol(PANMutableAppGroupPost)])
-                            return;
-                        id<PANMutableAppGroupPost> post = (id<PANMutableAppGroupPost>)obs;
-                        post.timestamp = postDateAndPayload.firstObject;
-                        post.payload = (postDateAndPayload.count > 1 ? postDateAndPayload[1] : nil);
-                        post.postedGroupIdentifier = groupIdentifier;
-                    }];
-                }
+                for (NSArray *postDateAndPayload in postDatesAndPayloads)
+                    [self triggerWithPostDate:postDateAndPayload.firstObject payload:(postDateAndPayload.count > 1 ? postDateAndPayload[1] : nil) groupIdentifier:groupIdentifier];
                 
                 if (!wasPaused)
                     self.paused = NO;
@@ -124,14 +108,7 @@ PAN_ASSUME_NONNULL_BEGIN
     else
     {
         ok = [appGroupNotificationManager subscribeToNotificationsForGroupIdentifier:groupIdentifier named:self.name withBlock:^(NSString *identifier, NSString *name, id payload, NSDate *postDate) {
-            [self triggerWithSetupBlock:^(id<PANDetectedObservation> obs) {
-                if (![obs conformsToProtocol:@protocol(PANMutableAppGroupPost)])
-                    return;
-                id<PANMutableAppGroupPost> post = (id<PANMutableAppGroupPost>)obs;
-                post.timestamp = postDate;
-                post.payload = payload;
-                post.postedGroupIdentifier = groupIdentifier;
-            }];
+            [self triggerWithPostDate:postDate payload:payload groupIdentifier:groupIdentifier];
         }];
     }
     
@@ -140,6 +117,22 @@ PAN_ASSUME_NONNULL_BEGIN
     }
 }
 
+- (void)triggerWithPostDate:(PAN_nullable NSDate *)postDate payload:(PAN_nullable id)payload groupIdentifier:(NSString *)groupIdentifier
+{
+    // timestamped with when it was posted, possibly by another process some time ago
+    PANObservationEvent event = { self.observee, payload, groupIdentifier, postDate != nil ? PANTimestampNanosecondsFromDate(postDate) : PANTimestampNanosecondsNow() };
+    [self triggerEvent:&event synchronously:NO];
+}
+
+- (void)applyEvent:(const PANObservationEvent *)event toDetectedObservation:(id<PANMutableDetectedObservation>)detectedObservation
+{
+    [super applyEvent:event toDetectedObservation:detectedObservation];
+    if (![detectedObservation conformsToProtocol:@protocol(PANMutableAppGroupPost)])
+        return;
+    id<PANMutableAppGroupPost> post = (id<PANMutableAppGroupPost>)detectedObservation;
+    post.postedGroupIdentifier = event->detail;
+}
+
 - (void)duplicateFrom:(id<PANDetectedObservation>)source
 {
     [super duplicateFrom:source];
@@ -154,6 +147,15 @@ PAN_ASSUME_NONNULL_BEGIN
     return [[PANAppGroupPost alloc] init];
 }
 
+- (void)configureSnapshot:(PANObservation *)snapshot
+{
+    PANAppGroupObservation *appGroupSnapshot = (PANAppGroupObservation *)snapshot;
+    appGroupSnapshot.name = self.name;
+    appGroupSnapshot.groupIdentifier = self.groupIdentifier;
+    appGroupSnapshot.reliable = self.reliable;
+    [super configureSnapshot:snapshot];
+}
+
 - (void)deregisterInternal
 {
     NSAssert1(self.registered, @"Attempted double-removal of %@", self);
@@ -209,15 +211,22 @@ PAN_ASSUME_NONNULL_BEGIN
 + (PAN_nullable PANAppGroupObservation *)findObservationForObserver:(id)observer groupIdentifier:(PAN_nullable NSString *)identifier name:(NSString *)name
 {
     PANAppGroupNotificationManager *appGroupNotificationManager = [PANAppGroupNotificationManager sharedManager];
-    NSString *groupIdentifier = appGroupNotificationManager.defaultGroupIdentifier;
+    NSString *groupIdentifier = identifier != nil ? identifier : appGroupNotificationManager.defaultGroupIdentifier;
     if (groupIdentifier == nil) {
         return nil;
     }
     
-    return (PANAppGroupObservation *)[self findObservationForObserver:observer object:nil matchingTest:^BOOL(PANObservation *obs) {
-        PANAppGroupObservation *groupObservation = (PANAppGroupObservation *)obs;
-        return [obs isKindOfClass:[PANAppGroupObservation class]] && [name isEqualToString:groupObservation.name] && [groupIdentifier isEqualToString:groupObservation.groupIdentifier];
-    }];
+    PANAppGroupObservation *observation = (PANAppGroupObservation *)[self findObservationForObserver:observer object:nil indexSubkey:@[name, groupIdentifier]];
+    if (observation == nil && identifier == nil) {
+        // observation created without a group identifier, which means the default one
+        observation = (PANAppGroupObservation *)[self findObservationForObserver:observer object:nil indexSubkey:@[name, [NSNull null]]];
+    }
+    return observation;
+}
+
+- (PAN_nullable id)indexSubkey
+{
+    return @[self.name, self.groupIdentifier != nil ? self.groupIdentifier : [NSNull null]];
 }
 
 + (BOOL)postNotificationNamed:(NSString *)name payload:(PAN_nullable id)payload
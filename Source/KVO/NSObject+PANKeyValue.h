@@ -8,6 +8,8 @@
 
 #import <Foundation/Foundation.h>
 #import "PANKeyValueObservation.h"
+#import "PANDerivedObservation.h"
+#import "PANKeyValueCollectionObservation.h"
 
 PAN_ASSUME_NONNULL_BEGIN
 
@@ -773,6 +775,57 @@ PAN_ASSUME_NONNULL_BEGIN
  */
 - (BOOL)pan_resumeObservingOwnChangesToKeyPaths:(NSArray *)keyPaths;
 
+
+#pragma mark - Observe a value derived from key paths of several objects
+
+/**
+ *  Receiver observes a value computed from the same KVO key paths of each of the given objects, see
+ *  `PANDerivedObservation`. The block is only called when the computed value changes.
+ *
+ *  The observation will automatically be stopped when the receiver is deallocated. The input objects are retained
+ *  until then, or until the observation is removed.
+ *
+ *  @param objects      The input objects, each only once.
+ *  @param keyPaths     The array of KVO key path strings to observe on each object.
+ *  @param computeBlock The block computing the value, is passed the previous value and the indexes into `objects`
+ *                      of the inputs changed since.
+ *  @param queue        The operation queue on which to compute the value and call `block`, changes before the
+ *                      compute runs are handled together.
+ *  @param block        The block to call when the computed value changes, is passed the receiver and the
+ *                      observation (same as method result) whose `value` and `changedValue` are the new value.
+ *
+ *  @return An observation object. You often don't need to keep this result.
+ */
+- (PAN_nullable PANDerivedObservation *)pan_observeDerivedValueOfObjects:(NSArray *)objects keyPaths:(NSArray *)keyPaths computedBy:(PANDerivedValueBlock)computeBlock onQueue:(NSOperationQueue *)queue withBlock:(PANObservationBlock)block;
+
+- (PAN_nullable PANDerivedObservation *)pan_observeDerivedValueOfObjects:(NSArray *)objects keyPaths:(NSArray *)keyPaths computedBy:(PANDerivedValueBlock)computeBlock onGCDQueue:(dispatch_queue_t)queue withBlock:(PANObservationBlock)block;
+
+- (PAN_nullable PANDerivedObservation *)pan_observeDerivedValueOfObjects:(NSArray *)objects keyPaths:(NSArray *)keyPaths computedBy:(PANDerivedValueBlock)computeBlock withBlock:(PANObservationBlock)block;
+
+
+#pragma mark - Observe a to-many key path and key paths of its elements
+
+/**
+ *  Receiver observes changes to a to-many KVO key path of an object and to the given key paths of each element
+ *  in it, see `PANKeyValueCollectionObservation`. The observation's `elementIndex` tells which element changed,
+ *  or is `NSNotFound` if it's the collection that changed.
+ *
+ *  The observation will automatically be stopped when either the receiver or object are deallocated.
+ *
+ *  @param object          The object to observe, the collection's owner.
+ *  @param keyPath         The KVO key path of an array, ordered set or set property of the object.
+ *  @param elementKeyPaths The array of KVO key path strings to observe on each element.
+ *  @param options         A combination of `NSKeyValueObservingOptions` values, `NSKeyValueObservingOptionInitial`
+ *                         only applies to the collection.
+ *  @param block           The block to call when the collection or an element changes, is passed the receiver and
+ *                         the observation (same as method result).
+ *
+ *  @return An observation object. You often don't need to keep this result.
+ */
+- (PAN_nullable PANKeyValueCollectionObservation *)pan_observeForChanges:(id)object toCollectionKeyPath:(NSString *)keyPath elementKeyPaths:(NSArray *)elementKeyPaths options:(int)options withBlock:(PANObservationBlock)block;
+
+- (PAN_nullable PANKeyValueCollectionObservation *)pan_observeForChanges:(id)object toCollectionKeyPath:(NSString *)keyPath elementKeyPaths:(NSArray *)elementKeyPaths withBlock:(PANObservationBlock)block;
+
 @end
 
 
@@ -8,6 +8,8 @@
 
 #import "NSObject+PANKeyValue.h"
 #import "PANKeyValueObservation+Private.h"
+#import "PANDerivedObservation+Private.h"
+#import "PANKeyValueCollectionObservation+Private.h"
 #import "PANObservation+Private.h"
 
 PAN_ASSUME_NONNULL_BEGIN
@@ -770,6 +772,47 @@ PAN_ASSUME_NONNULL_BEGIN
     return NO;
 }
 
+
+#pragma mark - observer = self, value derived from several objects
+
+- (PAN_nullable PANDerivedObservation *)pan_observeDerivedValueOfObjects:(NSArray *)objects keyPaths:(NSArray *)keyPaths computedBy:(PANDerivedValueBlock)computeBlock onQueue:(NSOperationQueue *)queue withBlock:(PANObservationBlock)block
+{
+    PANDerivedObservation *observation = [[PANDerivedObservation alloc] initWithObserver:self objects:objects keyPaths:keyPaths queue:queue gcdQueue:nil computeBlock:computeBlock block:block];
+    [observation register];
+    return observation;
+}
+
+- (PAN_nullable PANDerivedObservation *)pan_observeDerivedValueOfObjects:(NSArray *)objects keyPaths:(NSArray *)keyPaths computedBy:(PANDerivedValueBlock)computeBlock onGCDQueue:(dispatch_queue_t)queue withBlock:(PANObservationBlock)block
+{
+    PANDerivedObservation *observation = [[PANDerivedObservation alloc] initWithObserver:self objects:objects keyPaths:keyPaths queue:nil gcdQueue:queue computeBlock:computeBlock block:block];
+    [observation register];
+    return observation;
+}
+
+- (PAN_nullable PANDerivedObservation *)pan_observeDerivedValueOfObjects:(NSArray *)objects keyPaths:(NSArray *)keyPaths computedBy:(PANDerivedValueBlock)computeBlock withBlock:(PANObservationBlock)block
+{
+    PANDerivedObservation *observation = [[PANDerivedObservation alloc] initWithObserver:self objects:objects keyPaths:keyPaths queue:nil gcdQueue:nil computeBlock:computeBlock block:block];
+    [observation register];
+    return observation;
+}
+
+
+#pragma mark - observer = self, observee = object, key paths of a collection's elements
+
+- (PAN_nullable PANKeyValueCollectionObservation *)pan_observeForChanges:(id)object toCollectionKeyPath:(NSString *)keyPath elementKeyPaths:(NSArray *)elementKeyPaths options:(int)options withBlock:(PANObservationBlock)block
+{
+    PANKeyValueCollectionObservation *observation = [[PANKeyValueCollectionObservation alloc] initWithObserver:self object:object keyPath:keyPath elementKeyPaths:elementKeyPaths options:options queue:nil gcdQueue:nil block:block];
+    [observation register];
+    return observation;
+}
+
+- (PAN_nullable PANKeyValueCollectionObservation *)pan_observeForChanges:(id)object toCollectionKeyPath:(NSString *)keyPath elementKeyPaths:(NSArray *)elementKeyPaths withBlock:(PANObservationBlock)block
+{
+    PANKeyValueCollectionObservation *observation = [[PANKeyValueCollectionObservation alloc] initWithObserver:self object:object keyPath:keyPath elementKeyPaths:elementKeyPaths options:0 queue:nil gcdQueue:nil block:block];
+    [observation register];
+    return observation;
+}
+
 @end
 
 
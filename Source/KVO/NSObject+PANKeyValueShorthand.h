@@ -10,13 +10,15 @@
 
 #import <Foundation/Foundation.h>
 #import "PANKeyValueObservation.h"
+#import "PANDerivedObservation.h"
+#import "PANKeyValueCollectionObservation.h"
 
 PAN_ASSUME_NONNULL_BEGIN
 
 
 @interface NSObject (PANKeyValueShorthand)
 
-#pragma mark - Observe a key path
+#pragma mark - Observe a key path on an object
 
 /**
  *  Receiver observes a KVO key path on the given object.
@@ -112,8 +114,40 @@ PAN_ASSUME_NONNULL_BEGIN
  */
 - (BOOL)stopObservingForChanges:(id)object toKeyPath:(NSString *)keyPath;
 
+/**
+ *  Receiver pauses observing a KVO key path on the given object.
+ *
+ *  Call on the same object on which you called one of the `observe..` methods above. Alternately, can save the
+ *  observation object returned from `observe..`, and change its `paused` property from `NO` to `YES`.
+ *
+ *  If `collates` is set to `YES` on the observation, any observations that are triggered after being paused will be
+ *  stored, otherwise they will be dropped.
+ *
+ *  @param object  The object to pause observing.
+ *  @param keyPath The key path string to pause observing on `object`.
+ *
+ *  @return `YES` if the receiver was previously observing this KVO key path on `object`, `NO` otherwise.
+ */
+- (BOOL)pauseObservingForChanges:(id)object toKeyPath:(NSString *)keyPath;
+
+/**
+ *  Receiver resumes observing a KVO key path on the given object.
+ *
+ *  Call on the same object on which you called one of the `observe..` methods above. Alternately, can save the
+ *  observation object returned from `observe..`, and change its `paused` property from `YES` to `NO`.
+ *
+ *  If `collates` is set to `YES` on the observation, and observations had been triggered during the time it was paused,
+ *  then the observation's block will be invoked during this call.
+ *
+ *  @param object  The object to resume observing.
+ *  @param keyPath The key path string to resume observing on `object`.
+ *
+ *  @return `YES` if the receiver was previously observing this KVO key path on `object`, `NO` otherwise.
+ */
+- (BOOL)resumeObservingForChanges:(id)object toKeyPath:(NSString *)keyPath;
+
 
-#pragma mark - Observe multiple key paths
+#pragma mark - Observe multiple key paths on an object
 
 /**
  *  Receiver observes multiple KVO key paths on the given object.
@@ -211,6 +245,40 @@ PAN_ASSUME_NONNULL_BEGIN
  */
 - (BOOL)stopObservingForChanges:(id)object toKeyPaths:(NSArray *)keyPaths;
 
+/**
+ *  Receiver pauses observing the KVO key paths on the given object.
+ *
+ *  Call on the same object on which you called one of the `observe..` methods above. Alternately, can save the
+ *  observation object returned from `observe..`, and change its `paused` property from `NO` to `YES`.
+ *
+ *  If `collates` is set to `YES` on the observation, any observations that are triggered after being paused will be
+ *  stored, otherwise they will be dropped.
+ *
+ *  @param object   The object to pause observing.
+ *  @param keyPaths The array of KVO key path strings to pause observing on `object`. Must be equal to the array passed to
+ *                  the corresponding `observe..` method.
+ *
+ *  @return `YES` if the receiver was previously observing these KVO key paths on `object`, `NO` otherwise.
+ */
+- (BOOL)pauseObservingForChanges:(id)object toKeyPaths:(NSArray *)keyPaths;
+
+/**
+ *  Receiver stops observing the KVO key paths on the given object.
+ *
+ *  Call on the same object on which you called one of the `observe..` methods above. Alternately, can save the
+ *  observation object returned from `observe..`, and change its `paused` property from `YES` to `NO`.
+ *
+ *  If `collates` is set to `YES` on the observation, and observations had been triggered during the time it was paused,
+ *  then the observation's block will be invoked during this call.
+ *
+ *  @param object   The object to resume observing.
+ *  @param keyPaths The array of KVO key path strings to resume observing on `object`. Must be equal to the array passed
+ *                  to the corresponding `observe..` method.
+ *
+ *  @return `YES` if the receiver was previously observing these KVO key paths on `object`, `NO` otherwise.
+ */
+- (BOOL)resumeObservingForChanges:(id)object toKeyPaths:(NSArray *)keyPaths;
+
 
 #pragma mark - Anonymously observe a key path on the receiver
 
@@ -302,6 +370,36 @@ PAN_ASSUME_NONNULL_BEGIN
  */
 - (BOOL)stopObservingChangesToKeyPath:(NSString *)keyPath;
 
+/**
+ *  Pause observing a KVO key path on the receiver.
+ *
+ *  Call on the same object on which you called one of the `observe..` methods above. Alternately, can save the
+ *  observation object returned from `observe..`, and change its `paused` property from `NO` to `YES`.
+ *
+ *  If `collates` is set to `YES` on the observation, any observations that are triggered after being paused will be
+ *  stored, otherwise they will be dropped.
+ *
+ *  @param keyPath The key path string to pause observing the receiver.
+ *
+ *  @return `YES` if was previously observing this KVO key path on the receiver, `NO` otherwise.
+ */
+- (BOOL)pauseObservingChangesToKeyPath:(NSString *)keyPath;
+
+/**
+ *  Stop observing a KVO key path on the receiver.
+ *
+ *  Call on the same object on which you called one of the `observe..` methods above. Alternately, can save the
+ *  observation object returned from `observe..`, and change its `paused` property from `YES` to `NO`.
+ *
+ *  If `collates` is set to `YES` on the observation, and observations had been triggered during the time it was paused,
+ *  then the observation's block will be invoked during this call.
+ *
+ *  @param keyPath The key path string to resume observing the receiver.
+ *
+ *  @return `YES` if was previously observing this KVO key path on the receiver, `NO` otherwise.
+ */
+- (BOOL)resumeObservingChangesToKeyPath:(NSString *)keyPath;
+
 
 #pragma mark - Anonymously observe multiple key paths on the receiver
 
@@ -382,7 +480,7 @@ PAN_ASSUME_NONNULL_BEGIN
 
 
 /**
- *  Receiver stops observing the KVO key paths on the receiver.
+ *  Stop observing the KVO key paths on the receiver.
  *
  *  Call on the same observed object on which you called one of the `observe..` methods above. Use to stop observing
  *  sometime before the object is deallocated. Alternately, can save the observation object returned from `observe..`,
@@ -395,6 +493,38 @@ PAN_ASSUME_NONNULL_BEGIN
  */
 - (BOOL)stopObservingChangesToKeyPaths:(NSArray *)keyPaths;
 
+/**
+ *  Pause observing the KVO key paths on the receiver.
+ *
+ *  Call on the same object on which you called one of the `observe..` methods above. Alternately, can save the
+ *  observation object returned from `observe..`, and change its `paused` property from `NO` to `YES`.
+ *
+ *  If `collates` is set to `YES` on the observation, any observations that are triggered after being paused will be
+ *  stored, otherwise they will be dropped.
+ *
+ *  @param keyPaths The array of KVO key path strings to pause observing on `object`. Must be equal to the array passed to
+ *                  the corresponding `observe..` method.
+ *
+ *  @return `YES` if was previously observing these KVO key paths on the receiver, `NO` otherwise.
+ */
+- (BOOL)pauseObservingChangesToKeyPaths:(NSArray *)keyPaths;
+
+/**
+ *  Resume observing the KVO key paths on the receiver.
+ *
+ *  Call on the same object on which you called one of the `observe..` methods above. Alternately, can save the
+ *  observation object returned from `observe..`, and change its `paused` property from `YES` to `NO`.
+ *
+ *  If `collates` is set to `YES` on the observation, and observations had been triggered during the time it was paused,
+ *  then the observation's block will be invoked during this call.
+ *
+ *  @param keyPaths The array of KVO key path strings to resume observing on `object`. Must be equal to the array passed to
+ *                  the corresponding `observe..` method.
+ *
+ *  @return `YES` if was previously observing these KVO key paths on the receiver, `NO` otherwise.
+ */
+- (BOOL)resumeObservingChangesToKeyPaths:(NSArray *)keyPaths;
+
 
 #pragma mark - Have receiver observe a key path on itself
 
@@ -483,12 +613,42 @@ PAN_ASSUME_NONNULL_BEGIN
  *  sometime before the object is deallocated. Alternately, can save the observation object returned from `observe..`,
  *  and call its `remove` method.
  *
- *  @param keyPath The key path string to stop observing the receiver.
+ *  @param keyPath The key path string to stop observing on the receiver.
  *
  *  @return `YES` if the receiver was previously observing this KVO key path on itself, `NO` otherwise.
  */
 - (BOOL)stopObservingOwnChangesToKeyPath:(NSString *)keyPath;
 
+/**
+ *  Receiver pauses observing a KVO key path on itself.
+ *
+ *  Call on the same object on which you called one of the `observe..` methods above. Alternately, can save the
+ *  observation object returned from `observe..`, and change its `paused` property from `NO` to `YES`.
+ *
+ *  If `collates` is set to `YES` on the observation, any observations that are triggered after being paused will be
+ *  stored, otherwise they will be dropped.
+ *
+ *  @param keyPath The key path string to pause observing on the receiver.
+ *
+ *  @return `YES` if the receiver was previously observing this KVO key path on itself, `NO` otherwise.
+ */
+- (BOOL)pauseObservingOwnChangesToKeyPath:(NSString *)keyPath;
+
+/**
+ *  Receiver resumes observing a KVO key path on itself.
+ *
+ *  Call on the same object on which you called one of the `observe..` methods above. Alternately, can save the
+ *  observation object returned from `observe..`, and change its `paused` property from `YES` to `NO`.
+ *
+ *  If `collates` is set to `YES` on the observation, and observations had been triggered during the time it was paused,
+ *  then the observation's block will be invoked during this call.
+ *
+ *  @param keyPath The key path string to resume observing on the receiver.
+ *
+ *  @return `YES` if the receiver was previously observing this KVO key path on itself, `NO` otherwise.
+ */
+- (BOOL)resumeObservingOwnChangesToKeyPath:(NSString *)keyPath;
+
 
 #pragma mark - Have receiver observe multiple key paths on itself
 
@@ -578,13 +738,96 @@ PAN_ASSUME_NONNULL_BEGIN
  *  sometime before the object is deallocated. Alternately, can save the observation object returned from `observe..`,
  *  and call its `remove` method.
  *
- *  @param keyPaths The array of KVO key path strings to stop observing the receiver. Must be equal to the array passed to the
- *                  corresponding `observe..` method.
+ *  @param keyPaths The array of KVO key path strings to stop observing on the receiver. Must be equal to the array passed
+ *                  to the corresponding `observe..` method.
  *
  *  @return `YES` if the receiver was previously observing these KVO key paths on itself, `NO` otherwise.
  */
 - (BOOL)stopObservingOwnChangesToKeyPaths:(NSArray *)keyPaths;
 
+/**
+ *  Receiver pauses observing multiple KVO key paths on itself.
+ *
+ *  Call on the same object on which you called one of the `observe..` methods above. Alternately, can save the
+ *  observation object returned from `observe..`, and change its `paused` property from `NO` to `YES`.
+ *
+ *  If `collates` is set to `YES` on the observation, any observations that are triggered after being paused will be
+ *  stored, otherwise they will be dropped.
+ *
+ *  @param keyPaths The array of KVO key path strings to pause observing on the receiver. Must be equal to the array passed
+ *                  to the corresponding `observe..` method.
+ *
+ *  @return `YES` if the receiver was previously observing these KVO key paths on itself, `NO` otherwise.
+ */
+- (BOOL)pauseObservingOwnChangesToKeyPaths:(NSArray *)keyPaths;
+
+/**
+ *  Receiver resumes observing multiple KVO key paths on itself.
+ *
+ *  Call on the same object on which you called one of the `observe..` methods above. Alternately, can save the
+ *  observation object returned from `observe..`, and change its `paused` property from `YES` to `NO`.
+ *
+ *  If `collates` is set to `YES` on the observation, and observations had been triggered during the time it was paused,
+ *  then the observation's block will be invoked during this call.
+ *
+ *  @param keyPaths The array of KVO key path strings to resume observing on the receiver. Must be equal to the array passed
+ *                  to the corresponding `observe..` method.
+ *
+ *  @return `YES` if the receiver was previously observing these KVO key paths on itself, `NO` otherwise.
+ */
+- (BOOL)resumeObservingOwnChangesToKeyPaths:(NSArray *)keyPaths;
+
+
+#pragma mark - Observe a value derived from key paths of several objects
+
+/**
+ *  Receiver observes a value computed from the same KVO key paths of each of the given objects, see
+ *  `PANDerivedObservation`. The block is only called when the computed value changes.
+ *
+ *  The observation will automatically be stopped when the receiver is deallocated. The input objects are retained
+ *  until then, or until the observation is removed.
+ *
+ *  @param objects      The input objects, each only once.
+ *  @param keyPaths     The array of KVO key path strings to observe on each object.
+ *  @param computeBlock The block computing the value, is passed the previous value and the indexes into `objects`
+ *                      of the inputs changed since.
+ *  @param queue        The operation queue on which to compute the value and call `block`, changes before the
+ *                      compute runs are handled together.
+ *  @param block        The block to call when the computed value changes, is passed the receiver and the
+ *                      observation (same as method result) whose `value` and `changedValue` are the new value.
+ *
+ *  @return An observation object. You often don't need to keep this result.
+ */
+- (PAN_nullable PANDerivedObservation *)observeDerivedValueOfObjects:(NSArray *)objects keyPaths:(NSArray *)keyPaths computedBy:(PANDerivedValueBlock)computeBlock onQueue:(NSOperationQueue *)queue withBlock:(PANObservationBlock)block;
+
+- (PAN_nullable PANDerivedObservation *)observeDerivedValueOfObjects:(NSArray *)objects keyPaths:(NSArray *)keyPaths computedBy:(PANDerivedValueBlock)computeBlock onGCDQueue:(dispatch_queue_t)queue withBlock:(PANObservationBlock)block;
+
+- (PAN_nullable PANDerivedObservation *)observeDerivedValueOfObjects:(NSArray *)objects keyPaths:(NSArray *)keyPaths computedBy:(PANDerivedValueBlock)computeBlock withBlock:(PANObservationBlock)block;
+
+
+#pragma mark - Observe a to-many key path and key paths of its elements
+
+/**
+ *  Receiver observes changes to a to-many KVO key path of an object and to the given key paths of each element
+ *  in it, see `PANKeyValueCollectionObservation`. The observation's `elementIndex` tells which element changed,
+ *  or is `NSNotFound` if it's the collection that changed.
+ *
+ *  The observation will automatically be stopped when either the receiver or object are deallocated.
+ *
+ *  @param object          The object to observe, the collection's owner.
+ *  @param keyPath         The KVO key path of an array, ordered set or set property of the object.
+ *  @param elementKeyPaths The array of KVO key path strings to observe on each element.
+ *  @param options         A combination of `NSKeyValueObservingOptions` values, `NSKeyValueObservingOptionInitial`
+ *                         only applies to the collection.
+ *  @param block           The block to call when the collection or an element changes, is passed the receiver and
+ *                         the observation (same as method result).
+ *
+ *  @return An observation object. You often don't need to keep this result.
+ */
+- (PAN_nullable PANKeyValueCollectionObservation *)observeForChanges:(id)object toCollectionKeyPath:(NSString *)keyPath elementKeyPaths:(NSArray *)elementKeyPaths options:(int)options withBlock:(PANObservationBlock)block;
+
+- (PAN_nullable PANKeyValueCollectionObservation *)observeForChanges:(id)object toCollectionKeyPath:(NSString *)keyPath elementKeyPaths:(NSArray *)elementKeyPaths withBlock:(PANObservationBlock)block;
+
 @end
 
 
@@ -0,0 +1,21 @@
+//
+//  PANDerivedObservation+Private.h
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-28.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANDerivedObservation.h"
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+@interface PANDerivedObservation (Private)
+
+- (instancetype)initWithObserver:(id)observer objects:(NSArray *)objects keyPaths:(NSArray *)keyPaths queue:(PAN_nullable NSOperationQueue *)queue gcdQueue:(PAN_nullable dispatch_queue_t)gcdQueue computeBlock:(PANDerivedValueBlock)computeBlock block:(PANObservationBlock)block;
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
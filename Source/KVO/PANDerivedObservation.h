@@ -0,0 +1,64 @@
+//
+//  PANDerivedObservation.h
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-28.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANKeyValueObservation.h"
+
+
+/**
+ *  Block type for computing the value of a `PANDerivedObservation` from its input objects. Declared outside the
+ *  nonnull region since both values can be `nil`.
+ *
+ *  @param previousValue The value returned by the previous call, `nil` the first time.
+ *  @param changedInputs Indexes into `inputObjects` of the inputs changed since the previous call, all of them the
+ *                       first time. Lets the block update `previousValue` incrementally instead of starting over.
+ *
+ *  @return The new value.
+ */
+typedef id (^PANDerivedValueBlock)(id previousValue, NSIndexSet *changedInputs);
+
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+/**
+ *  An observation of a value computed from several key paths of several objects, such as a total of the prices
+ *  and quantities of a list of items. Its observation block is only called when the computed value changes.
+ *
+ *  The value is computed when the observation is registered, then again after its inputs change, at most once per
+ *  batch of changes: changes made before a recompute gets to run on the observation's `queue` or `gcdQueue` are
+ *  handled by that one recompute. With neither queue, every change is a batch of its own and recomputes at once.
+ *  If the result is equal to the previous value, using `isEqual:`, the block isn't called.
+ *
+ *  When the block is called, `keyPath` is `@"value"`, `changedValue` is the new value and `oldValue` the previous
+ *  one, a `nil` value being `NSNull`. The input objects are shared with other KVO observations through their
+ *  dispatchers, and are found from a change by a binary search of a table made when the observation is created.
+ *
+ *  The input objects are retained by the observation, and it's removed automatically when its observer is
+ *  deallocated.
+ */
+@interface PANDerivedObservation : PANKeyValueObservation
+
+/**
+ *  The objects whose `keyPaths` are observed.
+ */
+@property (nonatomic, readonly) NSArray *inputObjects;
+
+/**
+ *  The value last computed.
+ */
+@property (nonatomic, readonly, PAN_nullable) id value;
+
+/**
+ *  Number of times the value has been computed, including the first.
+ */
+@property (nonatomic, readonly) NSUInteger computeCount;
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
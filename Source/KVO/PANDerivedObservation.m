@@ -0,0 +1,267 @@
+//
+//  PANDerivedObservation.m
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-28.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANDerivedObservation.h"
+#import "PANDerivedObservation+Private.h"
+#import "PANKeyValueObservation+Private.h"
+#import "PANObservation+Private.h"
+#import "PANKeyValueDispatcher.h"
+#import "PANKeyValueTransaction.h"
+#import <pthread.h>
+#import <stdlib.h>
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+static NSString * const PANDerivedValueKeyPath = @"value";
+
+// an input object's address & its index in inputObjects, kept sorted by address
+typedef struct PANDerivedInputSlot {
+    uintptr_t address;
+    NSUInteger index;
+} PANDerivedInputSlot;
+
+static int PANCompareDerivedInputSlots(const void *a, const void *b)
+{
+    uintptr_t addressA = ((const PANDerivedInputSlot *)a)->address, addressB = ((const PANDerivedInputSlot *)b)->address;
+    return addressA < addressB ? -1 : addressA > addressB ? 1 : 0;
+}
+
+
+@implementation PANDerivedObservation
+{
+    PANDerivedValueBlock _computeBlock;
+    PANDerivedInputSlot *_inputSlots; // one per input, to find an input's index without hashing
+    NSArray *_dispatchers; // the inputs', non-nil while registered
+    pthread_mutex_t _computeLock; // guards the following
+    NSMutableIndexSet *_changedInputs; // since the last compute
+    BOOL _computing; // a compute is scheduled or running, further changes join its batch
+    id _value;
+    NSUInteger _computeCount;
+}
+
+- (instancetype)initWithObserver:(PAN_nullable id)observer object:(PAN_nullable id)observee queue:(PAN_nullable NSOperationQueue *)queue gcdQueue:(PAN_nullable dispatch_queue_t)gcdQueue block:(PAN_nullable PANObservationBlock)block
+{
+    if (!(self = [super initWithObserver:observer object:observee queue:queue gcdQueue:gcdQueue block:block]))
+        return nil;
+    pthread_mutex_init(&_computeLock, NULL);
+    _changedInputs = [NSMutableIndexSet indexSet];
+    return self;
+}
+
+- (instancetype)initWithObject:(PAN_nullable id)observee queue:(PAN_nullable NSOperationQueue *)queue gcdQueue:(PAN_nullable dispatch_queue_t)gcdQueue block:(PAN_nullable PANAnonymousObservationBlock)block
+{
+    if (!(self = [super initWithObject:observee queue:queue gcdQueue:gcdQueue block:block]))
+        return nil;
+    pthread_mutex_init(&_computeLock, NULL);
+    _changedInputs = [NSMutableIndexSet indexSet];
+    return self;
+}
+
+- (instancetype)initWithObserver:(id)observer objects:(NSArray *)objects keyPaths:(NSArray *)keyPaths queue:(PAN_nullable NSOperationQueue *)queue gcdQueue:(PAN_nullable dispatch_queue_t)gcdQueue computeBlock:(PANDerivedValueBlock)computeBlock block:(PANObservationBlock)block
+{
+    // the observer is also the observee, so the observation is kept in only its registry
+    if (!(self = [self initWithObserver:observer object:observer keyPaths:keyPaths options:0 queue:queue gcdQueue:gcdQueue block:block]))
+        return nil;
+    if (objects.count == 0)
+        [NSException raise:NSInvalidArgumentException format:@"Derived observation needs at least one input object"];
+    _inputObjects = [objects copy];
+    _computeBlock = [computeBlock copy];
+
+    _inputSlots = malloc(sizeof(PANDerivedInputSlot) * objects.count);
+    for (NSUInteger i = 0; i < objects.count; i++)
+        _inputSlots[i] = (PANDerivedInputSlot){ (uintptr_t)(__bridge void *)objects[i], i };
+    qsort(_inputSlots, objects.count, sizeof(PANDerivedInputSlot), PANCompareDerivedInputSlots);
+    for (NSUInteger i = 1; i < objects.count; i++) {
+        if (_inputSlots[i].address == _inputSlots[i - 1].address)
+            [NSException raise:NSInvalidArgumentException format:@"Derived observation input object %@ given more than once", objects[_inputSlots[i].index]];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_inputSlots);
+    pthread_mutex_destroy(&_computeLock);
+}
+
++ (BOOL)requiresRemovalBeforeObserveeDeallocates
+{
+    return NO; // the observee is the observer, the KVO registrations are of the input objects which are retained
+}
+
+- (void)registerInternal
+{
+    NSAssert1(!self.registered, @"Attempted double-register of %@", self);
+    NSAssert1(self.keyPaths.count > 0, @"Empty 'keyPaths' property when registering observation for %@", self);
+
+    // changes made while registering join the first compute, whose result doesn't call the block
+    pthread_mutex_lock(&_computeLock);
+    [_changedInputs addIndexesInRange:NSMakeRange(0, self.inputObjects.count)];
+    _computing = YES;
+    pthread_mutex_unlock(&_computeLock);
+
+    NSMutableArray *dispatchers = [NSMutableArray arrayWithCapacity:self.inputObjects.count];
+    for (id object in self.inputObjects) {
+        PANKeyValueDispatcher *dispatcher = [PANKeyValueDispatcher dispatcherForObject:object];
+        [dispatcher addObservation:self];
+        [dispatchers addObject:dispatcher];
+    }
+    _dispatchers = dispatchers;
+
+    [self computeNotifying:NO];
+}
+
+- (void)deregisterInternal
+{
+    NSAssert1(self.registered, @"Attempted double-removal of %@", self);
+    for (PANKeyValueDispatcher *dispatcher in _dispatchers)
+        [dispatcher removeObservation:self];
+    _dispatchers = nil;
+}
+
++ (void)deregisterObservations:(NSArray *)observations
+{
+    // not grouped by observee as the superclass does, the registrations are of the input objects
+    for (PANDerivedObservation *observation in observations)
+        [observation deregisterInternal];
+}
+
+- (NSUInteger)indexOfInputObject:(id)object
+{
+    PANDerivedInputSlot key = { (uintptr_t)(__bridge void *)object, 0 };
+    PANDerivedInputSlot *slot = bsearch(&key, _inputSlots, self.inputObjects.count, sizeof(PANDerivedInputSlot), PANCompareDerivedInputSlots);
+    return slot != NULL ? slot->index : NSNotFound;
+}
+
+- (void)observeChange:(NSDictionary *)change ofKeyPath:(NSString *)observedKeyPath object:(id)object
+{
+    NSUInteger index = [self indexOfInputObject:object];
+    if (index == NSNotFound)
+        return;
+
+    pthread_mutex_lock(&_computeLock);
+    [_changedInputs addIndex:index];
+    BOOL schedule = !_computing;
+    _computing = YES;
+    pthread_mutex_unlock(&_computeLock);
+
+    if (schedule)
+        [self scheduleCompute];
+}
+
+- (void)observeTransactionChanges:(NSArray *)changes
+{
+    // all the inputs changed during the transaction are one batch
+    pthread_mutex_lock(&_computeLock);
+    for (PANKeyValueTransactionChange *transactionChange in changes) {
+        NSUInteger index = [self indexOfInputObject:transactionChange.object];
+        if (index != NSNotFound)
+            [_changedInputs addIndex:index];
+    }
+    BOOL schedule = !_computing && _changedInputs.count > 0;
+    if (schedule)
+        _computing = YES;
+    pthread_mutex_unlock(&_computeLock);
+
+    if (schedule)
+        [self scheduleCompute];
+}
+
+- (void)scheduleCompute
+{
+    if (self.queue != nil) {
+        [self.queue addOperationWithBlock:^{
+            [self computeNotifying:YES];
+        }];
+    }
+    else if (self.gcdQueue != nil) {
+        dispatch_async(self.gcdQueue, ^{
+            [self computeNotifying:YES];
+        });
+    }
+    else {
+        [self computeNotifying:YES];
+    }
+}
+
+// called with _computing set, computes until no inputs are left changed. the lock isn't held while the compute
+// block runs, so it can change inputs itself, which just makes for another pass
+- (void)computeNotifying:(BOOL)notify
+{
+    for (;;) {
+        pthread_mutex_lock(&_computeLock);
+        if (_changedInputs.count == 0) {
+            _computing = NO;
+            pthread_mutex_unlock(&_computeLock);
+            return;
+        }
+        NSIndexSet *changedInputs = [_changedInputs copy];
+        [_changedInputs removeAllIndexes];
+        id previousValue = _value;
+        pthread_mutex_unlock(&_computeLock);
+
+        id value = _computeBlock(previousValue, changedInputs);
+
+        pthread_mutex_lock(&_computeLock);
+        _value = value;
+        _computeCount++;
+        pthread_mutex_unlock(&_computeLock);
+
+        if (notify && self.registered && value != previousValue && ![value isEqual:previousValue]) {
+            NSDictionary *change = @{ NSKeyValueChangeKindKey: @(NSKeyValueChangeSetting),
+                                      NSKeyValueChangeNewKey: value != nil ? value : [NSNull null],
+                                      NSKeyValueChangeOldKey: previousValue != nil ? previousValue : [NSNull null] };
+            PANObservationEvent event = PANObservationEventMake(self.observee, change, PANDerivedValueKeyPath);
+            // already on the queue if there is one
+            [self triggerEvent:&event synchronously:YES];
+        }
+        notify = YES;
+    }
+}
+
+- (PAN_nullable id)value
+{
+    pthread_mutex_lock(&_computeLock);
+    id value = _value;
+    pthread_mutex_unlock(&_computeLock);
+    return value;
+}
+
+- (NSUInteger)computeCount
+{
+    pthread_mutex_lock(&_computeLock);
+    NSUInteger count = _computeCount;
+    pthread_mutex_unlock(&_computeLock);
+    return count;
+}
+
+- (void)configureSnapshot:(PANObservation *)snapshot
+{
+    PANDerivedObservation *derivedSnapshot = (PANDerivedObservation *)snapshot;
+    derivedSnapshot->_inputObjects = self.inputObjects;
+    derivedSnapshot->_value = self.value; // a snapshot is made as the value changes, so holds it as of then
+    derivedSnapshot->_computeCount = self.computeCount;
+    [super configureSnapshot:snapshot];
+}
+
+- (PAN_nullable id)indexSubkey
+{
+    return nil; // isn't found by key paths like other KVO observations
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p: obs=%p, inputs=%lu, kp=%@>", NSStringFromClass([self class]), self,
+            self.observer, (unsigned long)self.inputObjects.count, [self.keyPaths componentsJoinedByString:@","]];
+}
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
@@ -0,0 +1,21 @@
+//
+//  PANKeyValueCollectionObservation+Private.h
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-29.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANKeyValueCollectionObservation.h"
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+@interface PANKeyValueCollectionObservation (Private)
+
+- (instancetype)initWithObserver:(PAN_nullable id)observer object:(id)object keyPath:(NSString *)keyPath elementKeyPaths:(NSArray *)elementKeyPaths options:(int)options queue:(PAN_nullable NSOperationQueue *)queue gcdQueue:(PAN_nullable dispatch_queue_t)gcdQueue block:(PANObservationBlock)block;
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
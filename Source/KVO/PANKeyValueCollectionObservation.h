@@ -0,0 +1,79 @@
+//
+//  PANKeyValueCollectionObservation.h
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-29.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANKeyValueObservation.h"
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+/**
+ *  A protocol for the data generated from a change observed by a `PANKeyValueCollectionObservation`, which
+ *  conforms to this protocol and so has all these properties.
+ */
+@protocol PANKeyValueCollectionChange <PANKeyValueChange>
+
+/**
+ *  For a change of an element, its index in the collection, and `object` is the element and `keyPath` one of
+ *  `elementKeyPaths`. `NSNotFound` for a change of the collection itself, in which case `object` is the observed
+ *  object and `keyPath` the collection's key path. Value undefined except within call to an observation block.
+ *
+ *  An element in an array more than once is observed once, so the change is reported once with the first of its
+ *  indexes, see `elementIndexes`.
+ *
+ *  For an unordered collection such as an `NSSet` the index has no meaning, other than not being `NSNotFound` for
+ *  the change of an element. Use `object` to tell which element changed.
+ */
+@property (nonatomic, readonly) NSUInteger elementIndex;
+
+/**
+ *  For a change of an element, all of its indexes in the collection, more than one when it's in an array more than
+ *  once. `nil` for a change of the collection itself. Like `elementIndex`, has no meaning for an unordered
+ *  collection. Value undefined except within call to an observation block.
+ */
+@property (nonatomic, readonly, copy, PAN_nullable) NSIndexSet *elementIndexes;
+
+@end
+
+
+/**
+ *  An object conforming to the `PANKeyValueCollectionChange` protocol. `PANKeyValueCollectionObservation`
+ *  property `collated` is an array of these.
+ */
+@interface PANKeyValueCollectionChange : PANKeyValueChange <PANKeyValueCollectionChange>
+@end
+
+
+/**
+ *  An observation of a to-many key path and of key paths of each element in it, such as `items` and each item's
+ *  `price`, without an observation per element that has to be remade whenever the collection changes.
+ *
+ *  The observation keeps its own copy of the collection's elements and the registrations of their key paths up to
+ *  date with each insertion, removal and replacement, using the change's indexes. So a change to the collection
+ *  costs registrations for only the elements inserted or removed, rather than for all of them. Changes to the
+ *  collection are reported as well as changes to elements, see `elementIndex`.
+ *
+ *  `options` apply to both, other than `NSKeyValueObservingOptionInitial` which only applies to the collection's
+ *  key path. `changeFilter` only applies to the collection's key path. Elements in the collection are retained by
+ *  the observation until removed from the collection, or the observation is removed.
+ */
+@interface PANKeyValueCollectionObservation : PANKeyValueObservation <PANKeyValueCollectionChange>
+
+/**
+ *  The key paths observed on each element of the collection.
+ */
+@property (nonatomic, readonly) NSArray *elementKeyPaths;
+
+/**
+ *  The elements of the collection as currently known to the observation.
+ */
+@property (nonatomic, readonly) NSArray *elements;
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
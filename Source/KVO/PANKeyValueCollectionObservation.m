@@ -0,0 +1,427 @@
+//
+//  PANKeyValueCollectionObservation.m
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-29.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANKeyValueCollectionObservation.h"
+#import "PANKeyValueCollectionObservation+Private.h"
+#import "PANKeyValueObservation+Private.h"
+#import "PANObservation+Private.h"
+#import "PANKeyValueDispatcher.h"
+#import "PANKeyValueTransaction.h"
+#import <pthread.h>
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+@protocol PANMutableKeyValueCollectionChange <PANKeyValueCollectionChange, PANMutableDetectedObservation>
+@property (nonatomic, readwrite) NSUInteger elementIndex;
+@property (nonatomic, readwrite, copy, PAN_nullable) NSIndexSet *elementIndexes;
+@end
+
+@interface PANKeyValueCollectionObservation () <PANMutableKeyValueCollectionChange>
+@end
+
+@interface PANKeyValueCollectionChange () <PANMutableKeyValueCollectionChange>
+@end
+
+
+// the elements of a to-many value, ordered or not
+static NSArray *PANElementsOfCollection(id collection)
+{
+    if ([collection isKindOfClass:[NSArray class]])
+        return collection;
+    if ([collection isKindOfClass:[NSOrderedSet class]])
+        return [(NSOrderedSet *)collection array];
+    if ([collection isKindOfClass:[NSSet class]])
+        return [(NSSet *)collection allObjects];
+    return @[]; // nil or NSNull
+}
+
+
+#pragma mark -
+
+@implementation PANKeyValueCollectionObservation
+{
+    __unsafe_unretained id _collectionOwner; // the observee while registered, can't be read weakly once its dealloc has begun
+    pthread_mutex_t _elementsLock; // guards the following
+    NSMutableArray *_elements; // the collection as of the last change, retaining its elements
+    CFMutableBagRef _registeredElements; // element pointers, counted since an element can be in an array more than once
+    CFMutableDictionaryRef _elementIndexes; // element pointer -> NSMutableIndexSet of its indexes in _elements
+    BOOL _elementIndexesValid; // cleared when all the elements are replaced, rebuilt when next looked up
+}
+
+@synthesize elementIndex;
+@synthesize elementIndexes;
+
+- (instancetype)initWithObserver:(PAN_nullable id)observer object:(PAN_nullable id)observee queue:(PAN_nullable NSOperationQueue *)queue gcdQueue:(PAN_nullable dispatch_queue_t)gcdQueue block:(PAN_nullable PANObservationBlock)block
+{
+    if (!(self = [super initWithObserver:observer object:observee queue:queue gcdQueue:gcdQueue block:block]))
+        return nil;
+    pthread_mutex_init(&_elementsLock, NULL);
+    return self;
+}
+
+- (instancetype)initWithObject:(PAN_nullable id)observee queue:(PAN_nullable NSOperationQueue *)queue gcdQueue:(PAN_nullable dispatch_queue_t)gcdQueue block:(PAN_nullable PANAnonymousObservationBlock)block
+{
+    if (!(self = [super initWithObject:observee queue:queue gcdQueue:gcdQueue block:block]))
+        return nil;
+    pthread_mutex_init(&_elementsLock, NULL);
+    return self;
+}
+
+- (instancetype)initWithObserver:(PAN_nullable id)observer object:(id)object keyPath:(NSString *)keyPath elementKeyPaths:(NSArray *)elementKeyPaths options:(int)options queue:(PAN_nullable NSOperationQueue *)queue gcdQueue:(PAN_nullable dispatch_queue_t)gcdQueue block:(PANObservationBlock)block
+{
+    if (!(self = [self initWithObserver:observer object:object keyPaths:@[keyPath] options:options queue:queue gcdQueue:gcdQueue block:block]))
+        return nil;
+    _elementKeyPaths = [elementKeyPaths copy];
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_registeredElements != NULL)
+        CFRelease(_registeredElements);
+    if (_elementIndexes != NULL)
+        CFRelease(_elementIndexes);
+    pthread_mutex_destroy(&_elementsLock);
+}
+
+- (NSKeyValueObservingOptions)registrationOptions
+{
+    // the elements inserted & removed are needed to keep up with an unordered collection, as well as an ordered one
+    return [super registrationOptions] | NSKeyValueObservingOptionNew | NSKeyValueObservingOptionOld;
+}
+
+- (void)registerInternal
+{
+    NSAssert1(self.elementKeyPaths.count > 0, @"Empty 'elementKeyPaths' property when registering observation for %@", self);
+    _collectionOwner = self.observee;
+
+    // elements first, so the initial notification if any finds them already registered
+    pthread_mutex_lock(&_elementsLock);
+    _registeredElements = CFBagCreateMutable(NULL, 0, NULL);
+    _elementIndexes = CFDictionaryCreateMutable(NULL, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+    _elementIndexesValid = NO;
+    _elements = [PANElementsOfCollection([_collectionOwner valueForKeyPath:self.keyPaths.firstObject]) mutableCopy];
+    [self registerElements:_elements];
+    pthread_mutex_unlock(&_elementsLock);
+
+    [super registerInternal];
+}
+
+- (void)deregisterInternal
+{
+    [super deregisterInternal];
+
+    pthread_mutex_lock(&_elementsLock);
+    [self deregisterElements:_elements];
+    _elements = nil;
+    CFDictionaryRemoveAllValues(_elementIndexes);
+    _elementIndexesValid = NO;
+    pthread_mutex_unlock(&_elementsLock);
+    _collectionOwner = nil;
+}
+
+// called with _elementsLock held
+- (void)registerElements:(NSArray *)elements
+{
+    NSKeyValueObservingOptions options = self.options & (NSKeyValueObservingOptionNew | NSKeyValueObservingOptionOld | NSKeyValueObservingOptionPrior);
+    for (id element in elements) {
+        if (CFBagGetCountOfValue(_registeredElements, (__bridge const void *)element) == 0)
+            [[PANKeyValueDispatcher dispatcherForObject:element] addObservation:self forKeyPaths:self.elementKeyPaths options:options];
+        CFBagAddValue(_registeredElements, (__bridge const void *)element);
+    }
+}
+
+// called with _elementsLock held, while the elements are still retained
+- (void)deregisterElements:(NSArray *)elements
+{
+    for (id element in elements) {
+        CFBagRemoveValue(_registeredElements, (__bridge const void *)element);
+        if (CFBagGetCountOfValue(_registeredElements, (__bridge const void *)element) == 0)
+            [[PANKeyValueDispatcher dispatcherForObject:element] removeObservation:self forKeyPaths:self.elementKeyPaths];
+    }
+}
+
+// called with _elementsLock held
+- (void)addIndex:(NSUInteger)index ofElement:(id)element
+{
+    NSMutableIndexSet *indexes = (__bridge NSMutableIndexSet *)CFDictionaryGetValue(_elementIndexes, (__bridge const void *)element);
+    if (indexes == nil) {
+        indexes = [NSMutableIndexSet indexSet];
+        CFDictionarySetValue(_elementIndexes, (__bridge const void *)element, (__bridge const void *)indexes);
+    }
+    [indexes addIndex:index];
+}
+
+// called with _elementsLock held
+- (void)removeIndex:(NSUInteger)index ofElement:(id)element
+{
+    NSMutableIndexSet *indexes = (__bridge NSMutableIndexSet *)CFDictionaryGetValue(_elementIndexes, (__bridge const void *)element);
+    [indexes removeIndex:index];
+    if (indexes != nil && indexes.count == 0)
+        CFDictionaryRemoveValue(_elementIndexes, (__bridge const void *)element);
+}
+
+// called with _elementsLock held and the map valid, passes the index set of each element from `start` on once
+- (void)shiftIndexesOfElementsFromIndex:(NSUInteger)start usingBlock:(void (^)(NSMutableIndexSet *indexes))shift
+{
+    CFMutableSetRef shifted = CFSetCreateMutable(NULL, 0, NULL);
+    for (NSUInteger index = start; index < _elements.count; index++) {
+        const void *element = (__bridge const void *)_elements[index];
+        if (CFSetContainsValue(shifted, element))
+            continue;
+        CFSetAddValue(shifted, element);
+        shift((__bridge NSMutableIndexSet *)CFDictionaryGetValue(_elementIndexes, element));
+    }
+    CFRelease(shifted);
+}
+
+// called with _elementsLock held, rebuilding the map after all the elements were replaced
+- (PAN_nullable NSIndexSet *)indexesOfElement:(id)element
+{
+    if (!_elementIndexesValid) {
+        CFDictionaryRemoveAllValues(_elementIndexes);
+        NSUInteger index = 0;
+        for (id each in _elements)
+            [self addIndex:index++ ofElement:each];
+        _elementIndexesValid = YES;
+    }
+    return (__bridge NSIndexSet *)CFDictionaryGetValue(_elementIndexes, (__bridge const void *)element);
+}
+
+- (BOOL)isCollectionChangeOfKeyPath:(NSString *)observedKeyPath object:(id)object
+{
+    return object == _collectionOwner && [observedKeyPath isEqualToString:self.keyPaths.firstObject];
+}
+
+- (void)observeChange:(NSDictionary *)change ofKeyPath:(NSString *)observedKeyPath object:(id)object
+{
+    if ([self isCollectionChangeOfKeyPath:observedKeyPath object:object]) {
+        [self updateElementsWithChange:change];
+        [super observeChange:change ofKeyPath:observedKeyPath object:object];
+        return;
+    }
+    // an element's, not filtered since changeFilter's last values are kept per key path and not per element
+    PANObservationEvent event = PANObservationEventMake(object, change, observedKeyPath);
+    [self triggerEvent:&event synchronously:NO];
+}
+
+- (void)observeTransactionChanges:(NSArray *)changes
+{
+    // the collection's changes are in the order they were made, elements inserted during the transaction were
+    // only registered once it ended so their changes meanwhile aren't among these
+    for (PANKeyValueTransactionChange *transactionChange in changes) {
+        if ([self isCollectionChangeOfKeyPath:transactionChange.keyPath object:transactionChange.object])
+            [self updateElementsWithChange:transactionChange.change];
+    }
+    [super observeTransactionChanges:changes];
+}
+
+- (void)updateElementsWithChange:(NSDictionary *)change
+{
+    if ([(NSNumber *)change[NSKeyValueChangeNotificationIsPriorKey] boolValue])
+        return;
+    NSUInteger kind = [(NSNumber *)change[NSKeyValueChangeKindKey] unsignedIntegerValue];
+    NSIndexSet *indexes = change[NSKeyValueChangeIndexesKey];
+    NSArray *inserted = PANElementsOfCollection(change[NSKeyValueChangeNewKey]);
+    NSArray *removed = PANElementsOfCollection(change[NSKeyValueChangeOldKey]);
+
+    pthread_mutex_lock(&_elementsLock);
+
+    if (_elements == nil) {
+        pthread_mutex_unlock(&_elementsLock);
+        return; // deregistered meanwhile
+    }
+
+    BOOL ordered = indexes != nil && indexes.lastIndex != NSNotFound;
+    if (kind == NSKeyValueChangeSetting) {
+        // the initial notification only has the new value if the options asked for it
+        id collection = change[NSKeyValueChangeNewKey];
+        [self replaceAllElementsWith:PANElementsOfCollection(collection != nil ? collection : [_collectionOwner valueForKeyPath:self.keyPaths.firstObject])];
+    }
+    else if (ordered && kind == NSKeyValueChangeInsertion && inserted.count == indexes.count && indexes.firstIndex <= _elements.count) {
+        if (_elementIndexesValid) {
+            // only the elements after the first insertion move, each by the number inserted before it
+            [self shiftIndexesOfElementsFromIndex:indexes.firstIndex usingBlock:^(NSMutableIndexSet *elementsIndexes) {
+                [indexes enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
+                    [elementsIndexes shiftIndexesStartingAtIndex:index by:1];
+                }];
+            }];
+        }
+        [_elements insertObjects:inserted atIndexes:indexes];
+        if (_elementIndexesValid) {
+            __block NSUInteger i = 0;
+            [indexes enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
+                [self addIndex:index ofElement:inserted[i++]];
+            }];
+        }
+        [self registerElements:inserted];
+    }
+    else if (ordered && kind != NSKeyValueChangeInsertion && indexes.lastIndex < _elements.count) {
+        removed = [_elements objectsAtIndexes:indexes];
+        [self deregisterElements:removed];
+        if (kind == NSKeyValueChangeRemoval) {
+            if (_elementIndexesValid) {
+                __block NSUInteger i = 0;
+                [indexes enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
+                    [self removeIndex:index ofElement:removed[i++]];
+                }];
+            }
+            [_elements removeObjectsAtIndexes:indexes];
+            if (_elementIndexesValid) {
+                // only the elements after the first removal move, each back by the number removed before it
+                [self shiftIndexesOfElementsFromIndex:indexes.firstIndex usingBlock:^(NSMutableIndexSet *elementsIndexes) {
+                    [indexes enumerateIndexesWithOptions:NSEnumerationReverse usingBlock:^(NSUInteger index, BOOL *stop) {
+                        [elementsIndexes shiftIndexesStartingAtIndex:index + 1 by:-1];
+                    }];
+                }];
+            }
+        }
+        else if (inserted.count == indexes.count) {
+            [_elements replaceObjectsAtIndexes:indexes withObjects:inserted];
+            [self registerElements:inserted];
+            if (_elementIndexesValid) {
+                // nothing shifts, so only the replaced indexes move between elements
+                __block NSUInteger i = 0;
+                [indexes enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
+                    [self removeIndex:index ofElement:removed[i]];
+                    [self addIndex:index ofElement:inserted[i]];
+                    i++;
+                }];
+            }
+        }
+        else {
+            [_elements removeObjectsAtIndexes:indexes];
+            _elementIndexesValid = NO;
+            [self replaceAllElementsWith:PANElementsOfCollection([_collectionOwner valueForKeyPath:self.keyPaths.firstObject])];
+        }
+    }
+    else if (!ordered && kind != NSKeyValueChangeSetting) {
+        // a set mutation, the removed and inserted elements are given as sets, each removed element is found through
+        // the map and replaced by the last one since the order of an unordered collection's elements doesn't matter
+        for (id element in removed) {
+            NSIndexSet *indexes = [self indexesOfElement:element];
+            if (indexes == nil)
+                continue;
+            NSUInteger index = indexes.firstIndex;
+            NSUInteger lastIndex = _elements.count - 1;
+            [self deregisterElements:@[element]];
+            [self removeIndex:index ofElement:element];
+            if (index != lastIndex) {
+                id moved = _elements[lastIndex];
+                [self removeIndex:lastIndex ofElement:moved];
+                [self addIndex:index ofElement:moved];
+                _elements[index] = moved;
+            }
+            [_elements removeLastObject];
+        }
+        for (id element in inserted) {
+            if (_elementIndexesValid)
+                [self addIndex:_elements.count ofElement:element];
+            [_elements addObject:element];
+        }
+        [self registerElements:inserted];
+    }
+    else {
+        // indexes that don't fit what's known, start over from the collection as it is now
+        [self replaceAllElementsWith:PANElementsOfCollection([_collectionOwner valueForKeyPath:self.keyPaths.firstObject])];
+    }
+
+    pthread_mutex_unlock(&_elementsLock);
+}
+
+// called with _elementsLock held
+- (void)replaceAllElementsWith:(NSArray *)elements
+{
+    // such as the initial notification, or setting the same collection again
+    if (elements.count == _elements.count) {
+        NSUInteger index = 0;
+        while (index < elements.count && elements[index] == _elements[index])
+            index++;
+        if (index == elements.count)
+            return;
+    }
+    NSArray *registered = _elements;
+    _elements = [elements mutableCopy];
+    _elementIndexesValid = NO;
+    [self registerElements:_elements];
+    [self deregisterElements:registered]; // after, so elements in both keep their registrations
+}
+
+- (NSArray *)elements
+{
+    pthread_mutex_lock(&_elementsLock);
+    NSArray *elements = [_elements copy];
+    pthread_mutex_unlock(&_elementsLock);
+    return elements != nil ? elements : @[];
+}
+
+- (void)applyEvent:(const PANObservationEvent *)event toDetectedObservation:(id<PANMutableDetectedObservation>)detectedObservation
+{
+    [super applyEvent:event toDetectedObservation:detectedObservation];
+    if (![detectedObservation conformsToProtocol:@protocol(PANMutableKeyValueCollectionChange)])
+        return;
+    NSIndexSet *indexes = nil;
+    if (event->object != nil && event->object != _collectionOwner) {
+        pthread_mutex_lock(&_elementsLock);
+        indexes = [[self indexesOfElement:event->object] copy];
+        pthread_mutex_unlock(&_elementsLock);
+    }
+    id<PANMutableKeyValueCollectionChange> change = (id<PANMutableKeyValueCollectionChange>)detectedObservation;
+    change.elementIndex = indexes != nil ? indexes.firstIndex : NSNotFound;
+    change.elementIndexes = indexes;
+}
+
+- (void)duplicateFrom:(id<PANDetectedObservation>)source
+{
+    [super duplicateFrom:source];
+    if ([source conformsToProtocol:@protocol(PANKeyValueCollectionChange)]) {
+        self.elementIndex = ((id<PANKeyValueCollectionChange>)source).elementIndex;
+        self.elementIndexes = ((id<PANKeyValueCollectionChange>)source).elementIndexes;
+    }
+}
+
+- (void)configureSnapshot:(PANObservation *)snapshot
+{
+    ((PANKeyValueCollectionObservation *)snapshot)->_elementKeyPaths = self.elementKeyPaths;
+    [super configureSnapshot:snapshot];
+}
+
+- (PANDetectedObservation *)createDetectedObservation
+{
+    return [[PANKeyValueCollectionChange alloc] init];
+}
+
+- (PAN_nullable id<NSCopying>)collationKeyForDetectedObservation:(PANDetectedObservation *)detectedObservation
+{
+    PANKeyValueCollectionChange *change = (PANKeyValueCollectionChange *)detectedObservation;
+    if (change.elementIndex == NSNotFound)
+        return [super collationKeyForDetectedObservation:detectedObservation];
+    return @[change.keyPath, @(change.elementIndex)];
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p: obs=%p, obj=%@ %p, kp=%@, elements kp=%@>", NSStringFromClass([self class]), self,
+            self.observer, NSStringFromClass([self.object class]), self.object, self.keyPaths.firstObject, [self.elementKeyPaths componentsJoinedByString:@","]];
+}
+
+@end
+
+
+#pragma mark -
+
+@implementation PANKeyValueCollectionChange
+
+@synthesize elementIndex;
+@synthesize elementIndexes;
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
@@ -0,0 +1,106 @@
+//
+//  PANKeyValueDispatcher.h
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-26.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+//  Shares Foundation KVO registrations among the PANKeyValueObservations of one object. Attached to the observed
+//  object as an associated object, it adds itself as the only Foundation observer of each key path, with the
+//  union of the options any of those observations want, and fans each change out to them from its own list.
+//  Instead of Foundation keeping an observance per observation and calling each of them, there's one per key path.
+//
+//  Changes are passed to `-[PANKeyValueObservation observeChange:ofKeyPath:object:]`, which applies its filter.
+//
+//  Because the registration is shared, a change dictionary may have entries for options that only other
+//  observations of the key path asked for. Prior notifications are only passed on to observations that asked for
+//  them. `NSKeyValueObservingOptionInitial` is never registered with Foundation, since it'd be sent again to
+//  everyone, the dispatcher makes the initial notification for the observation that asked for it instead.
+//
+//  While the thread making a change is performing a `PANKeyValueTransaction`, the change is recorded into it
+//  instead of passed to the observations, which get it once the transaction ends.
+//
+//  The options registered only ever grow while a key path has observations, re-registering when they do. The wider
+//  registration is added before the narrower one is removed, so a change made meanwhile isn't missed. The
+//  Foundation registration of a key path is removed along with the last observation of it. Foundation is never
+//  called with the lock that the change callback takes held.
+
+#import <Foundation/Foundation.h>
+#import "PANDefines.h"
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+@class PANKeyValueObservation;
+
+@interface PANKeyValueDispatcher : NSObject
+
+/**
+ *  Return the dispatcher attached to an object, attaching a new one if it doesn't have one yet.
+ *
+ *  @param object The object to be observed.
+ *
+ *  @return The object's dispatcher.
+ */
++ (instancetype)dispatcherForObject:(id)object;
+
+/**
+ *  Start passing changes of the observation's key paths to it, registering with Foundation KVO if needed. Sends
+ *  the initial notification if the observation's options include `NSKeyValueObservingOptionInitial`.
+ *
+ *  @param observation A key value observation of the dispatcher's object.
+ */
+- (void)addObservation:(PANKeyValueObservation *)observation;
+
+/**
+ *  Start passing changes of the given key paths to an observation that isn't observing them through its own
+ *  `keyPaths`, such as the elements of a collection observation. No initial notification is sent.
+ *
+ *  @param observation A key value observation.
+ *  @param keyPaths    Key paths of the dispatcher's object.
+ *  @param options     The options to register, `NSKeyValueObservingOptionInitial` is ignored.
+ */
+- (void)addObservation:(PANKeyValueObservation *)observation forKeyPaths:(NSArray *)keyPaths options:(NSKeyValueObservingOptions)options;
+
+/**
+ *  Register again if the options the observation needs have grown since it was added.
+ *
+ *  @param observation An observation previously added.
+ */
+- (void)updateRegistrationOfObservation:(PANKeyValueObservation *)observation;
+
+/**
+ *  The observed object. Not retained, since it owns the dispatcher.
+ */
+@property (nonatomic, readonly, unsafe_unretained) id object;
+
+/**
+ *  The observations of a key path of the object, `nil` if there are none.
+ *
+ *  @param keyPath A key path of the object.
+ *
+ *  @return An immutable array of observations.
+ */
+- (PAN_nullable PAN_ARRAY(PANKeyValueObservation) *)observationsOfKeyPath:(NSString *)keyPath;
+
+/**
+ *  Stop passing changes to the observation, deregistering from Foundation KVO any key path left without
+ *  observations. Doesn't read the observation's weak `observee`, so is safe while the object is deallocating.
+ *
+ *  @param observation An observation previously added.
+ */
+- (void)removeObservation:(PANKeyValueObservation *)observation;
+
+/**
+ *  Stop passing changes of the given key paths to the observation, the counterpart of
+ *  `addObservation:forKeyPaths:options:`.
+ *
+ *  @param observation An observation previously added for these key paths.
+ *  @param keyPaths    The key paths it was added for.
+ */
+- (void)removeObservation:(PANKeyValueObservation *)observation forKeyPaths:(NSArray *)keyPaths;
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
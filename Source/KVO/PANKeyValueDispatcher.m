@@ -0,0 +1,269 @@
+//
+//  PANKeyValueDispatcher.m
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-26.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANKeyValueDispatcher.h"
+#import "PANKeyValueObservation.h"
+#import "PANKeyValueObservation+Private.h"
+#import "PANObservation+Private.h"
+#import "PANKeyValueTransaction.h"
+#import <objc/runtime.h>
+#import <pthread.h>
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+static const int PANKeyValueDispatcherKeyVar;
+static void *PANKeyValueDispatcherKey = (void *)&PANKeyValueDispatcherKeyVar;
+
+// a key path's registration alternates between the two when its options grow, the wider one is added before the
+// narrower one is removed
+static const int PANKeyValueDispatcherContextVar;
+static void *PANKeyValueDispatcherContext = (void *)&PANKeyValueDispatcherContextVar;
+static const int PANKeyValueDispatcherAlternateContextVar;
+static void *PANKeyValueDispatcherAlternateContext = (void *)&PANKeyValueDispatcherAlternateContextVar;
+
+static pthread_mutex_t dispatcherCreationLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+// the observers of one key path
+@interface PANKeyValueDispatchEntry : NSObject
+{
+    @public
+    NSKeyValueObservingOptions _options; // as registered with Foundation
+    void *_context; // of the current Foundation registration, changes sent with the other are passed on by it
+    NSArray *_observations; // immutable, replaced on every change so the fan out can use it without the lock
+}
+@end
+
+@implementation PANKeyValueDispatchEntry
+@end
+
+
+#pragma mark -
+
+// Foundation is only called with _registrationLock held and _lock not, since the KVO callback takes _lock and
+// Foundation may hold its own locks while calling it. _registrationLock keeps registrations in the same order as
+// the changes to _entries that call for them, and is never taken by the callback
+@implementation PANKeyValueDispatcher
+{
+    pthread_mutex_t _registrationLock;
+    pthread_mutex_t _lock;
+    NSMutableDictionary *_entries; // key path -> PANKeyValueDispatchEntry, changed with both locks held
+}
+
+@synthesize object = _object; // owns the dispatcher, can't be read weakly once its dealloc has begun
+
++ (instancetype)dispatcherForObject:(id)object
+{
+    PANKeyValueDispatcher *dispatcher = objc_getAssociatedObject(object, PANKeyValueDispatcherKey);
+    if (dispatcher != nil)
+        return dispatcher;
+
+    pthread_mutex_lock(&dispatcherCreationLock);
+
+    dispatcher = objc_getAssociatedObject(object, PANKeyValueDispatcherKey);
+    if (dispatcher == nil) {
+        dispatcher = [[self alloc] initWithObject:object];
+        objc_setAssociatedObject(object, PANKeyValueDispatcherKey, dispatcher, OBJC_ASSOCIATION_RETAIN);
+    }
+
+    pthread_mutex_unlock(&dispatcherCreationLock);
+    return dispatcher;
+}
+
+- (instancetype)initWithObject:(id)object
+{
+    if (!(self = [super init]))
+        return nil;
+    _object = object;
+    pthread_mutex_init(&_registrationLock, NULL);
+    pthread_mutex_init(&_lock, NULL);
+    _entries = [NSMutableDictionary dictionary];
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_lock);
+    pthread_mutex_destroy(&_registrationLock);
+}
+
+- (void)addObservation:(PANKeyValueObservation *)observation
+{
+    [self addObservation:observation forKeyPaths:observation.keyPaths options:observation.registrationOptions];
+
+    if ((observation.options & NSKeyValueObservingOptionInitial) != 0) {
+        for (NSString *keyPath in observation.keyPaths)
+            [self sendInitialNotificationOfKeyPath:keyPath toObservation:observation];
+    }
+}
+
+- (void)addObservation:(PANKeyValueObservation *)observation forKeyPaths:(NSArray *)keyPaths options:(NSKeyValueObservingOptions)options
+{
+    options &= ~NSKeyValueObservingOptionInitial;
+    NSMutableArray *registeredKeyPaths = [NSMutableArray array];
+    NSMutableArray *widenedKeyPaths = [NSMutableArray array];
+
+    pthread_mutex_lock(&_registrationLock);
+    pthread_mutex_lock(&_lock);
+
+    for (NSString *keyPath in keyPaths) {
+        PANKeyValueDispatchEntry *entry = _entries[keyPath];
+        if (entry == nil) {
+            entry = [[PANKeyValueDispatchEntry alloc] init];
+            entry->_options = options;
+            entry->_context = PANKeyValueDispatcherContext;
+            entry->_observations = @[observation];
+            _entries[keyPath] = entry;
+            [registeredKeyPaths addObject:keyPath];
+        }
+        else {
+            entry->_observations = [entry->_observations arrayByAddingObject:observation];
+            if ((entry->_options | options) != entry->_options)
+                [widenedKeyPaths addObject:keyPath];
+        }
+    }
+
+    pthread_mutex_unlock(&_lock);
+
+    for (NSString *keyPath in registeredKeyPaths)
+        [_object addObserver:self forKeyPath:keyPath options:options context:PANKeyValueDispatcherContext];
+    for (NSString *keyPath in widenedKeyPaths)
+        [self widenRegistrationOfKeyPath:keyPath withOptions:options];
+
+    pthread_mutex_unlock(&_registrationLock);
+}
+
+- (void)updateRegistrationOfObservation:(PANKeyValueObservation *)observation
+{
+    NSKeyValueObservingOptions options = observation.registrationOptions & ~NSKeyValueObservingOptionInitial;
+
+    pthread_mutex_lock(&_registrationLock);
+    for (NSString *keyPath in observation.keyPaths)
+        [self widenRegistrationOfKeyPath:keyPath withOptions:options];
+    pthread_mutex_unlock(&_registrationLock);
+}
+
+// called with _registrationLock held, registers again with the union of the options if they've grown. the wider
+// registration is added before the narrower one is removed so no change is missed, one made just as the entry
+// switches to it can be sent by both, then it's passed on twice rather than not at all
+- (void)widenRegistrationOfKeyPath:(NSString *)keyPath withOptions:(NSKeyValueObservingOptions)options
+{
+    pthread_mutex_lock(&_lock);
+    PANKeyValueDispatchEntry *entry = _entries[keyPath];
+    if (entry == nil || (entry->_options | options) == entry->_options) {
+        pthread_mutex_unlock(&_lock);
+        return;
+    }
+    NSKeyValueObservingOptions widenedOptions = entry->_options | options;
+    void *narrowerContext = entry->_context;
+    void *widerContext = narrowerContext == PANKeyValueDispatcherContext ? PANKeyValueDispatcherAlternateContext : PANKeyValueDispatcherContext;
+    pthread_mutex_unlock(&_lock);
+
+    [_object addObserver:self forKeyPath:keyPath options:widenedOptions context:widerContext];
+
+    pthread_mutex_lock(&_lock);
+    entry->_options = widenedOptions;
+    entry->_context = widerContext;
+    pthread_mutex_unlock(&_lock);
+
+    [_object removeObserver:self forKeyPath:keyPath context:narrowerContext];
+}
+
+- (void)removeObservation:(PANKeyValueObservation *)observation
+{
+    [self removeObservation:observation forKeyPaths:observation.keyPaths];
+}
+
+- (void)removeObservation:(PANKeyValueObservation *)observation forKeyPaths:(NSArray *)keyPaths
+{
+    NSMutableDictionary *removedEntries = [NSMutableDictionary dictionary]; // key path -> entry left without observations
+
+    pthread_mutex_lock(&_registrationLock);
+    pthread_mutex_lock(&_lock);
+
+    for (NSString *keyPath in keyPaths) {
+        PANKeyValueDispatchEntry *entry = _entries[keyPath];
+        NSUInteger index = entry != nil ? [entry->_observations indexOfObjectIdenticalTo:observation] : NSNotFound;
+        if (index == NSNotFound)
+            continue;
+        if (entry->_observations.count == 1) {
+            removedEntries[keyPath] = entry;
+            [_entries removeObjectForKey:keyPath];
+        }
+        else {
+            NSMutableArray *observations = [entry->_observations mutableCopy];
+            [observations removeObjectAtIndex:index];
+            entry->_observations = [observations copy];
+        }
+    }
+
+    pthread_mutex_unlock(&_lock);
+
+    [removedEntries enumerateKeysAndObjectsUsingBlock:^(NSString *keyPath, PANKeyValueDispatchEntry *entry, BOOL *stop) {
+        [self->_object removeObserver:self forKeyPath:keyPath context:entry->_context];
+    }];
+
+    pthread_mutex_unlock(&_registrationLock);
+}
+
+- (PAN_nullable NSArray *)observationsOfKeyPath:(NSString *)keyPath
+{
+    pthread_mutex_lock(&_lock);
+    PANKeyValueDispatchEntry *entry = _entries[keyPath];
+    NSArray *observations = entry != nil ? entry->_observations : nil;
+    pthread_mutex_unlock(&_lock);
+    return observations;
+}
+
+// what Foundation sends for NSKeyValueObservingOptionInitial
+- (void)sendInitialNotificationOfKeyPath:(NSString *)keyPath toObservation:(PANKeyValueObservation *)observation
+{
+    NSMutableDictionary *change = [NSMutableDictionary dictionaryWithObject:@(NSKeyValueChangeSetting) forKey:NSKeyValueChangeKindKey];
+    if ((observation.options & NSKeyValueObservingOptionNew) != 0) {
+        id value = [_object valueForKeyPath:keyPath];
+        change[NSKeyValueChangeNewKey] = value != nil ? value : [NSNull null];
+    }
+    [observation observeChange:change ofKeyPath:keyPath object:_object];
+}
+
+- (void)observeValueForKeyPath:(PAN_nullable NSString *)keyPath ofObject:(PAN_nullable id)object change:(PAN_nullable NSDictionary *)change context:(PAN_nullable void *)context
+{
+    if (context != PANKeyValueDispatcherContext && context != PANKeyValueDispatcherAlternateContext) {
+        [super observeValueForKeyPath:keyPath ofObject:object change:change context:context];
+        return;
+    }
+
+    // while a registration is being replaced by a wider one, only the current of the two passes changes on
+    NSArray *observations = nil;
+    pthread_mutex_lock(&_lock);
+    PANKeyValueDispatchEntry *entry = keyPath != nil ? _entries[keyPath] : nil;
+    if (entry != nil && entry->_context == context)
+        observations = entry->_observations;
+    pthread_mutex_unlock(&_lock);
+    if (observations == nil)
+        return;
+
+    PANKeyValueTransaction *transaction = [PANKeyValueTransaction currentTransaction];
+    if (transaction != nil && keyPath != nil && change != nil) {
+        [transaction recordChange:change ofKeyPath:keyPath dispatcher:self];
+        return;
+    }
+
+    BOOL prior = [(NSNumber *)change[NSKeyValueChangeNotificationIsPriorKey] boolValue];
+    for (PANKeyValueObservation *observation in observations) {
+        if (prior && (observation.options & NSKeyValueObservingOptionPrior) == 0)
+            continue;
+        [observation observeChange:change ofKeyPath:keyPath object:object];
+    }
+}
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
@@ -21,6 +21,24 @@ PAN_ASSUME_NONNULL_BEGIN
 
 + (PAN_nullable PANKeyValueObservation *)findObservationForObserver:(PAN_nullable id)observer object:(id)object keyPaths:(NSArray *)keyPaths;
 
+/**
+ *  Called by the observee's `PANKeyValueDispatcher` with each change of one of the observation's key paths.
+ *  Applies `changeFilter` and triggers the observation.
+ */
+- (void)observeChange:(NSDictionary *)change ofKeyPath:(NSString *)keyPath object:(id)object;
+
+/**
+ *  Called when a `PANKeyValueTransaction` ends with the net changes of the observation's key paths made during it,
+ *  an array of `PANKeyValueTransactionChange`. Applies `changeFilter` and triggers the observation once, with
+ *  `collated` holding the changes if there's more than one.
+ */
+- (void)observeTransactionChanges:(NSArray *)changes;
+
+/**
+ *  The options the dispatcher should register for this observation, `options` plus any needed by `changeFilter`.
+ */
+@property (nonatomic, readonly) NSKeyValueObservingOptions registrationOptions;
+
 @end
 
 
@@ -24,9 +24,11 @@ PAN_ASSUME_NONNULL_BEGIN
 
 /**
  *  Change dictionary for a KVO observation. Value undefined except within call to an observation block.
- *  A synonym for the `payload` property.
+ *  A synonym for the `payload` property. `nil` if the observation's `keepsChangeDictionary` is `NO`.
+ *
+ *  The following properties are read from this dictionary when accessed, rather than when the change occurs.
  */
-@property (nonatomic, readonly) NSDictionary *changeDict;
+@property (nonatomic, readonly, PAN_nullable) NSDictionary *changeDict;
 
 /**
  *  The kind of a KVO observation. Value undefined except within call to an observation block. A shortcut for
@@ -42,7 +44,7 @@ PAN_ASSUME_NONNULL_BEGIN
 
 /**
  *  The changed value of a KVO observation. Value undefined except within call to an observation block. A shortcut
- *  for `changeDict[NSKeyValueChangeNewKey]`.
+ *  for `changeDict[NSKeyValueChangeNewKey]`, the only one still available when `keepsChangeDictionary` is `NO`.
  */
 @property (nonatomic, readonly, PAN_nullable) id changedValue;
 
@@ -58,6 +60,44 @@ PAN_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic, readonly, PAN_nullable) NSIndexSet *indexes;
 
+/**
+ *  Indexes of the objects inserted into a to-many key path, in the collection as it is after the change. Empty if
+ *  the change didn't insert any, `nil` if it's not an insertion, removal or replacement.
+ *
+ *  When collection changes are coalesced (see `coalescesCollectionChanges`) this is the net insertions of all the
+ *  changes merged, and the other properties above are those of the last change merged.
+ */
+@property (nonatomic, readonly, PAN_nullable) NSIndexSet *insertedIndexes;
+
+/**
+ *  Indexes of the objects removed from a to-many key path, in the collection as it was before the change. Empty
+ *  if the change didn't remove any, `nil` if it's not an insertion, removal or replacement.
+ */
+@property (nonatomic, readonly, PAN_nullable) NSIndexSet *removedIndexes;
+
+/**
+ *  Indexes of the objects replaced in a to-many key path, in the collection as it was before the change, excluding
+ *  any also removed. Empty if the change didn't replace any, `nil` if it's not an insertion, removal or replacement.
+ */
+@property (nonatomic, readonly, PAN_nullable) NSIndexSet *replacedIndexes;
+
+/**
+ *  The objects inserted, in the order of `insertedIndexes`. Requires `NSKeyValueObservingOptionNew`, otherwise
+ *  `nil`. An object inserted in one change and removed by another is in neither `insertedValues` or `removedValues`,
+ *  one removed and inserted again, a move, is in both.
+ */
+@property (nonatomic, readonly, PAN_nullable) NSArray *insertedValues;
+
+/**
+ *  The objects removed, in the order of `removedIndexes`. Requires `NSKeyValueObservingOptionOld`, otherwise `nil`.
+ */
+@property (nonatomic, readonly, PAN_nullable) NSArray *removedValues;
+
+/**
+ *  The number of KVO changes merged into this one by `coalescesCollectionChanges`, 1 if it wasn't merged with any.
+ */
+@property (nonatomic, readonly) NSUInteger mergedChangeCount;
+
 @end
 
 
@@ -71,6 +111,25 @@ PAN_ASSUME_NONNULL_BEGIN
 
 #pragma mark -
 
+/**
+ *  Which changes a KVO observation drops instead of triggering, see `changeFilter`.
+ */
+typedef NS_ENUM(NSInteger, PANKeyValueChangeFilter) {
+    /**
+     *  Every change triggers the observation.
+     */
+    PANKeyValueChangeFilterNone = 0,
+    /**
+     *  Drop a change whose new value is the same object as the last one that triggered the observation.
+     */
+    PANKeyValueChangeFilterIdenticalValues,
+    /**
+     *  Drop a change whose new value is equal to the last one that triggered the observation, using `isEqual:`.
+     */
+    PANKeyValueChangeFilterEqualValues,
+};
+
+
 /**
  *  A base class for KVO observation objects.
  *
@@ -94,6 +153,41 @@ PAN_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic, readonly) NSKeyValueObservingOptions options;
 
+/**
+ *  Whether the change dictionary is kept for the block and in `collated`. Default is `YES`. Set to `NO` when only
+ *  `changedValue` is needed, which is then taken from the dictionary as the change occurs and the dictionary let
+ *  go, reducing the memory held by a paused observation. `changeDict`, `payload`, `oldValue` and `indexes` are
+ *  then `nil`, and `kind` and `prior` are 0.
+ */
+@property (nonatomic) BOOL keepsChangeDictionary;
+
+/**
+ *  Whether changes setting a key path to the value it had at the last trigger are dropped before triggering the
+ *  observation, so without allocating or hopping queues. Default is `PANKeyValueChangeFilterNone`.
+ *
+ *  Each key path is compared with its own last value, the first change of each always triggers. Only applies to
+ *  changes of kind `NSKeyValueChangeSetting`, prior notifications are never dropped. The new value is needed for
+ *  this, so `NSKeyValueObservingOptionNew` is added to what's registered if `options` doesn't include it.
+ */
+@property (nonatomic) PANKeyValueChangeFilter changeFilter;
+
+/**
+ *  Number of changes dropped by `changeFilter`.
+ */
+@property (nonatomic, readonly) NSUInteger suppressedChangeCount;
+
+/**
+ *  Whether consecutive insertions, removals and replacements of a to-many key path collected while paused,
+ *  suspended or batching are merged into one net change, instead of each being kept in `collated`. Default is `NO`.
+ *
+ *  Merged changes are read using `insertedIndexes`, `removedIndexes` and `replacedIndexes`, which are in the form
+ *  a table or collection view batch update expects, and `insertedValues` and `removedValues`. Merging stops at any
+ *  other change, such as one setting the whole collection, or a change of another key path. Requires
+ *  `keepsChangeDictionary`, since the kind of each change is read from its change dictionary, a message is logged
+ *  the first time an observation is registered with this set and that not.
+ */
+@property (nonatomic) BOOL coalescesCollectionChanges;
+
 /**
  *  Remove an observer with matching parameters. Can use this class method to look-up a previously registered
  *  observation and remove it, although usually more convenient to use the 'pan_stopObserving' methods, or save the
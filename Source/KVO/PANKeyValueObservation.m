@@ -9,47 +9,250 @@
 #import "PANKeyValueObservation.h"
 #import "PANKeyValueObservation+Private.h"
 #import "PANObservation+Private.h"
+#import "PANKeyValueDispatcher.h"
+#import "PANKeyValueTransaction.h"
+#import <malloc/malloc.h>
+#import <pthread.h>
 
 PAN_ASSUME_NONNULL_BEGIN
 
 
+@class PANKeyValueCollectionDiff;
+
+// the other values are decoded from the change dictionary, which is the payload, only when they're read
 @protocol PANMutableKeyValueChange <PANKeyValueChange, PANMutableDetectedObservation>
 @property (nonatomic, readwrite, copy) NSString *keyPath;
-@property (nonatomic, readwrite) NSDictionary *changeDict;
-@property (nonatomic, readwrite) NSUInteger kind;
-@property (nonatomic, readwrite, getter=isPrior) BOOL prior;
-@property (nonatomic, readwrite, PAN_nullable) id changedValue;
-@property (nonatomic, readwrite, PAN_nullable) id oldValue;
-@property (nonatomic, readwrite, PAN_nullable) NSIndexSet *indexes;
+@property (nonatomic, readwrite, PAN_nullable) id changedValue; // only set when the change dictionary is dropped
+@property (nonatomic, PAN_nullable) PANKeyValueCollectionDiff *collectionDiff; // only set once changes are merged
 @end
 
 @interface PANKeyValueObservation () <PANMutableKeyValueChange>
 @property (nonatomic, readwrite) NSArray *keyPaths;
 @property (nonatomic, readwrite) NSKeyValueObservingOptions options;
+@property (nonatomic, unsafe_unretained, PAN_nullable) id registeredObject; // observee can't be read weakly once its dealloc has begun
+@property (nonatomic, PAN_nullable) PANKeyValueDispatcher *registeredDispatcher; // the observee's, shares its KVO registrations
 @end
 
 @interface PANKeyValueChange () <PANMutableKeyValueChange>
 @end
 
-static const int PANKeyValueObservationContextVar;
-static void *PANKeyValueObservationContext = (void *)&PANKeyValueObservationContextVar;
+
+static inline NSUInteger PANChangeKind(NSDictionary *changeDict)
+{
+    return [(NSNumber *)changeDict[NSKeyValueChangeKindKey] unsignedIntegerValue];
+}
+
+static inline BOOL PANChangeIsPrior(NSDictionary *changeDict)
+{
+    return [(NSNumber *)changeDict[NSKeyValueChangeNotificationIsPriorKey] boolValue];
+}
+
+static inline id PANChangeNewValue(NSDictionary *changeDict, id droppedValue)
+{
+    return changeDict != nil ? changeDict[NSKeyValueChangeNewKey] : droppedValue;
+}
+
+static inline id PANChangeOldValue(NSDictionary *changeDict)
+{
+    return changeDict[NSKeyValueChangeOldKey];
+}
+
+static inline NSIndexSet *PANChangeIndexes(NSDictionary *changeDict)
+{
+    return changeDict[NSKeyValueChangeIndexesKey];
+}
+
+static inline BOOL PANChangeIsToMany(NSDictionary *changeDict)
+{
+    NSUInteger kind = PANChangeKind(changeDict);
+    return (kind == NSKeyValueChangeInsertion || kind == NSKeyValueChangeRemoval || kind == NSKeyValueChangeReplacement) && !PANChangeIsPrior(changeDict) && changeDict[NSKeyValueChangeIndexesKey] != nil;
+}
+
+// indexes of a single change, empty if it's a to-many change of another kind
+static inline NSIndexSet *PANChangeIndexesOfKind(NSDictionary *changeDict, NSKeyValueChange kind)
+{
+    NSIndexSet *indexes = changeDict[NSKeyValueChangeIndexesKey];
+    if (indexes == nil)
+        return nil;
+    return PANChangeKind(changeDict) == kind ? indexes : [NSIndexSet indexSet];
+}
+
+static inline NSUInteger PANCountOfIndexesBelow(NSIndexSet *indexes, NSUInteger index)
+{
+    return [indexes countOfIndexesInRange:NSMakeRange(0, index)];
+}
+
+
+// the net effect of consecutive to-many changes. tracks which items of the current collection were inserted, and
+// which items of the original collection were removed or replaced, mapping between the two through those sets
+// so the collection's count is never needed
+@interface PANKeyValueCollectionDiff : NSObject
+{
+    @public
+    NSMutableIndexSet *_insertedIndexes; // in the current collection
+    NSMutableIndexSet *_removedIndexes; // in the original collection
+    NSMutableIndexSet *_replacedIndexes; // in the original collection, never also removed
+    NSMutableArray *_insertedValues; // ordered as _insertedIndexes, nil once a change is missing its values
+    NSMutableArray *_removedValues; // ordered as _removedIndexes, likewise
+    NSUInteger _changeCount;
+}
+@end
+
+@implementation PANKeyValueCollectionDiff
+
+- (instancetype)initWithChange:(NSDictionary *)changeDict
+{
+    if (!(self = [super init]))
+        return nil;
+    _insertedIndexes = [NSMutableIndexSet indexSet];
+    _removedIndexes = [NSMutableIndexSet indexSet];
+    _replacedIndexes = [NSMutableIndexSet indexSet];
+    _insertedValues = [NSMutableArray array];
+    _removedValues = [NSMutableArray array];
+    [self applyChange:changeDict];
+    return self;
+}
+
+// index in the original collection of an item in the current one that wasn't inserted
+- (NSUInteger)originalIndexOfIndex:(NSUInteger)index
+{
+    // the nth item not removed, n being the index among the items not inserted
+    __block NSUInteger originalIndex = index - PANCountOfIndexesBelow(_insertedIndexes, index);
+    [_removedIndexes enumerateIndexesUsingBlock:^(NSUInteger removedIndex, BOOL *stop) {
+        if (removedIndex <= originalIndex)
+            originalIndex++;
+        else
+            *stop = YES;
+    }];
+    return originalIndex;
+}
+
+- (void)applyChange:(NSDictionary *)changeDict
+{
+    NSIndexSet *indexes = changeDict[NSKeyValueChangeIndexesKey];
+    _changeCount++;
+    
+    switch (PANChangeKind(changeDict)) {
+        case NSKeyValueChangeInsertion: {
+            NSArray *values = changeDict[NSKeyValueChangeNewKey];
+            if (values.count != indexes.count)
+                _insertedValues = nil;
+            __block NSUInteger valueIndex = 0;
+            [indexes enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
+                [self->_insertedIndexes shiftIndexesStartingAtIndex:index by:1];
+                [self->_insertedIndexes addIndex:index];
+                if (self->_insertedValues != nil)
+                    [self->_insertedValues insertObject:values[valueIndex++] atIndex:PANCountOfIndexesBelow(self->_insertedIndexes, index)];
+            }];
+            break;
+        }
+            
+        case NSKeyValueChangeRemoval: {
+            NSArray *values = changeDict[NSKeyValueChangeOldKey];
+            if (values.count != indexes.count)
+                _removedValues = nil;
+            // from the end, so the lower indexes are still those of the collection before the change
+            __block NSUInteger valueIndex = values.count;
+            [indexes enumerateIndexesWithOptions:NSEnumerationReverse usingBlock:^(NSUInteger index, BOOL *stop) {
+                id value = self->_removedValues != nil ? values[--valueIndex] : nil;
+                if ([self->_insertedIndexes containsIndex:index]) {
+                    [self->_insertedValues removeObjectAtIndex:PANCountOfIndexesBelow(self->_insertedIndexes, index)];
+                    [self->_insertedIndexes removeIndex:index];
+                }
+                else {
+                    NSUInteger originalIndex = [self originalIndexOfIndex:index];
+                    [self->_replacedIndexes removeIndex:originalIndex];
+                    if (self->_removedValues != nil)
+                        [self->_removedValues insertObject:value atIndex:PANCountOfIndexesBelow(self->_removedIndexes, originalIndex)];
+                    [self->_removedIndexes addIndex:originalIndex];
+                }
+                [self->_insertedIndexes shiftIndexesStartingAtIndex:index + 1 by:-1];
+            }];
+            break;
+        }
+            
+        case NSKeyValueChangeReplacement: {
+            NSArray *values = changeDict[NSKeyValueChangeNewKey];
+            __block NSUInteger valueIndex = 0;
+            [indexes enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
+                id value = valueIndex < values.count ? values[valueIndex] : nil;
+                valueIndex++;
+                if (![self->_insertedIndexes containsIndex:index])
+                    [self->_replacedIndexes addIndex:[self originalIndexOfIndex:index]];
+                else if (value == nil)
+                    self->_insertedValues = nil;
+                else
+                    [self->_insertedValues replaceObjectAtIndex:PANCountOfIndexesBelow(self->_insertedIndexes, index) withObject:value];
+            }];
+            break;
+        }
+    }
+}
+
+@end
+
+
+// the accessors shared by PANKeyValueObservation and PANKeyValueChange, reading the change dictionary or the net
+// diff of the changes merged into it
+static inline NSIndexSet *PANChangeNetIndexes(NSDictionary *changeDict, PANKeyValueCollectionDiff *diff, NSKeyValueChange kind)
+{
+    if (diff == nil)
+        return PANChangeIndexesOfKind(changeDict, kind);
+    if (kind == NSKeyValueChangeInsertion)
+        return [diff->_insertedIndexes copy];
+    return [(kind == NSKeyValueChangeRemoval ? diff->_removedIndexes : diff->_replacedIndexes) copy];
+}
+
+static inline NSArray *PANChangeNetValues(NSDictionary *changeDict, PANKeyValueCollectionDiff *diff, NSKeyValueChange kind)
+{
+    if (diff != nil)
+        return [(kind == NSKeyValueChangeInsertion ? diff->_insertedValues : diff->_removedValues) copy];
+    if (PANChangeKind(changeDict) != kind)
+        return nil;
+    return changeDict[kind == NSKeyValueChangeInsertion ? NSKeyValueChangeNewKey : NSKeyValueChangeOldKey];
+}
+
+static inline NSUInteger PANChangeMergedCount(PANKeyValueCollectionDiff *diff)
+{
+    return diff != nil ? diff->_changeCount : 1;
+}
 
 
 #pragma mark -
 
 @implementation PANKeyValueObservation
+{
+    pthread_mutex_t _filterLock; // guards the following
+    NSMutableDictionary *_lastValues; // key path -> new value of its last change not dropped by changeFilter
+    NSUInteger _suppressedChangeCount;
+}
 
 @synthesize keyPath;
-@synthesize changeDict;
-@synthesize kind;
-@synthesize prior;
-@synthesize changedValue;
-@synthesize oldValue;
-@synthesize indexes;
+@synthesize changedValue = _droppedChangedValue;
+@synthesize collectionDiff;
+
+// the base class designated initializers are overridden since snapshots are made using them
+- (instancetype)initWithObserver:(PAN_nullable id)observer object:(PAN_nullable id)observee queue:(PAN_nullable NSOperationQueue *)queue gcdQueue:(PAN_nullable dispatch_queue_t)gcdQueue block:(PAN_nullable PANObservationBlock)block
+{
+    if (!(self = [super initWithObserver:observer object:observee queue:queue gcdQueue:gcdQueue block:block]))
+        return nil;
+    _keepsChangeDictionary = YES;
+    pthread_mutex_init(&_filterLock, NULL);
+    return self;
+}
+
+- (instancetype)initWithObject:(PAN_nullable id)observee queue:(PAN_nullable NSOperationQueue *)queue gcdQueue:(PAN_nullable dispatch_queue_t)gcdQueue block:(PAN_nullable PANAnonymousObservationBlock)block
+{
+    if (!(self = [super initWithObject:observee queue:queue gcdQueue:gcdQueue block:block]))
+        return nil;
+    _keepsChangeDictionary = YES;
+    pthread_mutex_init(&_filterLock, NULL);
+    return self;
+}
 
 - (instancetype)initWithObserver:(PAN_nullable id)observer object:(id)object keyPaths:(NSArray *)keyPaths options:(int)options queue:(PAN_nullable NSOperationQueue *)queue gcdQueue:(PAN_nullable dispatch_queue_t)gcdQueue block:(PANObservationBlock)block
 {
-    if (!(self = [super initWithObserver:observer object:object queue:queue gcdQueue:gcdQueue block:block]))
+    if (!(self = [self initWithObserver:observer object:object queue:queue gcdQueue:gcdQueue block:block]))
         return nil;
     _keyPaths = keyPaths;
     _options = options;
@@ -58,45 +261,210 @@ static void *PANKeyValueObservationContext = (void *)&PANKeyValueObservationCont
 
 - (instancetype)initWithObject:(id)object keyPaths:(NSArray *)keyPaths options:(int)options queue:(PAN_nullable NSOperationQueue *)queue gcdQueue:(PAN_nullable dispatch_queue_t)gcdQueue block:(PANAnonymousObservationBlock)block
 {
-    if (!(self = [super initWithObject:object queue:queue gcdQueue:gcdQueue block:block]))
+    if (!(self = [self initWithObject:object queue:queue gcdQueue:gcdQueue block:block]))
         return nil;
     _keyPaths = keyPaths;
     _options = options;
     return self;
 }
 
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_filterLock);
+}
+
++ (BOOL)requiresRemovalBeforeObserveeDeallocates
+{
+    return YES; // before iOS 11 & macOS 10.13 KVO complains about observers still registered once dealloc is reached
+}
+
 - (void)registerInternal
 {
     NSAssert1(!self.registered, @"Attempted double-register of %@", self);
     NSAssert1(self.keyPaths != nil, @"Nil 'keyPaths' property when registering observation for %@", self);
     NSAssert1(self.keyPaths.count > 0, @"Empty 'keyPaths' property when registering observation for %@", self);
-    for (NSString *kp in self.keyPaths) {
-        [self.object addObserver:self forKeyPath:kp options:self.options context:PANKeyValueObservationContext];
+    if (self.coalescesCollectionChanges && !self.keepsChangeDictionary) {
+        static dispatch_once_t onceToken;
+        dispatch_once(&onceToken, ^{
+            NSLog(@"coalescesCollectionChanges has no effect without keepsChangeDictionary, changes won't be merged for %@", self);
+        });
+    }
+    self.registeredObject = self.observee;
+    // rather than adding itself as a KVO observer, shares the observee's registrations with other observations
+    self.registeredDispatcher = [PANKeyValueDispatcher dispatcherForObject:self.registeredObject];
+    [self.registeredDispatcher addObservation:self];
+}
+
+- (NSKeyValueObservingOptions)registrationOptions
+{
+    NSKeyValueObservingOptions options = self.options;
+    if (self.changeFilter != PANKeyValueChangeFilterNone)
+        options |= NSKeyValueObservingOptionNew;
+    return options;
+}
+
+- (void)setChangeFilter:(PANKeyValueChangeFilter)changeFilter
+{
+    pthread_mutex_lock(&_filterLock);
+    _changeFilter = changeFilter;
+    _lastValues = nil;
+    pthread_mutex_unlock(&_filterLock);
+    
+    if (self.registered)
+        [self.registeredDispatcher updateRegistrationOfObservation:self];
+}
+
+- (NSUInteger)suppressedChangeCount
+{
+    pthread_mutex_lock(&_filterLock);
+    NSUInteger count = _suppressedChangeCount;
+    pthread_mutex_unlock(&_filterLock);
+    return count;
+}
+
+- (void)observeChange:(NSDictionary *)change ofKeyPath:(NSString *)observedKeyPath object:(id)object
+{
+    NSAssert2([self.keyPaths containsObject:observedKeyPath], @"Invoked with unexpected keypath '%@' %@", observedKeyPath, self);
+    if (self.changeFilter != PANKeyValueChangeFilterNone && [self shouldDropChange:change ofKeyPath:observedKeyPath])
+        return;
+    PANObservationEvent event = PANObservationEventMake(object, change, observedKeyPath);
+    [self triggerEvent:&event synchronously:NO];
+}
+
+- (void)observeTransactionChanges:(NSArray *)changes
+{
+    NSMutableArray *detectedObservations = nil;
+    PANKeyValueTransactionChange *onlyChange = nil;
+    for (PANKeyValueTransactionChange *transactionChange in changes) {
+        // the filter's last values are those of the observee's key paths, not of other objects a subclass observes
+        if (self.changeFilter != PANKeyValueChangeFilterNone && transactionChange.object == self.registeredObject && [self shouldDropChange:transactionChange.change ofKeyPath:transactionChange.keyPath])
+            continue;
+        if (onlyChange == nil && detectedObservations == nil) {
+            onlyChange = transactionChange; // the usual case, triggered without creating a detected observation
+            continue;
+        }
+        if (detectedObservations == nil)
+            detectedObservations = [NSMutableArray arrayWithObject:[self detectedObservationOfTransactionChange:onlyChange]];
+        [detectedObservations addObject:[self detectedObservationOfTransactionChange:transactionChange]];
+    }
+    
+    if (detectedObservations != nil) {
+        [self deliverDetectedObservations:detectedObservations];
+    }
+    else if (onlyChange != nil) {
+        PANObservationEvent event = PANObservationEventMake(onlyChange.object, onlyChange.change, onlyChange.keyPath);
+        [self triggerEvent:&event synchronously:NO];
+    }
+}
+
+- (PANDetectedObservation *)detectedObservationOfTransactionChange:(PANKeyValueTransactionChange *)transactionChange
+{
+    PANDetectedObservation *detectedObservation = [self createDetectedObservation];
+    PANObservationEvent event = PANObservationEventMake(transactionChange.object, transactionChange.change, transactionChange.keyPath);
+    [self applyEvent:&event toDetectedObservation:detectedObservation];
+    return detectedObservation;
+}
+
+- (BOOL)shouldDropChange:(NSDictionary *)change ofKeyPath:(NSString *)observedKeyPath
+{
+    id newValue = change[NSKeyValueChangeNewKey]; // NSNull for nil, so missing only if the filter was just set
+    if (newValue == nil || PANChangeIsPrior(change) || PANChangeKind(change) != NSKeyValueChangeSetting)
+        return NO;
+    
+    pthread_mutex_lock(&_filterLock);
+    
+    id lastValue = _lastValues[observedKeyPath];
+    BOOL unchanged = lastValue != nil && (lastValue == newValue || (_changeFilter == PANKeyValueChangeFilterEqualValues && [lastValue isEqual:newValue]));
+    if (unchanged) {
+        _suppressedChangeCount++;
     }
+    else {
+        if (_lastValues == nil)
+            _lastValues = [NSMutableDictionary dictionary];
+        _lastValues[observedKeyPath] = newValue;
+    }
+    
+    pthread_mutex_unlock(&_filterLock);
+    return unchanged;
 }
 
-- (void)observeValueForKeyPath:(PAN_nullable NSString *)observedKeyPath ofObject:(PAN_nullable id)object change:(PAN_nullable NSDictionary *)changedict context:(PAN_nullable void *)context
-{
-    if (context == PANKeyValueObservationContext) {
-        NSAssert2([self.keyPaths containsObject:observedKeyPath], @"Invoked with unexpected keypath '%@' %@", observedKeyPath, self);
-        [self triggerWithSetupBlock:^(id<PANDetectedObservation> obs) {
-            if (![obs conformsToProtocol:@protocol(PANMutableKeyValueChange)])
-                return;
-            id<PANMutableKeyValueChange> change = (id<PANMutableKeyValueChange>)obs;
-            change.keyPath = observedKeyPath;
-            change.payload = change.changeDict = changedict;
-            change.kind = [(NSNumber *)changedict[NSKeyValueChangeKindKey] unsignedIntegerValue];
-            change.prior = [(NSNumber *)changedict[NSKeyValueChangeNotificationIsPriorKey] unsignedIntegerValue];
-            change.changedValue = changedict[NSKeyValueChangeNewKey];
-            change.oldValue = changedict[NSKeyValueChangeOldKey];
-            change.indexes = changedict[NSKeyValueChangeIndexesKey];
-        }];
+- (void)applyEvent:(const PANObservationEvent *)event toDetectedObservation:(id<PANMutableDetectedObservation>)detectedObservation
+{
+    [super applyEvent:event toDetectedObservation:detectedObservation];
+    if (![detectedObservation conformsToProtocol:@protocol(PANMutableKeyValueChange)])
+        return;
+    id<PANMutableKeyValueChange> change = (id<PANMutableKeyValueChange>)detectedObservation;
+    change.keyPath = event->detail;
+    change.collectionDiff = nil;
+    if (self.keepsChangeDictionary) {
+        change.changedValue = nil; // the payload set by super is the change dictionary
     }
     else {
-        [super observeValueForKeyPath:keyPath ofObject:object change:changedict context:context];
+        change.changedValue = ((NSDictionary *)event->payload)[NSKeyValueChangeNewKey];
+        change.payload = nil;
     }
 }
 
+- (PAN_nullable NSDictionary *)changeDict
+{
+    return self.payload;
+}
+
+- (NSUInteger)kind
+{
+    return PANChangeKind(self.changeDict);
+}
+
+- (BOOL)isPrior
+{
+    return PANChangeIsPrior(self.changeDict);
+}
+
+- (PAN_nullable id)changedValue
+{
+    return PANChangeNewValue(self.changeDict, _droppedChangedValue);
+}
+
+- (PAN_nullable id)oldValue
+{
+    return PANChangeOldValue(self.changeDict);
+}
+
+- (PAN_nullable NSIndexSet *)indexes
+{
+    return PANChangeIndexes(self.changeDict);
+}
+
+- (PAN_nullable NSIndexSet *)insertedIndexes
+{
+    return PANChangeNetIndexes(self.changeDict, self.collectionDiff, NSKeyValueChangeInsertion);
+}
+
+- (PAN_nullable NSIndexSet *)removedIndexes
+{
+    return PANChangeNetIndexes(self.changeDict, self.collectionDiff, NSKeyValueChangeRemoval);
+}
+
+- (PAN_nullable NSIndexSet *)replacedIndexes
+{
+    return PANChangeNetIndexes(self.changeDict, self.collectionDiff, NSKeyValueChangeReplacement);
+}
+
+- (PAN_nullable NSArray *)insertedValues
+{
+    return PANChangeNetValues(self.changeDict, self.collectionDiff, NSKeyValueChangeInsertion);
+}
+
+- (PAN_nullable NSArray *)removedValues
+{
+    return PANChangeNetValues(self.changeDict, self.collectionDiff, NSKeyValueChangeRemoval);
+}
+
+- (NSUInteger)mergedChangeCount
+{
+    return PANChangeMergedCount(self.collectionDiff);
+}
+
 - (void)duplicateFrom:(id<PANDetectedObservation>)source
 {
     [super duplicateFrom:source];
@@ -104,12 +472,20 @@ static void *PANKeyValueObservationContext = (void *)&PANKeyValueObservationCont
         return;
     id<PANKeyValueChange> change = (id<PANKeyValueChange>)source;
     self.keyPath = change.keyPath;
-    self.changeDict = change.changeDict;
-    self.kind = change.kind;
-    self.prior = change.prior;
-    self.changedValue = change.changedValue;
-    self.oldValue = change.oldValue;
-    self.indexes = change.indexes;
+    self.changedValue = change.changeDict == nil ? change.changedValue : nil; // super copied the payload
+    if ([source conformsToProtocol:@protocol(PANMutableKeyValueChange)])
+        self.collectionDiff = ((id<PANMutableKeyValueChange>)source).collectionDiff;
+}
+
+- (void)configureSnapshot:(PANObservation *)snapshot
+{
+    PANKeyValueObservation *kvoSnapshot = (PANKeyValueObservation *)snapshot;
+    kvoSnapshot.keyPaths = self.keyPaths;
+    kvoSnapshot.options = self.options;
+    kvoSnapshot.keepsChangeDictionary = self.keepsChangeDictionary;
+    kvoSnapshot->_changeFilter = self.changeFilter; // not the setter, a snapshot is never registered
+    kvoSnapshot.coalescesCollectionChanges = self.coalescesCollectionChanges;
+    [super configureSnapshot:snapshot];
 }
 
 - (void)deregisterInternal
@@ -117,9 +493,36 @@ static void *PANKeyValueObservationContext = (void *)&PANKeyValueObservationCont
     NSAssert1(self.registered, @"Attempted double-removal of %@", self);
     NSAssert1(self.keyPaths != nil, @"Nil 'keyPaths' property when deregistering observation for %@", self);
     NSAssert1(self.keyPaths.count > 0, @"Empty 'keyPaths' property when deregistering observation for %@", self);
-    for (NSString *kp in self.keyPaths) {
-        [self.object removeObserver:self forKeyPath:kp context:NULL];
+    [self.registeredDispatcher removeObservation:self];
+    self.registeredDispatcher = nil;
+    self.registeredObject = nil;
+}
+
++ (void)deregisterObservations:(NSArray *)observations
+{
+    // remove all observations of one observee before moving to the next, rather than hopping between observees'
+    // dispatchers in whatever order the observations were stored. observees are keyed by pointer and not
+    // retained, one may be part way through dealloc
+    CFMutableDictionaryRef observationsByObservee = CFDictionaryCreateMutable(NULL, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+    NSMutableArray *observees = [NSMutableArray array]; // in first-seen order, as unretained pointers
+    for (PANKeyValueObservation *observation in observations) {
+        const void *observee = (__bridge const void *)observation.registeredObject;
+        NSMutableArray *observeeObservations = (__bridge NSMutableArray *)CFDictionaryGetValue(observationsByObservee, observee);
+        if (observeeObservations == nil) {
+            CFDictionarySetValue(observationsByObservee, observee, (__bridge const void *)[NSMutableArray arrayWithObject:observation]);
+            [observees addObject:[NSValue valueWithPointer:observee]];
+        }
+        else {
+            [observeeObservations addObject:observation];
+        }
+    }
+    
+    for (NSValue *observee in observees) {
+        NSArray *observeeObservations = (__bridge NSArray *)CFDictionaryGetValue(observationsByObservee, observee.pointerValue);
+        for (PANKeyValueObservation *observation in observeeObservations)
+            [observation deregisterInternal];
     }
+    CFRelease(observationsByObservee);
 }
 
 - (PANDetectedObservation *)createDetectedObservation
@@ -127,6 +530,41 @@ static void *PANKeyValueObservationContext = (void *)&PANKeyValueObservationCont
     return [[PANKeyValueChange alloc] init];
 }
 
+- (PAN_nullable id<NSCopying>)collationKeyForDetectedObservation:(PANDetectedObservation *)detectedObservation
+{
+    return ((PANKeyValueChange *)detectedObservation).keyPath;
+}
+
+- (BOOL)mergeDetectedObservation:(PANDetectedObservation *)detectedObservation intoDetectedObservation:(PANDetectedObservation *)previous
+{
+    if (!self.coalescesCollectionChanges || ![detectedObservation isKindOfClass:[PANKeyValueChange class]] || ![previous isKindOfClass:[PANKeyValueChange class]])
+        return NO;
+    PANKeyValueChange *change = (PANKeyValueChange *)detectedObservation;
+    PANKeyValueChange *mergedChange = (PANKeyValueChange *)previous;
+    if (change.object != mergedChange.object || ![change.keyPath isEqualToString:mergedChange.keyPath])
+        return NO;
+    if (!PANChangeIsToMany(change.changeDict) || (mergedChange.collectionDiff == nil && !PANChangeIsToMany(mergedChange.changeDict)))
+        return NO;
+    
+    if (mergedChange.collectionDiff == nil)
+        mergedChange.collectionDiff = [[PANKeyValueCollectionDiff alloc] initWithChange:mergedChange.changeDict];
+    [mergedChange.collectionDiff applyChange:change.changeDict];
+    mergedChange.payload = change.payload;
+    mergedChange.timestampNanoseconds = change.timestampNanoseconds;
+    return YES;
+}
+
+- (NSUInteger)collationCostOfDetectedObservation:(PANDetectedObservation *)detectedObservation
+{
+    PANKeyValueChange *change = (PANKeyValueChange *)detectedObservation;
+    NSUInteger cost = [super collationCostOfDetectedObservation:detectedObservation];
+    if (change.changedValue != nil)
+        cost += malloc_size((__bridge const void *)change.changedValue);
+    if (change.oldValue != nil)
+        cost += malloc_size((__bridge const void *)change.oldValue);
+    return cost;
+}
+
 + (BOOL)removeForObserver:(PAN_nullable id)observer object:(id)object keyPaths:(NSArray *)keyPaths
 {
     PANKeyValueObservation *observation = [self findObservationForObserver:observer object:object keyPaths:keyPaths];
@@ -139,9 +577,12 @@ static void *PANKeyValueObservationContext = (void *)&PANKeyValueObservationCont
 
 + (PAN_nullable PANKeyValueObservation *)findObservationForObserver:(PAN_nullable id)observer object:(id)object keyPaths:(NSArray *)keyPaths
 {
-    return (PANKeyValueObservation *)[self findObservationForObserver:observer object:object matchingTest:^BOOL(PANObservation *obs) {
-        return [obs isKindOfClass:[PANKeyValueObservation class]] && [((PANKeyValueObservation *)obs).keyPaths isEqualToArray:keyPaths];
-    }];
+    return (PANKeyValueObservation *)[self findObservationForObserver:observer object:object indexSubkey:keyPaths];
+}
+
+- (PAN_nullable id)indexSubkey
+{
+    return self.keyPaths;
 }
 
 - (NSString *)description
@@ -158,12 +599,68 @@ static void *PANKeyValueObservationContext = (void *)&PANKeyValueObservationCont
 @implementation PANKeyValueChange
 
 @synthesize keyPath;
-@synthesize changeDict;
-@synthesize kind;
-@synthesize prior;
-@synthesize changedValue;
-@synthesize oldValue;
-@synthesize indexes;
+@synthesize changedValue = _droppedChangedValue;
+@synthesize collectionDiff;
+
+- (PAN_nullable NSDictionary *)changeDict
+{
+    return self.payload;
+}
+
+- (NSUInteger)kind
+{
+    return PANChangeKind(self.changeDict);
+}
+
+- (BOOL)isPrior
+{
+    return PANChangeIsPrior(self.changeDict);
+}
+
+- (PAN_nullable id)changedValue
+{
+    return PANChangeNewValue(self.changeDict, _droppedChangedValue);
+}
+
+- (PAN_nullable id)oldValue
+{
+    return PANChangeOldValue(self.changeDict);
+}
+
+- (PAN_nullable NSIndexSet *)indexes
+{
+    return PANChangeIndexes(self.changeDict);
+}
+
+- (PAN_nullable NSIndexSet *)insertedIndexes
+{
+    return PANChangeNetIndexes(self.changeDict, self.collectionDiff, NSKeyValueChangeInsertion);
+}
+
+- (PAN_nullable NSIndexSet *)removedIndexes
+{
+    return PANChangeNetIndexes(self.changeDict, self.collectionDiff, NSKeyValueChangeRemoval);
+}
+
+- (PAN_nullable NSIndexSet *)replacedIndexes
+{
+    return PANChangeNetIndexes(self.changeDict, self.collectionDiff, NSKeyValueChangeReplacement);
+}
+
+- (PAN_nullable NSArray *)insertedValues
+{
+    return PANChangeNetValues(self.changeDict, self.collectionDiff, NSKeyValueChangeInsertion);
+}
+
+- (PAN_nullable NSArray *)removedValues
+{
+    return PANChangeNetValues(self.changeDict, self.collectionDiff, NSKeyValueChangeRemoval);
+}
+
+- (NSUInteger)mergedChangeCount
+{
+    return PANChangeMergedCount(self.collectionDiff);
+}
 
 - (NSString *)description
 {
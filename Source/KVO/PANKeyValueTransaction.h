@@ -0,0 +1,58 @@
+//
+//  PANKeyValueTransaction.h
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-29.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+//  The changes made on one thread during `+[Panopticon performBatchedUpdates:]`. While a transaction is current,
+//  the dispatchers of observed objects record each KVO change into it instead of passing it to their observations,
+//  one record per object and key path. Consecutive changes setting a key path are collapsed as they're recorded,
+//  keeping the first's old value and the last's new value. Insertions, removals and replacements are kept in order.
+//  Each record retains its object until the transaction is delivered, so an object released inside the transaction's
+//  block is still there for the observations its changes are passed to.
+//
+//  When the outermost transaction ends, the net changes of each record are gathered per observation, then each
+//  observation affected is passed all of its changes at once, with `observeTransactionChanges:`. Changes made on
+//  other threads meanwhile aren't part of the transaction and are delivered as usual.
+
+#import <Foundation/Foundation.h>
+#import "PANDefines.h"
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+@class PANKeyValueDispatcher;
+
+/**
+ *  One net change to pass to an observation when a transaction ends.
+ */
+@interface PANKeyValueTransactionChange : NSObject
+@property (nonatomic, readonly) NSString *keyPath;
+@property (nonatomic, readonly) id object;
+@property (nonatomic, readonly) NSDictionary *change;
+@end
+
+
+@interface PANKeyValueTransaction : NSObject
+
+/**
+ *  Run the block as a transaction on the current thread, or as part of the transaction already running. The
+ *  changes recorded are delivered even if the block raises, the objects already having been changed.
+ */
++ (void)performTransaction:(void (^)(void))block;
+
+/**
+ *  The transaction of the current thread, `nil` outside of `performTransaction:`.
+ */
++ (PAN_nullable PANKeyValueTransaction *)currentTransaction;
+
+/**
+ *  Record a change a dispatcher received from Foundation KVO. Prior notifications are dropped.
+ */
+- (void)recordChange:(NSDictionary *)change ofKeyPath:(NSString *)keyPath dispatcher:(PANKeyValueDispatcher *)dispatcher;
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
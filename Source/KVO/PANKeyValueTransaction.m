@@ -0,0 +1,195 @@
+//
+//  PANKeyValueTransaction.m
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-29.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANKeyValueTransaction.h"
+#import "PANKeyValueDispatcher.h"
+#import "PANKeyValueObservation.h"
+#import "PANKeyValueObservation+Private.h"
+#import <pthread.h>
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+static pthread_key_t transactionKey;
+static pthread_once_t transactionKeyOnce = PTHREAD_ONCE_INIT;
+
+static void PANMakeTransactionKey(void)
+{
+    pthread_key_create(&transactionKey, NULL); // the value is only set for the duration of performTransaction:
+}
+
+
+@interface PANKeyValueTransactionChange ()
+@property (nonatomic, readwrite) NSString *keyPath;
+@property (nonatomic, readwrite) id object;
+@property (nonatomic, readwrite) NSDictionary *change;
+@end
+
+@implementation PANKeyValueTransactionChange
+@end
+
+
+// the changes of one key path of one object
+@interface PANKeyValueTransactionRecord : NSObject
+{
+    @public
+    PANKeyValueDispatcher *_dispatcher;
+    id _object; // the dispatcher's, retained since it may be released before the transaction is delivered
+    NSString *_keyPath;
+    NSMutableArray *_changes;
+    NSMutableArray *_runStarts; // parallel to _changes, the first of the settings collapsed into a change or NSNull
+}
+@end
+
+@implementation PANKeyValueTransactionRecord
+
+- (void)addChange:(NSDictionary *)change
+{
+    NSDictionary *lastChange = _changes.lastObject;
+    BOOL setting = [(NSNumber *)change[NSKeyValueChangeKindKey] unsignedIntegerValue] == NSKeyValueChangeSetting;
+    if (setting && lastChange != nil && [(NSNumber *)lastChange[NSKeyValueChangeKindKey] unsignedIntegerValue] == NSKeyValueChangeSetting) {
+        NSUInteger last = _changes.count - 1;
+        if (_runStarts[last] == [NSNull null])
+            _runStarts[last] = lastChange;
+        _changes[last] = change;
+        return;
+    }
+    [_changes addObject:change];
+    [_runStarts addObject:[NSNull null]];
+}
+
+- (NSArray *)netChanges
+{
+    NSMutableArray *netChanges = [NSMutableArray arrayWithCapacity:_changes.count];
+    [_changes enumerateObjectsUsingBlock:^(NSDictionary *change, NSUInteger idx, BOOL *stop) {
+        NSDictionary *runStart = self->_runStarts[idx];
+        if (runStart != (id)[NSNull null] && runStart[NSKeyValueChangeOldKey] != nil) {
+            NSMutableDictionary *netChange = [change mutableCopy];
+            netChange[NSKeyValueChangeOldKey] = runStart[NSKeyValueChangeOldKey];
+            change = netChange;
+        }
+        PANKeyValueTransactionChange *transactionChange = [[PANKeyValueTransactionChange alloc] init];
+        transactionChange.keyPath = self->_keyPath;
+        transactionChange.object = self->_object;
+        transactionChange.change = change;
+        [netChanges addObject:transactionChange];
+    }];
+    return netChanges;
+}
+
+@end
+
+
+#pragma mark -
+
+@implementation PANKeyValueTransaction
+{
+    NSMutableArray *_records; // in the order of their first change
+    CFMutableDictionaryRef _recordsByDispatcher; // dispatcher pointer -> NSMutableArray of its records
+}
+
++ (void)performTransaction:(void (^)(void))block
+{
+    if ([self currentTransaction] != nil) {
+        block(); // nested, the outermost transaction delivers everything
+        return;
+    }
+
+    PANKeyValueTransaction *transaction = [[self alloc] init];
+    pthread_setspecific(transactionKey, (__bridge const void *)transaction); // kept alive by the local variable
+    @try {
+        block();
+    }
+    @finally {
+        // the objects were changed whether or not the block finished, so observations still need to hear of it
+        pthread_setspecific(transactionKey, NULL);
+        [transaction deliver];
+    }
+}
+
++ (PAN_nullable PANKeyValueTransaction *)currentTransaction
+{
+    pthread_once(&transactionKeyOnce, PANMakeTransactionKey);
+    return (__bridge PANKeyValueTransaction *)pthread_getspecific(transactionKey);
+}
+
+- (instancetype)init
+{
+    if (!(self = [super init]))
+        return nil;
+    _records = [NSMutableArray array];
+    _recordsByDispatcher = CFDictionaryCreateMutable(NULL, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+    return self;
+}
+
+- (void)dealloc
+{
+    CFRelease(_recordsByDispatcher);
+}
+
+- (void)recordChange:(NSDictionary *)change ofKeyPath:(NSString *)keyPath dispatcher:(PANKeyValueDispatcher *)dispatcher
+{
+    if ([(NSNumber *)change[NSKeyValueChangeNotificationIsPriorKey] boolValue])
+        return;
+
+    NSMutableArray *dispatcherRecords = (__bridge NSMutableArray *)CFDictionaryGetValue(_recordsByDispatcher, (__bridge const void *)dispatcher);
+    PANKeyValueTransactionRecord *record = nil;
+    for (PANKeyValueTransactionRecord *dispatcherRecord in dispatcherRecords) {
+        if (dispatcherRecord->_keyPath == keyPath || [dispatcherRecord->_keyPath isEqualToString:keyPath]) {
+            record = dispatcherRecord;
+            break;
+        }
+    }
+
+    if (record == nil) {
+        record = [[PANKeyValueTransactionRecord alloc] init];
+        record->_dispatcher = dispatcher;
+        record->_object = dispatcher.object; // in the middle of sending a change, so not deallocating
+        record->_keyPath = [keyPath copy];
+        record->_changes = [NSMutableArray array];
+        record->_runStarts = [NSMutableArray array];
+        [_records addObject:record];
+        if (dispatcherRecords == nil)
+            CFDictionarySetValue(_recordsByDispatcher, (__bridge const void *)dispatcher, (__bridge const void *)[NSMutableArray arrayWithObject:record]);
+        else
+            [dispatcherRecords addObject:record];
+    }
+    [record addChange:change];
+}
+
+- (void)deliver
+{
+    // gather each observation's changes from all the records, the observations of a key path are those it has now
+    NSMutableArray *observations = [NSMutableArray array];
+    CFMutableDictionaryRef changesByObservation = CFDictionaryCreateMutable(NULL, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+    for (PANKeyValueTransactionRecord *record in _records) {
+        NSArray *keyPathObservations = [record->_dispatcher observationsOfKeyPath:record->_keyPath];
+        if (keyPathObservations.count == 0)
+            continue;
+        NSArray *netChanges = [record netChanges];
+        for (PANKeyValueObservation *observation in keyPathObservations) {
+            NSMutableArray *changes = (__bridge NSMutableArray *)CFDictionaryGetValue(changesByObservation, (__bridge const void *)observation);
+            if (changes == nil) {
+                CFDictionarySetValue(changesByObservation, (__bridge const void *)observation, (__bridge const void *)[netChanges mutableCopy]);
+                [observations addObject:observation];
+            }
+            else {
+                [changes addObjectsFromArray:netChanges];
+            }
+        }
+    }
+
+    for (PANKeyValueObservation *observation in observations)
+        [observation observeTransactionChanges:(__bridge NSArray *)CFDictionaryGetValue(changesByObservation, (__bridge const void *)observation)];
+    CFRelease(changesByObservation);
+}
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
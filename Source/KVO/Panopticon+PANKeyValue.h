@@ -262,6 +262,27 @@ PAN_ASSUME_NONNULL_BEGIN
  */
 + (BOOL)resumeObservingForChanges:(id)object toKeyPaths:(NSArray *)keyPaths;
 
+
+#pragma mark - Batch changes
+
+/**
+ *  Make many KVO changes, such as while importing, delivering them to observations once the block returns rather
+ *  than as each is made.
+ *
+ *  KVO changes made on the calling thread during the block are recorded instead of triggering observations. Once
+ *  it returns, each observation affected is triggered once: changes setting the same key path of an object are
+ *  reduced to one with the first old value and the last new value, and an observation with more than one such net
+ *  change gets them all in `collated`. So a loop making thousands of changes costs one delivery per observation.
+ *
+ *  Prior notifications are dropped. Changes made on other threads meanwhile are delivered as usual. Calls can be
+ *  nested, delivery happens when the outermost returns. If the block raises an exception, the changes it made
+ *  before that are still delivered as the exception leaves the outermost call, since KVO has already applied them,
+ *  there's no rolling back.
+ *
+ *  @param updates The block making the changes, called synchronously.
+ */
++ (void)performBatchedUpdates:(void (^)(void))updates;
+
 @end
 
 
@@ -9,6 +9,7 @@
 #import "Panopticon+PANKeyValue.h"
 #import "PanopticonClass+Private.h"
 #import "PANKeyValueObservation.h"
+#import "PANKeyValueTransaction.h"
 
 PAN_ASSUME_NONNULL_BEGIN
 
@@ -216,6 +217,11 @@ PAN_ASSUME_NONNULL_BEGIN
     return [[self sharedPanopticonObject] pan_resumeObservingForChanges:object toKeyPaths:keyPaths];
 }
 
++ (void)performBatchedUpdates:(void (^)(void))updates
+{
+    [PANKeyValueTransaction performTransaction:updates];
+}
+
 @end
 
 
@@ -0,0 +1,31 @@
+//
+//  NSObject+PANObservation.h
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-24.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "PANObservation.h"
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+@interface NSObject (PANObservation)
+
+#pragma mark - Stop all observations
+
+/**
+ *  Stop every observation made by the receiver or on the receiver, of any kind, regardless of their
+ *  `removeAutomatically` property.
+ *
+ *  Done in one pass instead of removing each observation separately, so is a cheaper way for an object with many
+ *  observations to tear them all down, for example when a view controller's view goes offscreen.
+ */
+- (void)pan_removeAllObservations;
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
@@ -0,0 +1,25 @@
+//
+//  NSObject+PANObservation.m
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-24.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "NSObject+PANObservation.h"
+#import "PANObservation+Private.h"
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+@implementation NSObject (PANObservation)
+
+- (void)pan_removeAllObservations
+{
+    [PANObservation removeAllObservationsOfObject:self];
+}
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
@@ -82,6 +82,27 @@ PAN_ASSUME_NONNULL_BEGIN
 
 - (PAN_nullable PANNotificationObservation *)pan_observeForNotifications:(id)object named:(NSString *)name onGCDQueue:(dispatch_queue_t)gcdQueue withBlock:(PANObservationBlock)block;
 
+/**
+ *  Receiver observes notifications posted with given name by a given object, calling its block on the given queue
+ *  and merging those posted before an earlier one has been delivered.
+ *
+ *  Variation on `pan_observeForNotifications:named:onQueue:withBlock:` and `pan_observeForNotifications:named:onGCDQueue:withBlock:`
+ *  that adds a coalescing parameter, see `coalescing` in `PANNotificationObservation`. The `coalescedCount` of the
+ *  observation when the block is called gives how many notifications were merged into the one delivered.
+ *
+ *  @param object     The object to observe.
+ *  @param name       The notification name to observe.
+ *  @param queue      The operation queue or CGD dispatch queue on which to call `block`.
+ *  @param coalescing Which notifications to merge into one waiting for delivery.
+ *  @param block      The block to call when observation is triggered, is passed the receiver (which can be used in
+ *                    place of a weakly captured self), and the observation (same as method result).
+ *
+ *  @return An observation object. You often don't need to keep this result.
+ */
+- (PAN_nullable PANNotificationObservation *)pan_observeForNotifications:(id)object named:(NSString *)name onQueue:(NSOperationQueue *)queue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANObservationBlock)block;
+
+- (PAN_nullable PANNotificationObservation *)pan_observeForNotifications:(id)object named:(NSString *)name onGCDQueue:(dispatch_queue_t)cgdQueue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANObservationBlock)block;
+
 
 /**
  *  Receiver stops observing notifications posted with given name by a given object.
@@ -191,6 +212,26 @@ PAN_ASSUME_NONNULL_BEGIN
 
 - (PAN_nullable PANNotificationObservation *)pan_observeAllNotificationsNamed:(NSString *)name onGCDQueue:(dispatch_queue_t)cgdQueue withBlock:(PANObservationBlock)block;
 
+/**
+ *  Receiver observes notifications posted with given name by any object, calling its block on the given queue and
+ *  merging those posted before an earlier one has been delivered.
+ *
+ *  Variation on `pan_observeAllNotificationsNamed:onQueue:withBlock:` and `pan_observeAllNotificationsNamed:onGCDQueue:withBlock:`
+ *  that adds a coalescing parameter, see `coalescing` in `PANNotificationObservation`. The `coalescedCount` of the
+ *  observation when the block is called gives how many notifications were merged into the one delivered.
+ *
+ *  @param name       The notification name to observe.
+ *  @param queue      The operation queue or CGD dispatch queue on which to call `block`.
+ *  @param coalescing Which notifications to merge into one waiting for delivery.
+ *  @param block      The block to call when observation is triggered, is passed the receiver (which can be used in
+ *                    place of a weakly captured self), and the observation (same as method result).
+ *
+ *  @return An observation object. You often don't need to keep this result.
+ */
+- (PAN_nullable PANNotificationObservation *)pan_observeAllNotificationsNamed:(NSString *)name onQueue:(NSOperationQueue *)queue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANObservationBlock)block;
+
+- (PAN_nullable PANNotificationObservation *)pan_observeAllNotificationsNamed:(NSString *)name onGCDQueue:(dispatch_queue_t)cgdQueue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANObservationBlock)block;
+
 
 /**
  *  Receiver stops observing notifications posted with given name by a given object.
@@ -298,6 +339,26 @@ PAN_ASSUME_NONNULL_BEGIN
 
 - (PAN_nullable PANNotificationObservation *)pan_observeNotificationsNamed:(NSString *)name onGCDQueue:(dispatch_queue_t)cgdQueue withBlock:(PANAnonymousObservationBlock)block;
 
+/**
+ *  Observe notifications posted with given name by the receiver, calling its block on the given queue and merging
+ *  those posted before an earlier one has been delivered.
+ *
+ *  Variation on `pan_observeNotificationsNamed:onQueue:withBlock:` and `pan_observeNotificationsNamed:onGCDQueue:withBlock:`
+ *  that adds a coalescing parameter, see `coalescing` in `PANNotificationObservation`. The `coalescedCount` of the
+ *  observation when the block is called gives how many notifications were merged into the one delivered.
+ *
+ *  @param name       The notification name to observe.
+ *  @param queue      The operation queue or CGD dispatch queue on which to call `block`.
+ *  @param coalescing Which notifications to merge into one waiting for delivery.
+ *  @param block      The block to call when observation is triggered, is passed the observation (same as the method
+ *                    result).
+ *
+ *  @return An observation object. You often don't need to keep this result.
+ */
+- (PAN_nullable PANNotificationObservation *)pan_observeNotificationsNamed:(NSString *)name onQueue:(NSOperationQueue *)queue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANAnonymousObservationBlock)block;
+
+- (PAN_nullable PANNotificationObservation *)pan_observeNotificationsNamed:(NSString *)name onGCDQueue:(dispatch_queue_t)cgdQueue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANAnonymousObservationBlock)block;
+
 
 /**
  *  Stops observing notifications posted with given name by the receiver.
@@ -406,6 +467,26 @@ PAN_ASSUME_NONNULL_BEGIN
 
 - (PAN_nullable PANNotificationObservation *)pan_observeOwnNotificationsNamed:(NSString *)name onGCDQueue:(dispatch_queue_t)cgdQueue withBlock:(PANObservationBlock)block;
 
+/**
+ *  Receiver observes notifications it posts with given name, calling its block on the given queue and merging those
+ *  posted before an earlier one has been delivered.
+ *
+ *  Variation on `pan_observeOwnNotificationsNamed:onQueue:withBlock:` and `pan_observeOwnNotificationsNamed:onGCDQueue:withBlock:`
+ *  that adds a coalescing parameter, see `coalescing` in `PANNotificationObservation`. The `coalescedCount` of the
+ *  observation when the block is called gives how many notifications were merged into the one delivered.
+ *
+ *  @param name       The notification name to observe.
+ *  @param queue      The operation queue or CGD dispatch queue on which to call `block`.
+ *  @param coalescing Which notifications to merge into one waiting for delivery.
+ *  @param block      The block to call when observation is triggered, is passed the receiver (which can be used in
+ *                    place of a weakly captured self), and the observation (same as method result).
+ *
+ *  @return An observation object. You often don't need to keep this result.
+ */
+- (PAN_nullable PANNotificationObservation *)pan_observeOwnNotificationsNamed:(NSString *)name onQueue:(NSOperationQueue *)queue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANObservationBlock)block;
+
+- (PAN_nullable PANNotificationObservation *)pan_observeOwnNotificationsNamed:(NSString *)name onGCDQueue:(dispatch_queue_t)cgdQueue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANObservationBlock)block;
+
 
 /**
  *  Receiver stops observing notifications it posts with given name.
@@ -454,14 +535,16 @@ PAN_ASSUME_NONNULL_BEGIN
 #pragma mark - Convenince posting methods
 
 /**
- *  Post notification with a given name by the receiver.
+ *  Post notification with a given name by the receiver. Posted through `PANNotificationHub` if the name is
+ *  registered with it, otherwise to the default `NSNotificationCenter`.
  *
  *  @param name The notification name to post.
  */
 - (void)pan_postNotificationNamed:(NSString *)name;
 
 /**
- *  Post notification with a given name by the receiver, with the given user info dictionary.
+ *  Post notification with a given name by the receiver, with the given user info dictionary. Posted through
+ *  `PANNotificationHub` if the name is registered with it, otherwise to the default `NSNotificationCenter`.
  *
  *  @param name     The notification name to post.
  *  @param userInfo The user info dictionary to include.
@@ -8,6 +8,7 @@
 
 #import "NSObject+PANNotification.h"
 #import "PANNotificationObservation+Private.h"
+#import "PANNotificationHub.h"
 #import "PANObservation+Private.h"
 
 PAN_ASSUME_NONNULL_BEGIN
@@ -65,6 +66,22 @@ PAN_ASSUME_NONNULL_BEGIN
     return observation;
 }
 
+- (PAN_nullable PANNotificationObservation *)pan_observeForNotifications:(id)object named:(NSString *)name onQueue:(NSOperationQueue *)queue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANObservationBlock)block
+{
+    PANNotificationObservation *observation = [[PANNotificationObservation alloc] initWithObserver:self object:object name:name queue:queue gcdQueue:nil block:block];
+    observation.coalescing = coalescing;
+    [observation register];
+    return observation;
+}
+
+- (PAN_nullable PANNotificationObservation *)pan_observeForNotifications:(id)object named:(NSString *)name onGCDQueue:(dispatch_queue_t)cgdQueue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANObservationBlock)block
+{
+    PANNotificationObservation *observation = [[PANNotificationObservation alloc] initWithObserver:self object:object name:name queue:nil gcdQueue:cgdQueue block:block];
+    observation.coalescing = coalescing;
+    [observation register];
+    return observation;
+}
+
 
 - (BOOL)pan_stopObservingForNotifications:(id)object named:(NSString *)name
 {
@@ -144,6 +161,22 @@ PAN_ASSUME_NONNULL_BEGIN
     return observation;
 }
 
+- (PAN_nullable PANNotificationObservation *)pan_observeAllNotificationsNamed:(NSString *)name onQueue:(NSOperationQueue *)queue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANObservationBlock)block
+{
+    PANNotificationObservation *observation = [[PANNotificationObservation alloc] initWithObserver:self object:nil name:name queue:queue gcdQueue:nil block:block];
+    observation.coalescing = coalescing;
+    [observation register];
+    return observation;
+}
+
+- (PAN_nullable PANNotificationObservation *)pan_observeAllNotificationsNamed:(NSString *)name onGCDQueue:(dispatch_queue_t)cgdQueue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANObservationBlock)block
+{
+    PANNotificationObservation *observation = [[PANNotificationObservation alloc] initWithObserver:self object:nil name:name queue:nil gcdQueue:cgdQueue block:block];
+    observation.coalescing = coalescing;
+    [observation register];
+    return observation;
+}
+
 
 - (BOOL)pan_stopObservingAllNotificationsNamed:(NSString *)name
 {
@@ -223,6 +256,22 @@ PAN_ASSUME_NONNULL_BEGIN
     return observation;
 }
 
+- (PAN_nullable PANNotificationObservation *)pan_observeNotificationsNamed:(NSString *)name onQueue:(NSOperationQueue *)queue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANAnonymousObservationBlock)block
+{
+    PANNotificationObservation *observation = [[PANNotificationObservation alloc] initWithObject:self name:name queue:queue gcdQueue:nil block:block];
+    observation.coalescing = coalescing;
+    [observation register];
+    return observation;
+}
+
+- (PAN_nullable PANNotificationObservation *)pan_observeNotificationsNamed:(NSString *)name onGCDQueue:(dispatch_queue_t)cgdQueue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANAnonymousObservationBlock)block
+{
+    PANNotificationObservation *observation = [[PANNotificationObservation alloc] initWithObject:self name:name queue:nil gcdQueue:cgdQueue block:block];
+    observation.coalescing = coalescing;
+    [observation register];
+    return observation;
+}
+
 
 - (BOOL)pan_stopObservingNotificationsNamed:(NSString *)name
 {
@@ -303,6 +352,22 @@ PAN_ASSUME_NONNULL_BEGIN
     return observation;
 }
 
+- (PAN_nullable PANNotificationObservation *)pan_observeOwnNotificationsNamed:(NSString *)name onQueue:(NSOperationQueue *)queue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANObservationBlock)block
+{
+    PANNotificationObservation *observation = [[PANNotificationObservation alloc] initWithObserver:self object:self name:name queue:queue gcdQueue:nil block:block];
+    observation.coalescing = coalescing;
+    [observation register];
+    return observation;
+}
+
+- (PAN_nullable PANNotificationObservation *)pan_observeOwnNotificationsNamed:(NSString *)name onGCDQueue:(dispatch_queue_t)cgdQueue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANObservationBlock)block
+{
+    PANNotificationObservation *observation = [[PANNotificationObservation alloc] initWithObserver:self object:self name:name queue:nil gcdQueue:cgdQueue block:block];
+    observation.coalescing = coalescing;
+    [observation register];
+    return observation;
+}
+
 
 - (BOOL)pan_stopObservingOwnNotificationsNamed:(NSString *)name
 {
@@ -336,12 +401,14 @@ PAN_ASSUME_NONNULL_BEGIN
 
 - (void)pan_postNotificationNamed:(NSString *)name
 {
-    [[NSNotificationCenter defaultCenter] postNotificationName:name object:self userInfo:nil];
+    if (![[PANNotificationHub defaultHub] postNotificationName:name object:self userInfo:nil])
+        [[NSNotificationCenter defaultCenter] postNotificationName:name object:self userInfo:nil];
 }
 
 - (void)pan_postNotificationNamed:(NSString *)name userInfo:(PAN_nullable NSDictionary *)userInfo
 {
-    [[NSNotificationCenter defaultCenter] postNotificationName:name object:self userInfo:userInfo];
+    if (![[PANNotificationHub defaultHub] postNotificationName:name object:self userInfo:userInfo])
+        [[NSNotificationCenter defaultCenter] postNotificationName:name object:self userInfo:userInfo];
 }
 
 @end
@@ -0,0 +1,60 @@
+//
+//  PANNotificationDispatcher.h
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-30.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+//  Shares NSNotificationCenter registrations among PANNotificationObservations. There's one block registration
+//  with the default center per notification name, whatever the number of observations of that name or the objects
+//  they're restricted to, and it fans each posted notification out to them from its own lists: the observations
+//  of any object, and those of the posting object found by pointer. The lists are immutable snapshots replaced
+//  whenever an observation is added or removed, so posting threads read them without taking a lock.
+//
+//  The token returned by the center is kept and used to remove exactly that registration once the last
+//  observation of the name is removed, so registrations never pile up in the center.
+//
+//  Notifications are passed to `-[PANNotificationObservation observeNotification:]` on the posting thread.
+
+#import <Foundation/Foundation.h>
+#import "PANDefines.h"
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+@class PANNotificationObservation;
+
+@interface PANNotificationDispatcher : NSObject
+
+/**
+ *  The dispatcher for the default notification center.
+ */
++ (instancetype)sharedDispatcher;
+
+/**
+ *  Start passing notifications of the observation's name to it, registering with the notification center if it's
+ *  the first observation of that name.
+ *
+ *  @param observation A notification observation.
+ *  @param object      The object whose notifications to pass, `nil` for any object. Not retained.
+ */
+- (void)addObservation:(PANNotificationObservation *)observation object:(PAN_nullable id)object;
+
+/**
+ *  Stop passing notifications to the observation, removing the notification center registration if it was the
+ *  last observation of its name. Doesn't message the object, so is safe while it's deallocating.
+ *
+ *  @param observation An observation previously added.
+ *  @param object      The object it was added with.
+ */
+- (void)removeObservation:(PANNotificationObservation *)observation object:(PAN_nullable id)object;
+
+/**
+ *  The number of notification names with a registration in the notification center.
+ */
+@property (nonatomic, readonly) NSUInteger registeredNameCount;
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
@@ -0,0 +1,191 @@
+//
+//  PANNotificationDispatcher.m
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-30.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANNotificationDispatcher.h"
+#import "PANNotificationObservation.h"
+#import "PANNotificationObservation+Private.h"
+#import "PANNotificationHub+Private.h"
+#import <stdatomic.h>
+#import <pthread.h>
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+// the observers of one notification name. posting threads don't take the dispatcher's lock, like the hub they're
+// counted while loading the subscribers and retain them before they stop being counted, and the subscribers a
+// change replaces are retired until a writer or the last reader out sees none counted
+@interface PANNotificationDispatchEntry : NSObject
+{
+    @public
+    id _token; // returned by the notification center, removes exactly this registration
+    void * _Atomic _subscribers; // +1 PANNotificationHubSubscribers, replaced whenever an observation is added or removed
+    atomic_uint _readers;
+    atomic_bool _hasRetired; // so readers can tell without the lock if there's anything to release
+    CFMutableArrayRef _retired; // guarded by the dispatcher's lock
+    NSUInteger _count; // guarded by the dispatcher's lock
+}
+@end
+
+@implementation PANNotificationDispatchEntry
+
+- (instancetype)init
+{
+    if (!(self = [super init]))
+        return nil;
+    atomic_init(&_subscribers, (void *)CFBridgingRetain([PANNotificationHubSubscribers emptySubscribers]));
+    atomic_init(&_readers, 0);
+    atomic_init(&_hasRetired, false);
+    _retired = CFArrayCreateMutable(NULL, 0, &kCFTypeArrayCallBacks);
+    return self;
+}
+
+- (void)dealloc
+{
+    CFRelease(atomic_load(&_subscribers));
+    CFRelease(_retired);
+}
+
+@end
+
+
+#pragma mark -
+
+@implementation PANNotificationDispatcher
+{
+    pthread_mutex_t _lock;
+    NSMutableDictionary *_entries; // name -> PANNotificationDispatchEntry, guarded by _lock
+}
+
++ (instancetype)sharedDispatcher
+{
+    static PANNotificationDispatcher *sharedDispatcher;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedDispatcher = [[self alloc] init];
+    });
+    return sharedDispatcher;
+}
+
+- (instancetype)init
+{
+    if (!(self = [super init]))
+        return nil;
+    pthread_mutex_init(&_lock, NULL);
+    _entries = [NSMutableDictionary dictionary];
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_lock);
+}
+
+- (void)addObservation:(PANNotificationObservation *)observation object:(PAN_nullable id)object
+{
+    NSString *name = observation.name;
+
+    pthread_mutex_lock(&_lock);
+
+    PANNotificationDispatchEntry *entry = _entries[name];
+    if (entry == nil) {
+        entry = [[PANNotificationDispatchEntry alloc] init];
+        _entries[name] = entry;
+        // the center retains the block which retains the entry, until the token is removed
+        entry->_token = [[NSNotificationCenter defaultCenter] addObserverForName:name object:nil queue:nil usingBlock:^(NSNotification *notification) {
+            [self dispatchNotification:notification withEntry:entry];
+        }];
+    }
+
+    CFTypeRef subscribers = atomic_load(&entry->_subscribers);
+    [self publishSubscribers:[(__bridge PANNotificationHubSubscribers *)subscribers subscribersByAdding:observation object:object] replacing:subscribers ofEntry:entry];
+    entry->_count++;
+
+    [self unlockReleasingRetiredOfEntry:entry];
+}
+
+- (void)removeObservation:(PANNotificationObservation *)observation object:(PAN_nullable id)object
+{
+    NSString *name = observation.name;
+    id token = nil;
+
+    pthread_mutex_lock(&_lock);
+
+    PANNotificationDispatchEntry *entry = _entries[name];
+    CFTypeRef subscribers = entry != nil ? atomic_load(&entry->_subscribers) : NULL;
+    PANNotificationHubSubscribers *newSubscribers = subscribers != NULL ? [(__bridge PANNotificationHubSubscribers *)subscribers subscribersByRemoving:observation object:object] : nil;
+    if (newSubscribers != nil) {
+        [self publishSubscribers:newSubscribers replacing:subscribers ofEntry:entry];
+        if (--entry->_count == 0) {
+            token = entry->_token;
+            entry->_token = nil;
+            [_entries removeObjectForKey:name];
+        }
+    }
+
+    [self unlockReleasingRetiredOfEntry:entry];
+
+    // outside the lock, the center may be waiting on it while a notification of this name is being dispatched
+    if (token != nil)
+        [[NSNotificationCenter defaultCenter] removeObserver:token];
+}
+
+// called with _lock held
+- (void)publishSubscribers:(PANNotificationHubSubscribers *)subscribers replacing:(CFTypeRef)replaced ofEntry:(PANNotificationDispatchEntry *)entry
+{
+    atomic_store(&entry->_subscribers, (void *)CFBridgingRetain(subscribers));
+    CFArrayAppendValue(entry->_retired, replaced);
+    CFRelease(replaced); // the published reference, the retired array has its own
+    atomic_store(&entry->_hasRetired, true);
+}
+
+// unlocks _lock, releasing the entry's retired subscribers if no reader can still be using them. they're released
+// after unlocking, since releasing an observation can lead back to the dispatcher
+- (void)unlockReleasingRetiredOfEntry:(PAN_nullable PANNotificationDispatchEntry *)entry
+{
+    CFMutableArrayRef retired = NULL;
+    if (entry != nil && atomic_load(&entry->_hasRetired) && atomic_load(&entry->_readers) == 0) {
+        retired = entry->_retired;
+        entry->_retired = CFArrayCreateMutable(NULL, 0, &kCFTypeArrayCallBacks);
+        atomic_store(&entry->_hasRetired, false);
+    }
+    pthread_mutex_unlock(&_lock);
+    if (retired != NULL)
+        CFRelease(retired);
+}
+
+- (void)dispatchNotification:(NSNotification *)notification withEntry:(PANNotificationDispatchEntry *)entry
+{
+    id object = notification.object;
+
+    // retained, so the observations are passed the notification after this thread stops being counted as a reader
+    atomic_fetch_add(&entry->_readers, 1);
+    PANNotificationHubSubscribers *subscribers = (__bridge PANNotificationHubSubscribers *)atomic_load(&entry->_subscribers);
+    // the last reader out releases what was retired meanwhile, unless a writer has the lock, then whichever of the
+    // writer or a later reader next sees no readers does
+    if (atomic_fetch_sub(&entry->_readers, 1) == 1 && atomic_load(&entry->_hasRetired) && pthread_mutex_trylock(&_lock) == 0)
+        [self unlockReleasingRetiredOfEntry:entry];
+
+    NSArray * __unsafe_unretained objectObservations = object != nil ? (__bridge NSArray *)CFDictionaryGetValue(subscribers->_observationsByObject, (__bridge const void *)object) : nil;
+    for (PANNotificationObservation *observation in subscribers->_anyObjectObservations)
+        [observation observeNotification:notification];
+    for (PANNotificationObservation *observation in objectObservations)
+        [observation observeNotification:notification];
+}
+
+- (NSUInteger)registeredNameCount
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _entries.count;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
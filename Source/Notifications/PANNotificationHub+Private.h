@@ -0,0 +1,73 @@
+//
+//  PANNotificationHub+Private.h
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-30.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANNotificationHub.h"
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+@class PANNotificationObservation;
+
+/**
+ *  The observations of a notification name at one moment, never changed once published so they can be read without
+ *  a lock. Also used by `PANNotificationDispatcher`.
+ */
+@interface PANNotificationHubSubscribers : NSObject
+{
+    @public
+    NSArray *_anyObjectObservations;
+    CFDictionaryRef _observationsByObject; // object pointer -> NSArray, not retaining the objects
+}
+
+/**
+ *  Subscribers with no observations.
+ */
++ (instancetype)emptySubscribers;
+
+/**
+ *  A copy with the observation added.
+ *
+ *  @param observation A notification observation.
+ *  @param object      The object whose notifications it's restricted to, `nil` for any object. Not retained.
+ */
+- (PANNotificationHubSubscribers *)subscribersByAdding:(PANNotificationObservation *)observation object:(PAN_nullable id)object;
+
+/**
+ *  A copy with the observation removed, or `nil` if it isn't among these.
+ *
+ *  @param observation A notification observation.
+ *  @param object      The object it was added with.
+ */
+- (PAN_nullable PANNotificationHubSubscribers *)subscribersByRemoving:(PANNotificationObservation *)observation object:(PAN_nullable id)object;
+
+@end
+
+@interface PANNotificationHub (Private)
+
+/**
+ *  Start posting notifications of the observation's name to it, if that name is registered.
+ *
+ *  @param observation A notification observation.
+ *  @param object      The object whose notifications to post to it, `nil` for any object. Not retained.
+ *
+ *  @return `YES` if the name is registered and the observation added, `NO` otherwise.
+ */
+- (BOOL)addObservation:(PANNotificationObservation *)observation object:(PAN_nullable id)object;
+
+/**
+ *  Stop posting notifications to the observation. Doesn't message the object, so is safe while it's deallocating.
+ *
+ *  @param observation An observation previously added.
+ *  @param object      The object it was added with.
+ */
+- (void)removeObservation:(PANNotificationObservation *)observation object:(PAN_nullable id)object;
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
@@ -0,0 +1,82 @@
+//
+//  PANNotificationHub.h
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-30.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "PANDefines.h"
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+/**
+ *  An in-process alternative to `NSNotificationCenter` for the hottest notification names, posting directly to the
+ *  `PANNotificationObservation` objects observing them.
+ *
+ *  Names are registered with the hub once, after which observations of the name made by the usual
+ *  `pan_observe...Notifications...` methods are kept by the hub instead of the notification center, and
+ *  `pan_postNotificationNamed:` and `+[Panopticon postNotificationNamed:]` post through it. A notification of a
+ *  registered name posted to `NSNotificationCenter` directly doesn't reach those observations.
+ *
+ *  Names are kept in shards by hash, each with a table replaced as a whole when a name is added and with each
+ *  name's observations replaced as a whole when one is added or removed, so posting reads them without taking a
+ *  lock. Posting with `postNotificationName:object:userInfo:` doesn't create an `NSNotification`, one is only made
+ *  if an observation block reads the `notification` property.
+ */
+@interface PANNotificationHub : NSObject
+
+/**
+ *  The hub used by notification observations.
+ */
++ (instancetype)defaultHub;
+
+/**
+ *  Have notifications of the name go through the hub rather than `NSNotificationCenter`. Must be called before
+ *  any observations of the name are made, those made earlier stay with the notification center. Registering a name
+ *  again has no effect, names can't be unregistered.
+ *
+ *  @param name A notification name.
+ *
+ *  @return The name as interned by the hub, the one instance of the string it uses. Posting with this instance
+ *          instead of an equal string saves comparing characters when looking it up.
+ */
+- (NSString *)registerName:(NSString *)name;
+
+/**
+ *  Return if a name has been registered with the hub.
+ *
+ *  @param name A notification name.
+ *
+ *  @return `YES` if the name is registered.
+ */
+- (BOOL)isRegisteredName:(NSString *)name;
+
+/**
+ *  Post a notification to the hub's observations of the name that observe any object or the given one, without
+ *  creating an `NSNotification` unless an observation asks for it. Observations without a queue are called before
+ *  this returns, like `NSNotificationCenter`.
+ *
+ *  @param name     A registered notification name.
+ *  @param object   The posting object, or `nil`.
+ *  @param userInfo The user info dictionary, or `nil`.
+ *
+ *  @return `YES` if the name was registered and the notification posted, `NO` if it isn't registered.
+ */
+- (BOOL)postNotificationName:(NSString *)name object:(PAN_nullable id)object userInfo:(PAN_nullable NSDictionary *)userInfo;
+
+/**
+ *  Post an existing notification, as for `postNotificationName:object:userInfo:`.
+ *
+ *  @param notification A notification whose name is registered.
+ *
+ *  @return `YES` if the name was registered and the notification posted, `NO` if it isn't registered.
+ */
+- (BOOL)postNotification:(NSNotification *)notification;
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
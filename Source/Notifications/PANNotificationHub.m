@@ -0,0 +1,313 @@
+//
+//  PANNotificationHub.m
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-30.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANNotificationHub.h"
+#import "PANNotificationHub+Private.h"
+#import "PANNotificationObservation.h"
+#import "PANNotificationObservation+Private.h"
+#import <stdatomic.h>
+#import <pthread.h>
+
+
+#define PANNotificationHubShardCount 16 // a power of 2
+
+// readers never take the write lock, instead they're counted while loading from the shard, retaining what they need
+// before they stop being counted. anything a writer replaces is retired rather than released, and the retired
+// objects are released by a writer that sees no readers, or by the last reader to leave. a reader counted after
+// that check loads the replacements, so never what's being released
+typedef struct PANNotificationHubShard {
+    pthread_mutex_t writeLock;
+    void * _Atomic table; // +1 CFDictionaryRef, name -> PANNotificationHubEntry, replaced whenever a name is added
+    atomic_uint readers;
+    atomic_bool hasRetired; // so readers can tell without the lock if there's anything to release
+    CFMutableArrayRef retired; // guarded by writeLock
+} PANNotificationHubShard;
+
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+@implementation PANNotificationHubSubscribers
+
++ (instancetype)emptySubscribers
+{
+    PANNotificationHubSubscribers *subscribers = [[self alloc] init];
+    subscribers->_anyObjectObservations = @[];
+    subscribers->_observationsByObject = CFDictionaryCreate(NULL, NULL, NULL, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+    return subscribers;
+}
+
+- (void)dealloc
+{
+    CFRelease(_observationsByObject);
+}
+
+- (PANNotificationHubSubscribers *)subscribersByAdding:(PANNotificationObservation *)observation object:(PAN_nullable id)object
+{
+    PANNotificationHubSubscribers *subscribers = [[PANNotificationHubSubscribers alloc] init];
+    if (object == nil) {
+        subscribers->_anyObjectObservations = [_anyObjectObservations arrayByAddingObject:observation];
+        subscribers->_observationsByObject = CFRetain(_observationsByObject);
+    }
+    else {
+        subscribers->_anyObjectObservations = _anyObjectObservations;
+        CFMutableDictionaryRef observationsByObject = CFDictionaryCreateMutableCopy(NULL, 0, _observationsByObject);
+        NSArray *objectObservations = (__bridge NSArray *)CFDictionaryGetValue(observationsByObject, (__bridge const void *)object);
+        objectObservations = objectObservations != nil ? [objectObservations arrayByAddingObject:observation] : @[observation];
+        CFDictionarySetValue(observationsByObject, (__bridge const void *)object, (__bridge const void *)objectObservations);
+        subscribers->_observationsByObject = observationsByObject;
+    }
+    return subscribers;
+}
+
+- (PAN_nullable PANNotificationHubSubscribers *)subscribersByRemoving:(PANNotificationObservation *)observation object:(PAN_nullable id)object
+{
+    NSArray *observations = object == nil ? _anyObjectObservations : (__bridge NSArray *)CFDictionaryGetValue(_observationsByObject, (__bridge const void *)object);
+    NSUInteger index = observations != nil ? [observations indexOfObjectIdenticalTo:observation] : NSNotFound;
+    if (index == NSNotFound)
+        return nil;
+    NSMutableArray *remaining = [observations mutableCopy];
+    [remaining removeObjectAtIndex:index];
+
+    PANNotificationHubSubscribers *subscribers = [[PANNotificationHubSubscribers alloc] init];
+    if (object == nil) {
+        subscribers->_anyObjectObservations = [remaining copy];
+        subscribers->_observationsByObject = CFRetain(_observationsByObject);
+    }
+    else {
+        subscribers->_anyObjectObservations = _anyObjectObservations;
+        CFMutableDictionaryRef observationsByObject = CFDictionaryCreateMutableCopy(NULL, 0, _observationsByObject);
+        if (remaining.count == 0)
+            CFDictionaryRemoveValue(observationsByObject, (__bridge const void *)object);
+        else
+            CFDictionarySetValue(observationsByObject, (__bridge const void *)object, (__bridge const void *)[remaining copy]);
+        subscribers->_observationsByObject = observationsByObject;
+    }
+    return subscribers;
+}
+
+@end
+
+
+// a registered name, once added to its shard's table it's in every later table too
+@interface PANNotificationHubEntry : NSObject
+{
+    @public
+    NSString *_name; // the interned instance
+    void * _Atomic _subscribers; // +1 PANNotificationHubSubscribers, replaced whenever an observation is added or removed
+}
+@end
+
+@implementation PANNotificationHubEntry
+
+- (void)dealloc
+{
+    CFRelease(atomic_load(&_subscribers));
+}
+
+@end
+
+
+static inline PANNotificationHubShard *PANNotificationHubShardOfName(PANNotificationHubShard *shards, NSString *name)
+{
+    NSUInteger hash = name.hash;
+    return &shards[(hash ^ (hash >> 16)) & (PANNotificationHubShardCount - 1)];
+}
+
+// unlocks the shard's writeLock, releasing the retired objects if no reader can still be using them. they're released
+// after unlocking, since releasing an observation can lead back to the hub
+static void PANNotificationHubUnlock(PANNotificationHubShard *shard)
+{
+    CFMutableArrayRef retired = NULL;
+    if (atomic_load(&shard->hasRetired) && atomic_load(&shard->readers) == 0) {
+        retired = shard->retired;
+        shard->retired = CFArrayCreateMutable(NULL, 0, &kCFTypeArrayCallBacks);
+        atomic_store(&shard->hasRetired, false);
+    }
+    pthread_mutex_unlock(&shard->writeLock);
+    if (retired != NULL)
+        CFRelease(retired);
+}
+
+static inline void PANNotificationHubBeginRead(PANNotificationHubShard *shard)
+{
+    atomic_fetch_add(&shard->readers, 1);
+}
+
+static inline void PANNotificationHubEndRead(PANNotificationHubShard *shard)
+{
+    // the last reader out releases what was retired meanwhile, unless a writer has the lock, then whichever of the
+    // writer or a later reader next sees no readers does
+    if (atomic_fetch_sub(&shard->readers, 1) != 1 || !atomic_load(&shard->hasRetired))
+        return;
+    if (pthread_mutex_trylock(&shard->writeLock) == 0)
+        PANNotificationHubUnlock(shard);
+}
+
+// called with the shard's writeLock held, after publishing the replacement
+static void PANNotificationHubRetire(PANNotificationHubShard *shard, CFTypeRef replaced)
+{
+    CFArrayAppendValue(shard->retired, replaced);
+    CFRelease(replaced); // the published reference, the retired array has its own
+    atomic_store(&shard->hasRetired, true);
+}
+
+
+#pragma mark -
+
+@implementation PANNotificationHub
+{
+    PANNotificationHubShard _shards[PANNotificationHubShardCount];
+}
+
++ (instancetype)defaultHub
+{
+    static PANNotificationHub *defaultHub;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        defaultHub = [[self alloc] init];
+    });
+    return defaultHub;
+}
+
+- (instancetype)init
+{
+    if (!(self = [super init]))
+        return nil;
+    for (NSUInteger i = 0; i < PANNotificationHubShardCount; i++) {
+        PANNotificationHubShard *shard = &_shards[i];
+        pthread_mutex_init(&shard->writeLock, NULL);
+        atomic_init(&shard->table, (void *)CFDictionaryCreate(NULL, NULL, NULL, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks));
+        atomic_init(&shard->readers, 0);
+        atomic_init(&shard->hasRetired, false);
+        shard->retired = CFArrayCreateMutable(NULL, 0, &kCFTypeArrayCallBacks);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    for (NSUInteger i = 0; i < PANNotificationHubShardCount; i++) {
+        PANNotificationHubShard *shard = &_shards[i];
+        CFRelease(atomic_load(&shard->table));
+        CFRelease(shard->retired);
+        pthread_mutex_destroy(&shard->writeLock);
+    }
+}
+
+// called with the shard's writeLock held, or while counted as reading it. returned unretained, as a pointer so ARC
+// doesn't retain it on the way out
+static inline const void *PANNotificationHubEntryOfName(PANNotificationHubShard *shard, NSString *name)
+{
+    CFDictionaryRef table = atomic_load(&shard->table);
+    return CFDictionaryGetValue(table, (__bridge const void *)name);
+}
+
+- (NSString *)registerName:(NSString *)name
+{
+    PANNotificationHubShard *shard = PANNotificationHubShardOfName(_shards, name);
+    pthread_mutex_lock(&shard->writeLock);
+
+    PANNotificationHubEntry *entry = (__bridge PANNotificationHubEntry *)PANNotificationHubEntryOfName(shard, name);
+    if (entry == nil) {
+        entry = [[PANNotificationHubEntry alloc] init];
+        entry->_name = [name copy];
+        atomic_init(&entry->_subscribers, (void *)CFBridgingRetain([PANNotificationHubSubscribers emptySubscribers]));
+
+        CFDictionaryRef table = atomic_load(&shard->table);
+        CFMutableDictionaryRef newTable = CFDictionaryCreateMutableCopy(NULL, 0, table);
+        CFDictionarySetValue(newTable, (__bridge const void *)entry->_name, (__bridge const void *)entry);
+        atomic_store(&shard->table, (void *)newTable);
+        PANNotificationHubRetire(shard, table);
+    }
+    NSString *internedName = entry->_name;
+
+    PANNotificationHubUnlock(shard);
+    return internedName;
+}
+
+- (BOOL)isRegisteredName:(NSString *)name
+{
+    PANNotificationHubShard *shard = PANNotificationHubShardOfName(_shards, name);
+    PANNotificationHubBeginRead(shard);
+    BOOL registered = PANNotificationHubEntryOfName(shard, name) != NULL;
+    PANNotificationHubEndRead(shard);
+    return registered;
+}
+
+- (BOOL)addObservation:(PANNotificationObservation *)observation object:(PAN_nullable id)object
+{
+    return [self updateObservationsOfName:observation.name withBlock:^PANNotificationHubSubscribers *(PANNotificationHubSubscribers *subscribers) {
+        return [subscribers subscribersByAdding:observation object:object];
+    }];
+}
+
+- (void)removeObservation:(PANNotificationObservation *)observation object:(PAN_nullable id)object
+{
+    [self updateObservationsOfName:observation.name withBlock:^PANNotificationHubSubscribers *(PANNotificationHubSubscribers *subscribers) {
+        return [subscribers subscribersByRemoving:observation object:object];
+    }];
+}
+
+// the block returns the replacement subscribers, or nil to leave them as they are
+- (BOOL)updateObservationsOfName:(NSString *)name withBlock:(PANNotificationHubSubscribers * (^)(PANNotificationHubSubscribers *subscribers))block
+{
+    PANNotificationHubShard *shard = PANNotificationHubShardOfName(_shards, name);
+    pthread_mutex_lock(&shard->writeLock);
+
+    PANNotificationHubEntry *entry = (__bridge PANNotificationHubEntry *)PANNotificationHubEntryOfName(shard, name);
+    if (entry != nil) {
+        CFTypeRef subscribers = atomic_load(&entry->_subscribers);
+        PANNotificationHubSubscribers *newSubscribers = block((__bridge PANNotificationHubSubscribers *)subscribers);
+        if (newSubscribers != nil) {
+            atomic_store(&entry->_subscribers, (void *)CFBridgingRetain(newSubscribers));
+            PANNotificationHubRetire(shard, subscribers);
+        }
+    }
+
+    PANNotificationHubUnlock(shard);
+    return entry != nil;
+}
+
+- (BOOL)postNotificationName:(NSString *)name object:(PAN_nullable id)object userInfo:(PAN_nullable NSDictionary *)userInfo
+{
+    return [self postName:name object:object userInfo:userInfo notification:nil];
+}
+
+- (BOOL)postNotification:(NSNotification *)notification
+{
+    return [self postName:notification.name object:notification.object userInfo:notification.userInfo notification:notification];
+}
+
+- (BOOL)postName:(NSString *)name object:(PAN_nullable id)object userInfo:(PAN_nullable NSDictionary *)userInfo notification:(PAN_nullable NSNotification *)notification
+{
+    PANNotificationHubShard *shard = PANNotificationHubShardOfName(_shards, name);
+    PANNotificationHubBeginRead(shard);
+
+    // an entry stays in every later table once added so is never released, the subscribers are retained so the
+    // observation blocks run after this thread stops being counted as a reader, keeping it from holding up the
+    // release of what's retired meanwhile
+    PANNotificationHubEntry * __unsafe_unretained entry = (__bridge PANNotificationHubEntry *)PANNotificationHubEntryOfName(shard, name);
+    PANNotificationHubSubscribers *subscribers = entry != nil ? (__bridge PANNotificationHubSubscribers *)atomic_load(&entry->_subscribers) : nil;
+
+    PANNotificationHubEndRead(shard);
+    if (entry == nil)
+        return NO;
+
+    NSArray * __unsafe_unretained objectObservations = object != nil ? (__bridge NSArray *)CFDictionaryGetValue(subscribers->_observationsByObject, (__bridge const void *)object) : nil;
+    for (PANNotificationObservation *observation in subscribers->_anyObjectObservations)
+        [observation observeNotificationNamed:entry->_name object:object userInfo:userInfo notification:notification];
+    for (PANNotificationObservation *observation in objectObservations)
+        [observation observeNotificationNamed:entry->_name object:object userInfo:userInfo notification:notification];
+    return YES;
+}
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
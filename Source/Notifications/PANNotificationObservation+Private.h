@@ -21,6 +21,12 @@ PAN_ASSUME_NONNULL_BEGIN
 
 + (PAN_nullable PANNotificationObservation *)findObservationForObserver:(PAN_nullable id)observer object:(PAN_nullable id)object name:(NSString *)name;
 
+// called by PANNotificationDispatcher on the posting thread
+- (void)observeNotification:(NSNotification *)nsnotification;
+
+// called by PANNotificationHub on the posting thread, the notification is nil unless one was posted
+- (void)observeNotificationNamed:(NSString *)name object:(PAN_nullable id)object userInfo:(PAN_nullable NSDictionary *)userInfo notification:(PAN_nullable NSNotification *)nsnotification;
+
 @end
 
 
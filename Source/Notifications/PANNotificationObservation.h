@@ -11,6 +11,20 @@
 PAN_ASSUME_NONNULL_BEGIN
 
 
+/**
+ *  Which notifications posted while an earlier one is still waiting for delivery on the observation's queue are
+ *  merged into it.
+ */
+typedef NS_ENUM(NSInteger, PANNotificationCoalescing) {
+    /** Every notification is delivered. The default. */
+    PANNotificationCoalescingNone = 0,
+    /** Merge a notification into a waiting one regardless of the posting objects. */
+    PANNotificationCoalescingByName,
+    /** Merge a notification into a waiting one posted by the same object. */
+    PANNotificationCoalescingByNameAndObject
+};
+
+
 /**
  *  A protocol for providing the data generated from a notification. `PANNotificationObservation` confirms to
  *  this protocol and so has all these properties, plus notably `object` and `timestamp` from the parent
@@ -20,6 +34,7 @@ PAN_ASSUME_NONNULL_BEGIN
 
 /**
  *  A notification that triggered an observation. Value undefined except within call to an observation block.
+ *  For a notification posted through `PANNotificationHub` by name, it's only made when first read.
  */
 @property (nonatomic, readonly) NSNotification *notification;
 
@@ -29,6 +44,12 @@ PAN_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic, readonly, PAN_nullable) NSDictionary *userInfo;
 
+/**
+ *  The number of earlier notifications merged into this one by `coalescing`, whose values were replaced by those
+ *  of the latest. 0 when none were. Value undefined except within call to an observation block.
+ */
+@property (nonatomic, readonly) NSUInteger coalescedCount;
+
 @end
 
 
@@ -52,6 +73,9 @@ PAN_ASSUME_NONNULL_BEGIN
  *  The observation object is passed as a parameter to the observation block, and has properties defined by
  *  `PANNotification` for accessing the name, notification object, or its specific values directly, the posted object
  *  and user info dictionary.
+ *
+ *  Observations of a name registered with `PANNotificationHub` are kept by the hub, others by the default
+ *  `NSNotificationCenter`.
  */
 @interface PANNotificationObservation : PANObservation <PANNotification>
 
@@ -60,6 +84,15 @@ PAN_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic, readonly, copy) NSString *name;
 
+/**
+ *  Whether notifications posted before an earlier one has been delivered on `queue` or `gcdQueue` are merged into
+ *  it, delivering the latest `object`, `userInfo` and `notification` once with `coalescedCount` giving how many
+ *  were merged. The merge happens on the posting thread, so nothing is queued for a merged notification. Also
+ *  merges consecutive notifications the same way while paused or suspended and within batches. Has no effect on
+ *  notifications delivered synchronously. Default is `PANNotificationCoalescingNone`.
+ */
+@property (nonatomic) PANNotificationCoalescing coalescing;
+
 /**
  *  Remove an observer with matching parameters. Can use this class method to look-up a previously registered
  *  observation and remove it, although usually more convenient to use the 'pan_stopObserving' methods, or save the
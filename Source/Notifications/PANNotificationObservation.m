@@ -9,6 +9,8 @@
 #import "PANNotificationObservation.h"
 #import "PANNotificationObservation+Private.h"
 #import "PANObservation+Private.h"
+#import "PANNotificationDispatcher.h"
+#import "PANNotificationHub+Private.h"
 
 PAN_ASSUME_NONNULL_BEGIN
 
@@ -16,10 +18,14 @@ PAN_ASSUME_NONNULL_BEGIN
 @protocol PANMutableNotification <PANNotification, PANMutableDetectedObservation>
 @property (nonatomic, readwrite) NSNotification *notification;
 @property (nonatomic, readwrite, PAN_nullable) NSDictionary *userInfo;
+@property (nonatomic, readwrite, PAN_nullable) NSString *notificationName; // of a hub post without a notification, to make one if read
+@property (nonatomic, readwrite) NSUInteger coalescedCount;
 @end
 
 @interface PANNotificationObservation () <PANMutableNotification>
 @property (nonatomic, readwrite, copy) NSString *name;
+@property (nonatomic, unsafe_unretained, PAN_nullable) id registeredObject; // object can't be read weakly once its dealloc has begun
+@property (nonatomic, PAN_nullable) PANNotificationHub *registeredHub; // if its name is one of the hub's
 @end
 
 @interface PANNotification () <PANMutableNotification>
@@ -27,12 +33,28 @@ PAN_ASSUME_NONNULL_BEGIN
 
 
 
+#pragma mark -
+
+// make the notification of a hub post when first asked for it
+static inline NSNotification *PANMakeNotificationIfNeeded(__strong NSNotification **notification, NSString *name, id object, NSDictionary *userInfo)
+{
+    if (*notification == nil && name != nil)
+        *notification = [NSNotification notificationWithName:name object:object userInfo:userInfo];
+    return *notification;
+}
+
+// the coalescing key of notifications from any object, and of those without an object
+static const char PANCoalescingAnyObjectKey = 0;
+
+
 #pragma mark -
 
 @implementation PANNotificationObservation
 
-@synthesize notification;
+@synthesize notification = _notification;
 @synthesize userInfo;
+@synthesize notificationName;
+@synthesize coalescedCount;
 
 - (instancetype)initWithObserver:(PAN_nullable id)observer object:(PAN_nullable id)object name:(NSString *)name queue:(PAN_nullable NSOperationQueue *)queue gcdQueue:(PAN_nullable dispatch_queue_t)gcdQueue block:(PANObservationBlock)block;
 {
@@ -54,49 +76,117 @@ PAN_ASSUME_NONNULL_BEGIN
 {
     NSAssert1(!self.registered, @"Attempted double-register of %@", self);
     NSAssert1(self.name != nil, @"Nil 'name' property when registering observation for %@", self);
-    typeof(self) __weak welf = self;
-    
-    if (self.queue != nil) {
-        [[NSNotificationCenter defaultCenter] addObserverForName:self.name object:self.object queue:self.queue usingBlock:^(NSNotification *nsnotification) {
-            [welf triggerSynchronously:YES withSetupBlock:^(id<PANDetectedObservation> obs) {
-                if (![obs conformsToProtocol:@protocol(PANMutableNotification)])
-                    return;
-                id<PANMutableNotification> notif = (id<PANMutableNotification>)obs;
-                notif.notification = nsnotification;
-                notif.object = nsnotification.object;
-                notif.payload = notif.userInfo = nsnotification.userInfo;
-            }];
-        }];
+    self.registeredObject = self.observee; // not self.object, that's the object of the last notification received
+    PANNotificationHub *hub = [PANNotificationHub defaultHub];
+    if ([hub addObservation:self object:self.registeredObject]) {
+        self.registeredHub = hub;
+        return;
     }
-    else {
-        [[NSNotificationCenter defaultCenter] addObserverForName:self.name object:self.object queue:nil usingBlock:^(NSNotification *nsnotification) {
-            [welf triggerSynchronously:NO withSetupBlock:^(id<PANDetectedObservation> obs) {
-                if (![obs conformsToProtocol:@protocol(PANMutableNotification)])
-                    return;
-                id<PANMutableNotification> notif = (id<PANMutableNotification>)obs;
-                notif.notification = nsnotification;
-                notif.object = nsnotification.object;
-                notif.payload = notif.userInfo = nsnotification.userInfo;
-            }];
-        }];
+    // rather than a notification center registration each, shares one per name with other observations
+    [[PANNotificationDispatcher sharedDispatcher] addObservation:self object:self.registeredObject];
+}
+
+- (void)observeNotification:(NSNotification *)nsnotification
+{
+    PANObservationEvent event = PANObservationEventMake(nsnotification.object, nsnotification.userInfo, nsnotification);
+    [self triggerEvent:&event synchronously:NO];
+}
+
+- (void)observeNotificationNamed:(NSString *)name object:(PAN_nullable id)object userInfo:(PAN_nullable NSDictionary *)postedUserInfo notification:(PAN_nullable NSNotification *)nsnotification
+{
+    PANObservationEvent event = PANObservationEventMake(object, postedUserInfo, nsnotification);
+    [self triggerEvent:&event synchronously:NO];
+}
+
+- (NSNotification *)notification
+{
+    return PANMakeNotificationIfNeeded(&_notification, self.notificationName, self.object, self.userInfo);
+}
+
+- (void)applyEvent:(const PANObservationEvent *)event toDetectedObservation:(id<PANMutableDetectedObservation>)detectedObservation
+{
+    [super applyEvent:event toDetectedObservation:detectedObservation];
+    if (![detectedObservation conformsToProtocol:@protocol(PANMutableNotification)])
+        return;
+    id<PANMutableNotification> notif = (id<PANMutableNotification>)detectedObservation;
+    notif.notification = event->detail;
+    notif.notificationName = event->detail == nil ? self.name : nil;
+    notif.userInfo = event->payload;
+    notif.coalescedCount = 0;
+}
+
+- (PAN_nullable const void *)queuedCoalescingKeyForEvent:(const PANObservationEvent *)event
+{
+    switch (self.coalescing) {
+        case PANNotificationCoalescingNone:
+            return NULL;
+        case PANNotificationCoalescingByName:
+            return &PANCoalescingAnyObjectKey;
+        case PANNotificationCoalescingByNameAndObject:
+            return event->object != nil ? (__bridge const void *)event->object : &PANCoalescingAnyObjectKey;
     }
 }
 
+- (void)mergeEvent:(const PANObservationEvent *)event intoQueuedDetectedObservation:(PANDetectedObservation *)queuedObservation
+{
+    PANNotification *queued = (PANNotification *)queuedObservation;
+    NSUInteger count = queued.coalescedCount;
+    [super mergeEvent:event intoQueuedDetectedObservation:queued];
+    queued.coalescedCount = count + 1;
+}
+
+- (BOOL)mergeDetectedObservation:(PANDetectedObservation *)detectedObservation intoDetectedObservation:(PANDetectedObservation *)previous
+{
+    if (self.coalescing == PANNotificationCoalescingNone)
+        return NO;
+    if (self.coalescing == PANNotificationCoalescingByNameAndObject && detectedObservation.object != previous.object)
+        return NO;
+    if (![detectedObservation isKindOfClass:[PANNotification class]] || ![previous isKindOfClass:[PANNotification class]])
+        return NO;
+    PANNotification *detected = (PANNotification *)detectedObservation;
+    PANNotification *merged = (PANNotification *)previous;
+    merged.object = detected.object;
+    merged.payload = detected.payload;
+    merged.timestampNanoseconds = detected.timestampNanoseconds;
+    // the notification of a hub post isn't made by merging it
+    merged.notification = detected.notificationName == nil ? detected.notification : nil;
+    merged.notificationName = detected.notificationName;
+    merged.userInfo = detected.userInfo;
+    merged.coalescedCount += detected.coalescedCount + 1;
+    return YES;
+}
+
 - (void)duplicateFrom:(id<PANDetectedObservation>)source
 {
     [super duplicateFrom:source];
     if (![source conformsToProtocol:@protocol(PANNotification)])
         return;
     id<PANNotification> notif = (id<PANNotification>)source;
-    self.notification = notif.notification;
+    // the notification of a hub post isn't made by copying it
+    NSString *sourceNotificationName = [source conformsToProtocol:@protocol(PANMutableNotification)] ? ((id<PANMutableNotification>)source).notificationName : nil;
+    _notification = sourceNotificationName == nil ? notif.notification : nil;
+    self.notificationName = sourceNotificationName;
     self.userInfo = notif.userInfo;
+    self.coalescedCount = notif.coalescedCount;
+}
+
+- (void)configureSnapshot:(PANObservation *)snapshot
+{
+    ((PANNotificationObservation *)snapshot).name = self.name;
+    ((PANNotificationObservation *)snapshot).coalescing = self.coalescing;
+    [super configureSnapshot:snapshot];
 }
 
 - (void)deregisterInternal
 {
     NSAssert1(self.registered, @"Attempted double-removal of %@", self);
     NSAssert1(self.name != nil, @"Nil 'name' property when deregistering observation for %@", self);
-    [[NSNotificationCenter defaultCenter] removeObserver:self name:self.name object:self.object];
+    if (self.registeredHub != nil)
+        [self.registeredHub removeObservation:self object:self.registeredObject];
+    else
+        [[PANNotificationDispatcher sharedDispatcher] removeObservation:self object:self.registeredObject];
+    self.registeredHub = nil;
+    self.registeredObject = nil;
 }
 
 - (PANDetectedObservation *)createDetectedObservation
@@ -118,9 +208,12 @@ PAN_ASSUME_NONNULL_BEGIN
 + (PAN_nullable PANNotificationObservation *)findObservationForObserver:(PAN_nullable id)observer object:(PAN_nullable id)object name:(NSString *)name
 {
     NSParameterAssert(observer != nil || object != nil);
-    return (PANNotificationObservation *)[self findObservationForObserver:observer object:object matchingTest:^BOOL(PANObservation *obs) {
-        return [obs isKindOfClass:[PANNotificationObservation class]] && [((PANNotificationObservation *)obs).name isEqualToString:name];
-    }];
+    return (PANNotificationObservation *)[self findObservationForObserver:observer object:object indexSubkey:name];
+}
+
+- (PAN_nullable id)indexSubkey
+{
+    return self.name;
 }
 
 - (NSString *)description
@@ -135,8 +228,15 @@ PAN_ASSUME_NONNULL_BEGIN
 
 @implementation PANNotification
 
-@synthesize notification;
+@synthesize notification = _notification;
 @synthesize userInfo;
+@synthesize notificationName;
+@synthesize coalescedCount;
+
+- (NSNotification *)notification
+{
+    return PANMakeNotificationIfNeeded(&_notification, self.notificationName, self.object, self.userInfo);
+}
 
 - (NSString *)description
 {
@@ -76,6 +76,26 @@ PAN_ASSUME_NONNULL_BEGIN
 
 + (PAN_nullable PANNotificationObservation *)observeAllNotificationsNamed:(NSString *)name onGCDQueue:(dispatch_queue_t)queue withBlock:(PANAnonymousObservationBlock)block;
 
+/**
+ *  Anonymously observe notifications posted with given name by any observer, calling its block on the given queue and
+ *  merging those posted before an earlier one has been delivered.
+ *
+ *  Variation on `observeAllNotificationsNamed:onQueue:withBlock:` and `observeAllNotificationsNamed:onGCDQueue:withBlock:`
+ *  that adds a coalescing parameter, see `coalescing` in `PANNotificationObservation`. The `coalescedCount` of the
+ *  observation when the block is called gives how many notifications were merged into the one delivered.
+ *
+ *  @param name       The notification name to observe.
+ *  @param queue      The operation queue or CGD dispatch queue on which to call `block`.
+ *  @param coalescing Which notifications to merge into one waiting for delivery.
+ *  @param block      The block to call when observation is triggered, is passed the observation (same as the method
+ *                    result).
+ *
+ *  @return An observation object. You often don't need to keep this result.
+ */
++ (PAN_nullable PANNotificationObservation *)observeAllNotificationsNamed:(NSString *)name onQueue:(NSOperationQueue *)queue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANAnonymousObservationBlock)block;
+
++ (PAN_nullable PANNotificationObservation *)observeAllNotificationsNamed:(NSString *)name onGCDQueue:(dispatch_queue_t)queue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANAnonymousObservationBlock)block;
+
 
 /**
  *  Stop anonymously observing notifications posted with given name by a given object.
@@ -124,14 +144,16 @@ PAN_ASSUME_NONNULL_BEGIN
 #pragma mark - Convenince posting methods
 
 /**
- *  Post notification with a given name from the no particular sender.
+ *  Post notification with a given name from the no particular sender. Posted through `PANNotificationHub` if the
+ *  name is registered with it, otherwise to the default `NSNotificationCenter`.
  *
  *  @param name The notification name to post.
  */
 + (void)postNotificationNamed:(NSString *)name;
 
 /**
- *  Post notification with a given name from the no particular sender, with the given user info dictionary.
+ *  Post notification with a given name from the no particular sender, with the given user info dictionary. Posted
+ *  through `PANNotificationHub` if the name is registered with it, otherwise to the default `NSNotificationCenter`.
  *
  *  @param name     The notification name to post.
  *  @param userInfo The user info dictionary to include.
@@ -57,6 +57,20 @@ PAN_ASSUME_NONNULL_BEGIN
     }];
 }
 
++ (PAN_nullable PANNotificationObservation *)observeAllNotificationsNamed:(NSString *)name onQueue:(NSOperationQueue *)queue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANAnonymousObservationBlock)block
+{
+    return [[self sharedPanopticonObject] pan_observeAllNotificationsNamed:name onQueue:queue coalescing:coalescing withBlock:^(id obj, PANObservation *observation) {
+        block(observation);
+    }];
+}
+
++ (PAN_nullable PANNotificationObservation *)observeAllNotificationsNamed:(NSString *)name onGCDQueue:(dispatch_queue_t)queue coalescing:(PANNotificationCoalescing)coalescing withBlock:(PANAnonymousObservationBlock)block
+{
+    return [[self sharedPanopticonObject] pan_observeAllNotificationsNamed:name onGCDQueue:queue coalescing:coalescing withBlock:^(id obj, PANObservation *observation) {
+        block(observation);
+    }];
+}
+
 
 + (BOOL)stopObservingAllNotificationsNamed:(NSString *)name
 {
@@ -0,0 +1,73 @@
+//
+//  PANCollationBuffer.h
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-18.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+//  Storage for the detected observations collected while an observation is paused. A growable ring buffer,
+//  so appending is amortized O(1) instead of copying an array for every trigger. An NSArray is only built when
+//  one is asked for, then cached until the buffer changes.
+//
+//  Also tracks what the overflow policies of PANObservation need: a total of caller supplied costs, an optional
+//  key per object to find it again for coalescing, and a count of dropped objects. The buffer itself never
+//  drops anything, PANObservation decides that.
+//
+//  Not thread-safe, same as the rest of the pause & collate machinery in PANObservation.
+
+#import <Foundation/Foundation.h>
+#import "PANDefines.h"
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+@interface PANCollationBuffer : NSObject
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly, PAN_nullable) id firstObject;
+@property (nonatomic, readonly, PAN_nullable) id lastObject;
+
+/**
+ *  The object most recently added or replaced, which when coalescing isn't necessarily the last one.
+ */
+@property (nonatomic, readonly, PAN_nullable) id newestObject;
+
+/**
+ *  Sum of the costs of the objects currently in the buffer.
+ */
+@property (nonatomic, readonly) NSUInteger totalCost;
+
+/**
+ *  Count of objects that were dropped or replaced, maintained by the buffer's owner.
+ */
+@property (nonatomic) NSUInteger droppedCount;
+
+- (id)objectAtIndex:(NSUInteger)index;
+
+- (void)addObject:(id)object;
+- (void)addObject:(id)object cost:(NSUInteger)cost key:(PAN_nullable id<NSCopying>)key;
+
+/**
+ *  Index of the object added with the given key, or `NSNotFound`.
+ */
+- (NSUInteger)indexOfObjectWithKey:(id<NSCopying>)key;
+
+/**
+ *  Replace an object in place, keeping the key of the object being replaced.
+ */
+- (void)replaceObjectAtIndex:(NSUInteger)index withObject:(id)object cost:(NSUInteger)cost;
+
+- (void)removeFirstObject;
+- (void)removeAllObjects;
+
+/**
+ *  The buffer contents as an array, oldest first. Built on first access after the buffer changes.
+ */
+@property (nonatomic, readonly) NSArray *array;
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
@@ -0,0 +1,193 @@
+//
+//  PANCollationBuffer.m
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-18.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANCollationBuffer.h"
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+static const NSUInteger defaultCapacity = 16;
+
+typedef struct {
+    void *object;       // +1 retained
+    void *key;          // +1 retained, or NULL
+    NSUInteger cost;
+} PANCollationSlot;
+
+
+@implementation PANCollationBuffer
+{
+    PANCollationSlot *_slots;   // capacity always a power of 2
+    NSUInteger _capacity;
+    NSUInteger _head;           // slot of the oldest object
+    NSUInteger _headSequence;   // running count of objects ever removed from the front
+    NSUInteger _count;
+    NSMutableDictionary *_sequencesByKey; // key -> sequence number of the object added with it, created when first needed
+    NSArray *_array;            // cached result of -array, cleared by any change
+}
+
+- (instancetype)init
+{
+    return [self initWithCapacity:defaultCapacity];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity
+{
+    if (!(self = [super init]))
+        return nil;
+    _capacity = defaultCapacity;
+    while (_capacity < capacity)
+        _capacity <<= 1;
+    _slots = calloc(_capacity, sizeof(PANCollationSlot));
+    return self;
+}
+
+- (void)dealloc
+{
+    [self removeAllObjects];
+    free(_slots);
+}
+
+static inline PANCollationSlot *slotAtIndex(PANCollationBuffer *buffer, NSUInteger index)
+{
+    return &buffer->_slots[(buffer->_head + index) & (buffer->_capacity - 1)];
+}
+
+- (NSUInteger)count
+{
+    return _count;
+}
+
+- (PAN_nullable id)firstObject
+{
+    return _count > 0 ? (__bridge id)slotAtIndex(self, 0)->object : nil;
+}
+
+- (PAN_nullable id)lastObject
+{
+    return _count > 0 ? (__bridge id)slotAtIndex(self, _count - 1)->object : nil;
+}
+
+- (id)objectAtIndex:(NSUInteger)index
+{
+    if (index >= _count)
+        [NSException raise:NSRangeException format:@"Index %lu beyond bounds of collation buffer with count %lu", (unsigned long)index, (unsigned long)_count];
+    return (__bridge id)slotAtIndex(self, index)->object;
+}
+
+- (void)addObject:(id)object
+{
+    [self addObject:object cost:0 key:nil];
+}
+
+- (void)addObject:(id)object cost:(NSUInteger)cost key:(PAN_nullable id<NSCopying>)key
+{
+    if (_count == _capacity)
+        [self grow];
+    PANCollationSlot *slot = slotAtIndex(self, _count);
+    slot->object = (void *)CFBridgingRetain(object);
+    slot->key = key != nil ? (void *)CFBridgingRetain(key) : NULL;
+    slot->cost = cost;
+    if (key != nil) {
+        if (_sequencesByKey == nil)
+            _sequencesByKey = [NSMutableDictionary dictionary];
+        _sequencesByKey[key] = @(_headSequence + _count);
+    }
+    _count++;
+    _totalCost += cost;
+    _newestObject = object;
+    _array = nil;
+}
+
+- (NSUInteger)indexOfObjectWithKey:(id<NSCopying>)key
+{
+    NSNumber *sequence = _sequencesByKey[key];
+    return sequence != nil ? sequence.unsignedIntegerValue - _headSequence : NSNotFound;
+}
+
+- (void)replaceObjectAtIndex:(NSUInteger)index withObject:(id)object cost:(NSUInteger)cost
+{
+    if (index >= _count)
+        [NSException raise:NSRangeException format:@"Index %lu beyond bounds of collation buffer with count %lu", (unsigned long)index, (unsigned long)_count];
+    PANCollationSlot *slot = slotAtIndex(self, index);
+    CFRelease(slot->object);
+    slot->object = (void *)CFBridgingRetain(object);
+    _totalCost = _totalCost - slot->cost + cost;
+    slot->cost = cost;
+    _newestObject = object;
+    _array = nil;
+}
+
+- (void)removeFirstObject
+{
+    if (_count == 0)
+        return;
+    PANCollationSlot *slot = slotAtIndex(self, 0);
+    if (slot->key != NULL) {
+        id key = (__bridge id)slot->key;
+        if ([_sequencesByKey[key] unsignedIntegerValue] == _headSequence) // unless re-added since without coalescing
+            [_sequencesByKey removeObjectForKey:key];
+        CFRelease(slot->key);
+    }
+    if ((__bridge id)slot->object == _newestObject)
+        _newestObject = nil;
+    CFRelease(slot->object);
+    _totalCost -= slot->cost;
+    memset(slot, 0, sizeof(PANCollationSlot));
+    _head = (_head + 1) & (_capacity - 1);
+    _headSequence++;
+    _count--;
+    _array = nil;
+}
+
+- (void)removeAllObjects
+{
+    for (NSUInteger i = 0; i < _count; i++) {
+        PANCollationSlot *slot = slotAtIndex(self, i);
+        CFRelease(slot->object);
+        if (slot->key != NULL)
+            CFRelease(slot->key);
+        memset(slot, 0, sizeof(PANCollationSlot));
+    }
+    _headSequence += _count;
+    _head = _count = 0;
+    _totalCost = 0;
+    _newestObject = nil;
+    [_sequencesByKey removeAllObjects];
+    _array = nil;
+}
+
+- (NSArray *)array
+{
+    if (_array == nil) {
+        // linearize into a temporary of unretained pointers, arrayWithObjects:count: retains them itself
+        __unsafe_unretained id *objects = (__unsafe_unretained id *)malloc(MAX(_count, 1) * sizeof(id));
+        for (NSUInteger i = 0; i < _count; i++)
+            objects[i] = (__bridge id)slotAtIndex(self, i)->object;
+        _array = [NSArray arrayWithObjects:objects count:_count];
+        free(objects);
+    }
+    return _array;
+}
+
+- (void)grow
+{
+    NSUInteger newCapacity = _capacity << 1;
+    PANCollationSlot *newSlots = calloc(newCapacity, sizeof(PANCollationSlot));
+    for (NSUInteger i = 0; i < _count; i++)
+        newSlots[i] = *slotAtIndex(self, i);
+    free(_slots);
+    _slots = newSlots;
+    _capacity = newCapacity;
+    _head = 0;
+}
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
@@ -8,6 +8,35 @@
 
 #import "PANObservation.h"
 
+
+/**
+ *  A record of one trigger of an observation, filled in on the stack by a subclass and passed to
+ *  `triggerEvent:synchronously:`. What `detail` holds is up to each subclass, such as the key path of a KVO change
+ *  or the `NSNotification` of a notification, it and the other fields are only valid for the duration of that call.
+ */
+typedef struct PANObservationEvent {
+    __unsafe_unretained id object;
+    __unsafe_unretained id payload;
+    __unsafe_unretained id detail;
+    uint64_t timestampNanoseconds;
+} PANObservationEvent;
+
+/**
+ *  Make an event record timestamped with the current time.
+ */
+static inline PANObservationEvent PANObservationEventMake(__unsafe_unretained id object, __unsafe_unretained id payload, __unsafe_unretained id detail)
+{
+    PANObservationEvent event = { object, payload, detail, PANTimestampNanosecondsNow() };
+    return event;
+}
+
+/**
+ *  Convert a date to the clock of `PANTimestampNanosecondsNow()`, for an event record of something that happened
+ *  earlier. Returns 0, meaning no timestamp, for `nil`.
+ */
+extern uint64_t PANTimestampNanosecondsFromDate(NSDate *date);
+
+
 PAN_ASSUME_NONNULL_BEGIN
 
 
@@ -18,7 +47,8 @@ PAN_ASSUME_NONNULL_BEGIN
 @protocol PANMutableDetectedObservation <PANDetectedObservation>
 @property (nonatomic, readwrite, weak, PAN_nullable) id object;
 @property (nonatomic, readwrite, PAN_nullable) id payload;
-@property (nonatomic, readwrite) NSDate *timestamp;
+@property (nonatomic, readwrite) NSDate *timestamp; // setting also sets timestampNanoseconds to the corresponding clock time
+@property (nonatomic, readwrite) uint64_t timestampNanoseconds; // setting discards any timestamp date
 @end
 
 @interface PANDetectedObservation (Private) <PANMutableDetectedObservation>
@@ -38,8 +68,8 @@ PAN_ASSUME_NONNULL_BEGIN
 @property (nonatomic, readwrite, PAN_nullable) PAN_ARRAY(PANDetectedObservation) *collated;
 
 /**
- *  Don't know if we need to expose this. Should be set on all existing observations when app is made inactive.
- *  Perhaps this needs to be done another way.
+ *  Don't know if we need to expose this. To affect all existing observations when app is made inactive, use
+ *  `suspendAllObservations` instead of setting this on each of them.
  */
 @property (nonatomic) BOOL inactive;
 
@@ -83,26 +113,56 @@ PAN_ASSUME_NONNULL_BEGIN
 
 
 /**
- *  Method to be called when this observation has been triggered.
+ *  Method to be called when this observation has been triggered. Delivering synchronously, or with no `queue` or
+ *  `gcdQueue`, allocates nothing at all beyond what the observation block does.
+ *
+ *  Otherwise the event's values are copied into a pooled detected observation and put in the observation's
+ *  mailbox, a lock-free queue drained on `queue` or `gcdQueue` by a single task, scheduled only when the mailbox
+ *  was empty. So triggers are delivered in order and one at a time, and a burst of triggers costs one dispatch
+ *  (or one operation for an `NSOperationQueue`) rather than one each. With `deliversSnapshots` each trigger is
+ *  dispatched separately instead, so they can run concurrently.
  *
+ *  The values of the event are applied using `applyEvent:toDetectedObservation:`, which subclasses override
+ *  to apply their own `detail`.
+ *
+ *  @param event         The event record, only needs to be valid during this call.
  *  @param synchronously If observation not paused, then if this is `YES` then `queue` & `gcdQueue` are ignored and
  *                       the block will be invoked synchronously. Useful if calling when known to already be running
  *                       on the correct queue. If observation is paused, then this is ignored.
- *  @param setup         A block called to setup an object conforming to PANDetectedObservation, either self or an
- *                       object created using `createDetectedObservation`.
  */
-- (void)triggerSynchronously:(BOOL)synchronously withSetupBlock:(void(^)(id<PANDetectedObservation> obs))setup;
+- (void)triggerEvent:(const PANObservationEvent *)event synchronously:(BOOL)synchronously;
+
 
 /**
- *  Shortcut for `triggerSynchronously:setup:` with `synchronously` = `NO`.
+ *  Deliver several detected observations with one call of the block, `collated` holding them, the same as after
+ *  unpausing. Each is collated first, so limits and merging apply. If the observation is paused they're collected
+ *  with what it's collecting instead, if suspended they're collected until resumed.
+ *
+ *  Otherwise they're delivered the way a single trigger is, the newest carrying the rest, so rate limiting, the
+ *  mailbox and its backpressure, batching and `deliversSnapshots` all apply.
  *
- *  @param setup See `triggerSynchronously:setup:`.
+ *  @param detectedObservations Objects created using `createDetectedObservation` and setup.
  */
-- (void)triggerWithSetupBlock:(void(^)(id<PANDetectedObservation> obs))setup;
+- (void)deliverDetectedObservations:(PAN_ARRAY(PANDetectedObservation) *)detectedObservations;
 
 
 /**
- *  Look-up an observation based on the same parameters used in its creation.
+ *  Look-up an observation based on the same parameters used in its creation, using the index built from each
+ *  observation's `indexSubkey`. Doesn't need to scan the observer or observee's observations.
+ *
+ *  Finds observations of the receiver or its subclasses, normally called from a subclass's own find method.
+ *
+ *  @param observer The observer object, or `nil` if not applicable.
+ *  @param observee The object being observed, if applicable.
+ *  @param subkey   Value equal to the `indexSubkey` of the observation to find.
+ *
+ *  @return The earliest matching observation object still registered.
+ */
++ (PAN_nullable PANObservation *)findObservationForObserver:(PAN_nullable id)observer object:(PAN_nullable id)observee indexSubkey:(id)subkey;
+
+/**
+ *  Look-up an observation based on the same parameters used in its creation. Has to test each of the observer
+ *  or observee's observations, so prefer `findObservationForObserver:object:indexSubkey:` when possible.
  *
  *  @param observer  The observer object, or `nil` if not applicable.
  *  @param observee  The object being observed, if applicable.
@@ -133,6 +193,98 @@ PAN_ASSUME_NONNULL_BEGIN
  */
 - (void)deregisterInternal;
 
+/**
+ *  Return a value which, along with the class, observer & observee, identifies this observation for look-ups by
+ *  `findObservationForObserver:object:indexSubkey:`. Called once when the observation is registered, so must not
+ *  change afterwards. Must implement `isEqual:` and `hash` (arrays are hashed by element). Default returns `nil`,
+ *  meaning the observation isn't indexed.
+ *
+ *  @return The subclass-specific part of the observation's index key, such as a notification name.
+ */
+- (PAN_nullable id)indexSubkey;
+
+/**
+ *  Return the class whose observations and those of its subclasses share index keys, so looking up with any of
+ *  those classes can find them. Default returns the receiver's ancestor that's a direct subclass of
+ *  `PANObservation`, the base class of its family such as `PANKeyValueObservation`.
+ *
+ *  @return The class used in the index keys of the receiver's observations.
+ */
++ (Class)indexClass;
+
+/**
+ *  Copy the values of an event record into the receiver or a detected observation created by
+ *  `createDetectedObservation`. Subclass should call super, then apply the event's `detail` and derive any other
+ *  values from it. Must also accept an all-zero event, used to clear pooled detected observations.
+ *
+ *  @param event               The event record passed to `triggerEvent:synchronously:`.
+ *  @param detectedObservation The object to apply the values to.
+ */
+- (void)applyEvent:(const PANObservationEvent *)event toDetectedObservation:(id<PANMutableDetectedObservation>)detectedObservation;
+
+/**
+ *  Return a key identifying what a collected trigger is about, used by `PANCollationOverflowCoalesceByKey` to
+ *  replace an earlier trigger with the same key. Default returns `nil`, meaning triggers are never coalesced.
+ *
+ *  @param detectedObservation A detected observation created by `createDetectedObservation` and setup.
+ *
+ *  @return A key, compared using `isEqual:`, or `nil`.
+ */
+- (PAN_nullable id<NSCopying>)collationKeyForDetectedObservation:(PANDetectedObservation *)detectedObservation;
+
+/**
+ *  Merge a collected trigger into the one collected before it, if the two can be represented as one. Used while
+ *  collating and when building a batch for `batchesDeliveries`, before any overflow policy. Default returns `NO`.
+ *
+ *  @param detectedObservation A detected observation created by `createDetectedObservation` and setup.
+ *  @param previous            The detected observation last collected, which is changed in place when merging.
+ *
+ *  @return `YES` if merged into `previous`, and `detectedObservation` is to be discarded.
+ */
+- (BOOL)mergeDetectedObservation:(PANDetectedObservation *)detectedObservation intoDetectedObservation:(PANDetectedObservation *)previous;
+
+/**
+ *  Return a key for merging a trigger into an earlier one still waiting for delivery on `queue` or `gcdQueue`,
+ *  rather than queueing it. Called on the triggering thread, and a trigger given a key has no detected observation
+ *  created or queued for it if one with the same key is waiting. Default returns `NULL`, meaning triggers are
+ *  always queued.
+ *
+ *  @param event The event record passed to `triggerEvent:synchronously:`.
+ *
+ *  @return A key compared by address, or `NULL`.
+ */
+- (PAN_nullable const void *)queuedCoalescingKeyForEvent:(const PANObservationEvent *)event;
+
+/**
+ *  Merge a trigger into a detected observation waiting for delivery with the same key from
+ *  `queuedCoalescingKeyForEvent:`. Called on the triggering thread while the detected observation can't be
+ *  delivered. Default applies the event with `applyEvent:toDetectedObservation:`, replacing the earlier values.
+ *
+ *  @param event              The event record passed to `triggerEvent:synchronously:`.
+ *  @param queuedObservation  The detected observation waiting for delivery, changed in place.
+ */
+- (void)mergeEvent:(const PANObservationEvent *)event intoQueuedDetectedObservation:(PANDetectedObservation *)queuedObservation;
+
+/**
+ *  Return an estimate of the memory used by a collected trigger, for enforcing `collationByteLimit`. Default is
+ *  the allocated size of the detected observation and its payload. Subclasses with other properties holding
+ *  significant objects should add those, calling super.
+ *
+ *  @param detectedObservation A detected observation created by `createDetectedObservation` and setup.
+ *
+ *  @return Number of bytes.
+ */
+- (NSUInteger)collationCostOfDetectedObservation:(PANDetectedObservation *)detectedObservation;
+
+/**
+ *  Copy the properties set when the receiver was created to a snapshot being made for `deliversSnapshots`, which
+ *  is an object of the same class made with the base class designated initializer. Subclass should copy only the
+ *  properties it defines and then call super.
+ *
+ *  @param snapshot The new snapshot.
+ */
+- (void)configureSnapshot:(PANObservation *)snapshot;
+
 /**
  *  Create an object conforming to the protocol PANDetectedObservation for adding to `collated` array when the
  *  observation is paused.
@@ -141,6 +293,24 @@ PAN_ASSUME_NONNULL_BEGIN
  */
 - (PANDetectedObservation *)createDetectedObservation;
 
+/**
+ *  Return whether automatic removal must happen before the observee's `dealloc` runs, rather than when the
+ *  registry associated with the observee is released afterwards. If so then `dealloc` is swizzled on the
+ *  observee's class. Default returns `NO`.
+ *
+ *  @return `YES` if the observation can't be removed once the observee has started deallocating.
+ */
++ (BOOL)requiresRemovalBeforeObserveeDeallocates;
+
+/**
+ *  Deregister several observations of this class at once, as they're being removed together by
+ *  `pan_removeAllObservations` or automatic removal. Default calls `deregisterInternal` on each, a subclass can
+ *  override to group the work, for example by observee.
+ *
+ *  @param observations Registered observations of the receiver class.
+ */
++ (void)deregisterObservations:(PAN_ARRAY(PANObservation) *)observations;
+
 /**
  *  Copy values from a `PANDetectedObservation` to the receiver. Subclass should copy only the properties it
  *  defines and then call super.
@@ -162,13 +332,52 @@ PAN_ASSUME_NONNULL_BEGIN
  *  the caller call use to perform delayed registration.
  */
 - (void)register;
+
+/**
+ *  Remove all observations made by or on the given object in one pass, used by `pan_removeAllObservations`.
+ */
++ (void)removeAllObservationsOfObject:(id)object;
+@end
+
+
+@interface PANObservation (PrivateForRegistryToUse)
+/**
+ *  Remove those observations with `removeAutomatically` set. Called by a registry as it's deallocated, which
+ *  happens as the object it's associated with is deallocated. The observations' weak `observer` and `observee`
+ *  properties already return `nil` for that object by then.
+ */
++ (void)performAutomaticRemovalOfObservations:(PAN_nullable PAN_ARRAY(PANObservation) *)observations;
+@end
+
+
+@interface PANObservation (PrivateForBagsToUse)
+/**
+ *  Same as setting `paused`, except that when this unpauses the observation, anything collected isn't delivered.
+ *  Instead a block delivering it is returned, for the caller to run on the observation's `queue` or `gcdQueue`
+ *  (or directly if it has neither), so that the deliveries of many observations can share a queue hop.
+ *
+ *  @param paused New value for `paused`.
+ *
+ *  @return A block delivering the collated triggers, or `nil` if there's nothing to deliver.
+ */
+- (PAN_nullable dispatch_block_t)setPausedDeferringDelivery:(BOOL)paused;
+
+/**
+ *  Same as setting `inactive`, except deferring delivery as `setPausedDeferringDelivery:` does.
+ */
+- (PAN_nullable dispatch_block_t)setInactiveDeferringDelivery:(BOOL)inactive;
+
+/**
+ *  Remove several observations in one pass, as `pan_removeAllObservations` does. Those not registered are ignored.
+ */
++ (void)removeObservations:(PAN_ARRAY(PANObservation) *)observations;
 @end
 
 
 @interface PANObservation (PrivateForTesting)
-+ (NSSet *)associatedObservationsForObserver:(id)observer;
-+ (NSSet *)associatedObservationsForObservee:(id)observee;
-+ (NSSet *)associatedObservationsForObserver:(PAN_nullable id)observer observee:(PAN_nullable id)observee;
++ (PAN_nullable PAN_ARRAY(PANObservation) *)associatedObservationsForObserver:(id)observer;
++ (PAN_nullable PAN_ARRAY(PANObservation) *)associatedObservationsForObservee:(id)observee;
++ (PAN_nullable PAN_ARRAY(PANObservation) *)associatedObservationsForObserver:(PAN_nullable id)observer observee:(PAN_nullable id)observee;
 @end
 
 
@@ -34,6 +34,64 @@ typedef void (^PANObservationBlock)(id obj, PANObservation *observation);
  */
 typedef void (^PANAnonymousObservationBlock)(PANObservation *observation);
 
+/**
+ *  What a paused observation does when triggered again after collecting up to its `collationLimit` or
+ *  `collationByteLimit`.
+ */
+typedef NS_ENUM(NSInteger, PANCollationOverflowPolicy) {
+    /** Discard the oldest collected triggers to make room for the new one. The default. */
+    PANCollationOverflowDropOldest = 0,
+    /** Discard the new trigger, keeping those collected first. */
+    PANCollationOverflowDropNewest,
+    /** Keep the triggers collected first, but always replace the last one collected with the new trigger. */
+    PANCollationOverflowKeepFirstAndLast,
+    /**
+     *  Whenever a trigger has the same collation key as one already collected, replace that one with the new
+     *  trigger, even before reaching the limit. For KVO the key is the key path that changed, so only the latest
+     *  change for each key path is kept. Observations without collation keys drop the oldest triggers instead.
+     */
+    PANCollationOverflowCoalesceByKey
+};
+
+/**
+ *  What an observation does when triggered while it already has `maximumInFlightDeliveries` waiting for or in
+ *  delivery on its queue.
+ */
+typedef NS_ENUM(NSInteger, PANBackpressurePolicy) {
+    /** Discard the new trigger, counting it in `backpressureDroppedCount`. The default. */
+    PANBackpressureDropNewest = 0,
+    /**
+     *  Hold the new trigger aside to be delivered once the queued ones have been, replacing any trigger held
+     *  aside before it, counting that in `backpressureCoalescedCount`.
+     */
+    PANBackpressureCoalesceIntoNewest,
+    /**
+     *  Make the triggering thread wait until a delivery completes, for up to `backpressureTimeout`, then
+     *  discard the trigger as for `PANBackpressureDropNewest`. Don't use when the observation can be triggered
+     *  from its own queue, that would always wait the full timeout.
+     */
+    PANBackpressureBlock
+};
+
+/**
+ *  How an observation limits the rate its block is called, each using its `rateLimitInterval`.
+ */
+typedef NS_ENUM(NSInteger, PANRateLimiting) {
+    /** Every trigger calls the block. The default. */
+    PANRateLimitingNone = 0,
+    /** Call the block for the first trigger after a quiet interval, ignoring those that follow too closely. */
+    PANRateLimitingDebounceLeading,
+    /** Call the block for the last trigger once a quiet interval has passed after it. */
+    PANRateLimitingDebounceTrailing,
+    /**
+     *  Call the block right away for a trigger, then at most once more per interval for the latest trigger during
+     *  it, if any.
+     */
+    PANRateLimitingThrottle,
+    /** Every interval, call the block for the latest trigger during it, if any. */
+    PANRateLimitingSample
+};
+
 
 #pragma mark -
 
@@ -63,9 +121,25 @@ typedef void (^PANAnonymousObservationBlock)(PANObservation *observation);
  */
 @property (nonatomic, readonly) NSDate *timestamp;
 
+/**
+ *  Time when this triggered observation occurred, in nanoseconds of a monotonic clock that doesn't count time
+ *  the device spends asleep, and with an arbitrary origin. Recorded on each trigger instead of creating an `NSDate`,
+ *  which `timestamp` only creates from this when it's read. Compare with `PANTimestampNanosecondsNow()` to measure
+ *  latency without any allocations.
+ */
+@property (nonatomic, readonly) uint64_t timestampNanoseconds;
+
 @end
 
 
+/**
+ *  Current time of the clock used by `timestampNanoseconds`.
+ *
+ *  @return Nanoseconds of a monotonic clock with an arbitrary origin.
+ */
+extern uint64_t PANTimestampNanosecondsNow(void);
+
+
 /**
  *  An object conforming to the PANDetectedObservation protocol. `PANObservation` property `collated` is
  *  an array of these (or a subclass).
@@ -170,12 +244,36 @@ typedef void (^PANAnonymousObservationBlock)(PANObservation *observation);
  *  be harmful depending on the particular observation subclass, but will at least result in the observation object
  *  not being released.
  *
- *  NB: there's no opportunity for the caller to set this property before `dealloc` methods are swizzled on observer
- *  and observee objects. If hoping to set this property  to `NO` to avoid swizzling being used on your objects,
- *  there's no way at the moment.
+ *  Removal is done by an object associated with the observer and observee, released along with them, so objects
+ *  without observations pay nothing for this. The exception is key-value observation, which needs removing before
+ *  the observee's `dealloc` runs, and so swizzles `dealloc` on the observee's class. NB: there's no opportunity for
+ *  the caller to set this property to `NO` before that happens.
  */
 @property (nonatomic) BOOL removeAutomatically;
 
+/**
+ *  Whether each trigger is delivered to the block as its own snapshot instead of the observation itself. Default
+ *  is `NO`.
+ *
+ *  Normally the block is passed this observation with its properties set from the trigger, so a later trigger
+ *  changes those properties, even while an earlier call of the block is still running on another thread. That's
+ *  fine for a serial queue but not a concurrent one. When this is `YES`, the block is passed a snapshot instead:
+ *  an object of the same class, with the same `observer`, `observee` and other properties set at creation, whose
+ *  trigger properties are never changed while the block runs. Calling `remove` on a snapshot removes this
+ *  observation. Snapshots are reused for later triggers once the block returns, so a block that keeps a reference
+ *  to one of any kind, strong or weak, for use after it returns must call `keepSnapshot` on it first.
+ *
+ *  After unpausing, the block is passed this observation as usual, with `collated` set.
+ */
+@property (nonatomic) BOOL deliversSnapshots;
+
+/**
+ *  Have the snapshot passed to the block never be reused for a later trigger, so its properties stay as they are
+ *  after the block returns. Must be called from within the block, on the snapshot it was passed. Has no effect when
+ *  called on an observation that isn't a snapshot.
+ */
+- (void)keepSnapshot;
+
 
 /**
  *  Whether this observation collates results while paused. Default is `YES`. Set to `NO` to avoid collecting
@@ -190,17 +288,114 @@ typedef void (^PANAnonymousObservationBlock)(PANObservation *observation);
  */
 @property (nonatomic) BOOL paused;
 
+/**
+ *  Maximum number of triggers collected while paused, or 0 for no limit. Default is 0. What happens on further
+ *  triggers is determined by `collationOverflowPolicy`.
+ */
+@property (nonatomic) NSUInteger collationLimit;
+
+/**
+ *  Approximate maximum number of bytes of memory used by triggers collected while paused, or 0 for no limit.
+ *  Default is 0. Measured as the allocated size of each collected `PANDetectedObservation` and its payload (for
+ *  KVO, the old and new values too), so objects referenced deeper by payloads aren't counted.
+ */
+@property (nonatomic) NSUInteger collationByteLimit;
+
+/**
+ *  What to do when a trigger arrives while paused and `collationLimit` or `collationByteLimit` has been reached.
+ *  Default is `PANCollationOverflowDropOldest`.
+ */
+@property (nonatomic) PANCollationOverflowPolicy collationOverflowPolicy;
+
+
+/**
+ *  Whether triggers are delivered in batches. Default is `NO`.
+ *
+ *  When `YES`, triggers that arrive before the block can be called are combined into one call of the block, with
+ *  `collated` set to those triggers like after unpausing, and the other properties set to the latest of them. The
+ *  block is called on `queue` or `gcdQueue` as usual, or on the main queue if the observation has neither, in
+ *  which case triggers during one turn of the main run loop end up in the same batch. Takes precedence over
+ *  `deliversSnapshots`.
+ */
+@property (nonatomic) BOOL batchesDeliveries;
+
+/**
+ *  Maximum number of triggers in one batch when `batchesDeliveries` is `YES`, or 0 for no limit. Default is 0.
+ *  Larger batches are split, calling the block for each part in turn.
+ */
+@property (nonatomic) NSUInteger maximumBatchSize;
+
+/**
+ *  When `batchesDeliveries` is `YES`, how long to wait after the first trigger of a batch before calling the
+ *  block, so that more triggers can join the batch. Since the block is called then, no trigger waits longer
+ *  than this (plus the time for the queue to get to it). Default is 0, not waiting.
+ */
+@property (nonatomic) NSTimeInterval maximumBatchLatency;
+
+
+/**
+ *  Maximum number of triggers waiting for delivery on `queue` or `gcdQueue`, including the one being delivered,
+ *  or 0 for no limit. Default is 0. Concurrent triggers can each see room for one more, so can slightly exceed
+ *  the limit. Doesn't apply with `deliversSnapshots`, or when delivering synchronously.
+ */
+@property (nonatomic) NSUInteger maximumInFlightDeliveries;
+
+/**
+ *  What to do with a trigger when `maximumInFlightDeliveries` has been reached. Default is
+ *  `PANBackpressureDropNewest`.
+ */
+@property (nonatomic) PANBackpressurePolicy backpressurePolicy;
+
+/**
+ *  Longest time a triggering thread waits for room with `PANBackpressureBlock`, in seconds. Default is 0.1.
+ */
+@property (nonatomic) NSTimeInterval backpressureTimeout;
+
+/**
+ *  Number of triggers discarded because `maximumInFlightDeliveries` was reached, since the observation was created.
+ *  Unlike `droppedCount` this can be read at any time, from any thread.
+ */
+@property (nonatomic, readonly) NSUInteger backpressureDroppedCount;
+
+/**
+ *  Number of triggers replaced by later ones with `PANBackpressureCoalesceIntoNewest`, since the observation was
+ *  created. Can be read at any time, from any thread.
+ */
+@property (nonatomic, readonly) NSUInteger backpressureCoalescedCount;
+
+
+/**
+ *  How calls to the block are limited when the observation is triggered frequently. Default is
+ *  `PANRateLimitingNone`. Triggers held back to be delivered later go to `queue` or `gcdQueue` if the observation
+ *  has one, otherwise the block is called on an undefined thread as usual. Applied before `batchesDeliveries`.
+ *
+ *  All observations share a single timer facility, and `remove` cancels any pending delivery.
+ */
+@property (nonatomic) PANRateLimiting rateLimiting;
+
+/**
+ *  The interval used by `rateLimiting`, in seconds. Default is 0.
+ */
+@property (nonatomic) NSTimeInterval rateLimitInterval;
+
 
 /**
  *  Collected observation data from instances of the observation being triggered while it is paused and
- *  `collates` is `YES`. If this observation has been triggered and its block is being called immediately, then
- *  this will be `nil`.
+ *  `collates` is `YES`, or the triggers of a batch when `batchesDeliveries` is `YES`. If this observation has been
+ *  triggered and its block is being called immediately, then this will be `nil`.
  *
  *  Each element of the array is an `PANDetectedObservation`, ordered from the oldest triggered observation to
  *  the newest.
  */
 @property (nonatomic, readonly, PAN_nullable) PAN_ARRAY(PANDetectedObservation) *collated;
 
+/**
+ *  Number of triggers that occurred while paused but aren't in `collated`, having been discarded or replaced
+ *  according to `collationOverflowPolicy`. Like `collated`, it's meaningful when the block is called after the
+ *  observation is unpaused, otherwise it's 0.
+ */
+@property (nonatomic, readonly) NSUInteger droppedCount;
+
 
 /**
  *  Explicitly remove, or deregister, the observation.
@@ -211,6 +406,29 @@ typedef void (^PANAnonymousObservationBlock)(PANObservation *observation);
  */
 - (void)remove;
 
+
+/**
+ *  Suspend delivery for all observations in the process at once, such as when the app is made inactive. Costs
+ *  the same however many observations exist: each checks a global flag when triggered.
+ *
+ *  While suspended, a trigger of an observation whose `collates` is `YES` is collected as if it were paused,
+ *  limited by its `collationLimit` etc. Otherwise the trigger is ignored. Triggers already waiting for delivery on
+ *  a queue are still delivered. Unlike `paused`, this doesn't discard anything already being collated.
+ */
++ (void)suspendAllObservations;
+
+/**
+ *  Resume delivery after `suspendAllObservations`. Only observations triggered meanwhile are visited, each calls
+ *  its block with `collated` set the same as after unpausing. Those paused in the meantime keep the triggers until
+ *  unpaused instead. Does nothing if not suspended.
+ */
++ (void)resumeAllObservations;
+
+/**
+ *  Whether `suspendAllObservations` is in effect.
+ */
++ (BOOL)allObservationsSuspended;
+
 @end
 
 
@@ -8,20 +8,30 @@
 //  TODO:
 //  - consider using a global GCD queue when queue and cgdQueue both nil, either a private one or always
 //    the main queue, this is to avoid a triggered observation interrupting its own currenly-running
-//    observation block from changing its properties. possible?
-//  - alternately make observation object copyable and pass a copy the observation block instead of the
-//    original, this prevents that block from being able to compare observation instance pointers,
-//    which is probably of limited use anyhow
+//    observation block from changing its properties. possible? when there is a queue, triggers go through
+//    the mailbox and are delivered one at a time so can't interrupt each other
+//  - deliversSnapshots is the copying alternative, consider making it the default, though then the block
+//    can't compare observation instance pointers, which is probably of limited use anyhow
 
 #import "PANObservation.h"
 #import "PANObservation+Private.h"
+#import "PANObservationRegistry.h"
+#import "PANCollationBuffer.h"
+#import "PANObservationMailbox.h"
+#import "PANObservationScheduler.h"
 #import <objc/runtime.h>
 #import <objc/message.h>
+#import <malloc/malloc.h>
+#import <mach/mach_time.h>
+#import <pthread.h>
+#import <stdatomic.h>
+#import <sys/time.h>
+#import <errno.h>
 
 PAN_ASSUME_NONNULL_BEGIN
 
 
-@interface PANObservation () <PANMutableDetectedObservation>
+@interface PANObservation () <PANMutableDetectedObservation, PANObservationSchedulerTarget>
 @property (nonatomic, readwrite, weak, PAN_nullable) id observer;
 @property (nonatomic, readwrite, weak, PAN_nullable) id observee;
 
@@ -34,22 +44,91 @@ PAN_ASSUME_NONNULL_BEGIN
 @property (nonatomic, readwrite) BOOL registered;
 
 @property (nonatomic) BOOL inactive; // perhaps will be made public
+
+@property (nonatomic, PAN_nullable) PANCollationBuffer *collationBuffer; // non-nil while paused and collating
+@property (nonatomic, PAN_nullable) PANCollationBuffer *deliveredCollation; // set while block called after unpause
+
+@property (nonatomic, weak, PAN_nullable) PANObservation *snapshotSource; // set in snapshots, the observation they were made from
+@property (nonatomic) BOOL snapshotKept; // set by the block with keepSnapshot, so the snapshot isn't recycled
 @end
 
+@interface PANDetectedObservation ()
+{
+    @public
+    PANMailboxNode _mailboxNode; // while waiting in an observation's mailbox
+    const void *_queuedCoalescingKey; // while waiting in the mailbox for later triggers to merge into
+    PANCollationBuffer *_carriedCollation; // set in the newest of a collation delivered with one call of the block
+}
+@end
+
+
+// the detected observations of a carried collation, or just the one, no longer carrying them
+static inline NSArray *PANTakeCarriedDetectedObservations(PANDetectedObservation *detectedObservation)
+{
+    PANCollationBuffer *collation = detectedObservation->_carriedCollation;
+    if (collation == nil)
+        return @[detectedObservation];
+    detectedObservation->_carriedCollation = nil;
+    return collation.array;
+}
 
-static const int PANObservationSetKeyVar;
-static void *PANObservationSetKey = (void *)&PANObservationSetKeyVar;
 
 static NSMutableSet *classesSwizzledSet = nil;
 
+static const NSUInteger maximumPooledDetectedObservations = 8;
+static const NSUInteger maximumPooledSnapshots = 32; // enough for a concurrent queue busy on every core
+static const NSUInteger maximumDeliveriesPerDrain = 64; // then yield the queue to others, continuing in a new drain
+static const NSTimeInterval defaultBackpressureTimeout = 0.1;
+
+// the process-wide gate of suspendAllObservations, odd while suspended. the trigger path only loads it, and only
+// observations triggered while suspended are touched by suspending & resuming, tracked in suspendedObservations
+static atomic_uint_fast64_t suspensionEpoch = 0;
+static pthread_mutex_t suspensionLock = PTHREAD_MUTEX_INITIALIZER; // guards the following & every _suspendedCollation
+static NSMutableArray *suspendedObservations = nil; // those with a _suspendedCollation
+
+static inline BOOL PANObservationsSuspended(void)
+{
+    return (atomic_load_explicit(&suspensionEpoch, memory_order_acquire) & 1) != 0;
+}
+
+static void PANDrainMailbox(void *context);
+static void PANDeliverPooledSnapshot(void *context);
+static NSDate *PANDateFromTimestampNanoseconds(uint64_t nanoseconds);
+
 
 #pragma mark -
 
 @implementation PANObservation
+{
+    pthread_mutex_t _poolLock;
+    NSMutableArray *_detectedObservationPool; // guarded by _poolLock, detected observations for carrying events to gcdQueue
+    NSMutableArray *_snapshotPool; // guarded by _poolLock, snapshots whose blocks have returned
+    PANMailbox _mailbox; // detected observations waiting for delivery on queue or gcdQueue
+    _Atomic(void *) _overflowCarrier; // +1 detected observation held aside by PANBackpressureCoalesceIntoNewest
+    _Atomic(NSUInteger) _backpressureDroppedCount;
+    _Atomic(NSUInteger) _backpressureCoalescedCount;
+    atomic_uint_fast32_t _backpressureWaiters;
+    pthread_mutex_t _backpressureLock; // for waiting with _backpressureCondition
+    pthread_cond_t _backpressureCondition; // signalled by the drain when there are waiters
+    
+    pthread_mutex_t _rateLimitLock; // guards the following
+    PANDetectedObservation *_rateLimitHeld; // latest trigger held back by rateLimiting
+    uint64_t _rateLimitLastTrigger;
+    uint64_t _rateLimitDeadline;
+    BOOL _rateLimitDeadlinePending;
+    PANObservationScheduler *_rateLimitScheduler; // the one a deadline is pending with
+    
+    PANCollationBuffer *_suspendedCollation; // guarded by suspensionLock, triggers collected while suspended
+    
+    pthread_mutex_t _queuedCoalescingLock; // guards the following & the detected observations it holds
+    CFMutableDictionaryRef _queuedByCoalescingKey; // coalescing key -> unretained detected observation in the mailbox
+}
 
 @synthesize object;
 @synthesize payload;
-@synthesize timestamp;
+@synthesize timestamp = _timestamp;
+@synthesize timestampNanoseconds = _timestampNanoseconds;
+@synthesize schedulerHeapIndex = _schedulerHeapIndex;
 
 - (instancetype)init
 {
@@ -71,7 +150,7 @@ static NSMutableSet *classesSwizzledSet = nil;
     _queue = queue;
     _gcdQueue = cgdQueue;
     _objectBlock = block;
-    _removeAutomatically = YES;
+    [self setupDelivery];
     return self;
 }
 
@@ -83,10 +162,42 @@ static NSMutableSet *classesSwizzledSet = nil;
     _queue = queue;
     _gcdQueue = cgdQueue;
     _anonymousBlock = block;
-    _removeAutomatically = YES;
+    [self setupDelivery];
     return self;
 }
 
+// shared by the designated initializers
+- (void)setupDelivery
+{
+    _removeAutomatically = YES;
+    _backpressureTimeout = defaultBackpressureTimeout;
+    _schedulerHeapIndex = NSNotFound;
+    pthread_mutex_init(&_poolLock, NULL);
+    pthread_mutex_init(&_rateLimitLock, NULL);
+    pthread_mutex_init(&_backpressureLock, NULL);
+    pthread_cond_init(&_backpressureCondition, NULL);
+    pthread_mutex_init(&_queuedCoalescingLock, NULL);
+    PANMailboxInit(&_mailbox);
+    atomic_init(&_overflowCarrier, NULL);
+    atomic_init(&_backpressureDroppedCount, 0);
+    atomic_init(&_backpressureCoalescedCount, 0);
+    atomic_init(&_backpressureWaiters, 0);
+}
+
+- (void)dealloc
+{
+    void *overflow = atomic_exchange(&_overflowCarrier, NULL);
+    if (overflow != NULL)
+        CFRelease(overflow);
+    pthread_mutex_destroy(&_poolLock);
+    pthread_mutex_destroy(&_rateLimitLock);
+    pthread_mutex_destroy(&_backpressureLock);
+    pthread_cond_destroy(&_backpressureCondition);
+    pthread_mutex_destroy(&_queuedCoalescingLock);
+    if (_queuedByCoalescingKey != NULL)
+        CFRelease(_queuedByCoalescingKey);
+}
+
 - (void)register
 {
     if (self.registered)
@@ -100,92 +211,824 @@ static NSMutableSet *classesSwizzledSet = nil;
 
 - (void)remove
 {
+    if (self.snapshotSource != nil) {
+        [self.snapshotSource remove];
+        return;
+    }
     if (!self.registered)
         return;
     
     [self deregisterInternal];
     [self removeAssociatedObservation];
+    [self cancelRateLimiting];
     self.registered = NO;
 }
 
+- (BOOL)registered
+{
+    PANObservation *source = self.snapshotSource;
+    return source != nil ? source.registered : _registered;
+}
+
+- (void)keepSnapshot
+{
+    if (self.snapshotSource != nil)
+        self.snapshotKept = YES;
+}
+
 - (void)setPaused:(BOOL)paused
 {
+    [self scheduleCollatedDelivery:[self setPausedDeferringDelivery:paused]];
+}
+
+- (void)setInactive:(BOOL)inactive
+{
+    [self scheduleCollatedDelivery:[self setInactiveDeferringDelivery:inactive]];
+}
+
+- (PAN_nullable dispatch_block_t)setPausedDeferringDelivery:(BOOL)paused
+{
+    dispatch_block_t delivery = nil;
     if (paused && !self.inactive) {
         [self pause];
     }
     else if (!paused && !self.inactive) {
-        [self unpause];
+        delivery = [self unpause];
     }
     _paused = paused;
+    return delivery;
 }
 
-- (void)setInactive:(BOOL)inactive
+- (PAN_nullable dispatch_block_t)setInactiveDeferringDelivery:(BOOL)inactive
 {
+    dispatch_block_t delivery = nil;
     if (inactive && !self.paused) {
         [self pause];
     }
     else if (!inactive && !self.paused) {
-        [self unpause];
+        delivery = [self unpause];
     }
     _inactive = inactive;
+    return delivery;
+}
+
+- (void)scheduleCollatedDelivery:(PAN_nullable dispatch_block_t)delivery
+{
+    if (delivery != nil)
+        [self invokeSynchronously:NO afterSetup:^{ } using:delivery];
+}
+
++ (void)suspendAllObservations
+{
+    pthread_mutex_lock(&suspensionLock);
+    if (!PANObservationsSuspended())
+        atomic_fetch_add_explicit(&suspensionEpoch, 1, memory_order_release);
+    pthread_mutex_unlock(&suspensionLock);
+}
+
++ (void)resumeAllObservations
+{
+    pthread_mutex_lock(&suspensionLock);
+    if (!PANObservationsSuspended()) {
+        pthread_mutex_unlock(&suspensionLock);
+        return;
+    }
+    atomic_fetch_add_explicit(&suspensionEpoch, 1, memory_order_release);
+    
+    // with the gate open nothing more is added to these collations, triggers that saw it closed but were waiting
+    // for the lock find it open and deliver normally, so they can be delivered after unlocking
+    NSArray *observations = suspendedObservations;
+    suspendedObservations = nil;
+    NSMutableArray *collations = [NSMutableArray arrayWithCapacity:observations.count];
+    for (PANObservation *observation in observations) {
+        [collations addObject:observation->_suspendedCollation];
+        observation->_suspendedCollation = nil;
+    }
+    
+    pthread_mutex_unlock(&suspensionLock);
+    
+    [observations enumerateObjectsUsingBlock:^(PANObservation *observation, NSUInteger idx, BOOL *stop) {
+        [observation deliverCollation:collations[idx]];
+    }];
+}
+
++ (BOOL)allObservationsSuspended
+{
+    return PANObservationsSuspended();
+}
+
+// returns NO if observations were resumed since the caller checked, in which case it should deliver normally
+- (BOOL)collateDetectedObservationWhileSuspended:(PANDetectedObservation *)detectedObservation
+{
+    pthread_mutex_lock(&suspensionLock);
+    BOOL suspended = PANObservationsSuspended();
+    if (suspended) {
+        if (_suspendedCollation == nil) {
+            _suspendedCollation = [[PANCollationBuffer alloc] init];
+            if (suspendedObservations == nil)
+                suspendedObservations = [NSMutableArray array];
+            [suspendedObservations addObject:self];
+        }
+        [self collateDetectedObservation:detectedObservation intoBuffer:_suspendedCollation];
+    }
+    pthread_mutex_unlock(&suspensionLock);
+    return suspended;
+}
+
+- (void)deliverDetectedObservations:(NSArray *)detectedObservations
+{
+    if (!self.registered || detectedObservations.count == 0)
+        return;
+    
+    NSUInteger index = 0;
+    if (self.collationBuffer == nil && !self.paused && !self.inactive && PANObservationsSuspended()) {
+        if (!self.collates)
+            return;
+        while (index < detectedObservations.count && [self collateDetectedObservationWhileSuspended:detectedObservations[index]])
+            index++;
+        if (index == detectedObservations.count)
+            return;
+        // resumed meanwhile, the rest are delivered now
+    }
+    
+    PANCollationBuffer *collation = [[PANCollationBuffer alloc] initWithCapacity:detectedObservations.count - index];
+    for (; index < detectedObservations.count; index++)
+        [self collateDetectedObservation:detectedObservations[index] intoBuffer:collation];
+    [self deliverCollation:collation];
+}
+
+- (void)deliverCollation:(PANCollationBuffer *)collation
+{
+    if (!self.registered)
+        return;
+    if (self.collationBuffer != nil) {
+        // paused meanwhile, these join what it collects until unpaused
+        for (NSUInteger i = 0; i < collation.count; i++)
+            [self collateDetectedObservation:[collation objectAtIndex:i] intoBuffer:self.collationBuffer];
+    }
+    else if (!self.paused && !self.inactive && collation.count > 0) {
+        // the newest carries the rest, taking the same path as a trigger's detected observation
+        PANDetectedObservation *carrier = collation.newestObject != nil ? collation.newestObject : collation.lastObject;
+        carrier->_carriedCollation = collation;
+        if (self.rateLimiting != PANRateLimitingNone)
+            [self rateLimitEvent:NULL carrier:carrier synchronously:NO];
+        else
+            [self deliverDetectedObservation:carrier synchronously:NO];
+    }
+}
+
+- (PAN_nullable NSArray *)collated
+{
+    PANCollationBuffer *buffer = self.deliveredCollation != nil ? self.deliveredCollation : self.collationBuffer;
+    return buffer.array; // built lazily and cached by the buffer
+}
+
+- (NSUInteger)droppedCount
+{
+    PANCollationBuffer *buffer = self.deliveredCollation != nil ? self.deliveredCollation : self.collationBuffer;
+    return buffer.droppedCount;
+}
+
+- (void)setCollated:(PAN_nullable NSArray *)collated
+{
+    PANCollationBuffer *buffer = nil;
+    if (collated != nil) {
+        buffer = [[PANCollationBuffer alloc] initWithCapacity:collated.count];
+        for (id detectedObservation in collated)
+            [buffer addObject:detectedObservation];
+    }
+    self.collationBuffer = buffer;
+}
+
+- (NSDate *)timestamp
+{
+    if (_timestamp == nil && _timestampNanoseconds != 0)
+        _timestamp = PANDateFromTimestampNanoseconds(_timestampNanoseconds);
+    return _timestamp;
+}
+
+- (void)setTimestamp:(NSDate *)date
+{
+    _timestamp = date;
+    _timestampNanoseconds = PANTimestampNanosecondsFromDate(date);
+}
+
+- (void)setTimestampNanoseconds:(uint64_t)nanoseconds
+{
+    _timestampNanoseconds = nanoseconds;
+    _timestamp = nil;
 }
 
 - (void)pause
 {
     if (self.collates) {
-        self.collated = [NSArray array];
+        self.collationBuffer = [[PANCollationBuffer alloc] init];
     }
     else {
-        self.collated = nil;
+        self.collationBuffer = nil;
     }
 }
 
-- (void)unpause
+- (PAN_nullable dispatch_block_t)unpause
 {
-    if (self.collated.count > 0) {
-        [self invokeSynchronously:NO afterSetup:^{
-            [self duplicateFrom:self.collated.lastObject];
-        }];
-    }
-    self.collated = nil;
+    // hand the collected buffer to the delivery, the block may run later on another queue
+    PANCollationBuffer *collation = self.collationBuffer;
+    self.collationBuffer = nil;
+    return [self deliveryOfCollation:collation];
 }
 
-- (void)triggerWithSetupBlock:(void(^)(id<PANDetectedObservation>))setup
+- (PAN_nullable dispatch_block_t)deliveryOfCollation:(PAN_nullable PANCollationBuffer *)collation
 {
-    [self triggerSynchronously:NO withSetupBlock:setup];
+    if (collation.count == 0)
+        return nil;
+    return ^{
+        self.deliveredCollation = collation;
+        [self duplicateFrom:collation.newestObject != nil ? collation.newestObject : collation.lastObject];
+        [self invokeBlock];
+        self.deliveredCollation = nil;
+    };
 }
 
-- (void)triggerSynchronously:(BOOL)synchronously withSetupBlock:(void(^)(id<PANDetectedObservation>))setup
+- (void)triggerEvent:(const PANObservationEvent *)event synchronously:(BOOL)synchronously
 {
-    if (self.collated != nil) {
+    if (self.collationBuffer != nil) {
         PANDetectedObservation *detectedObservation = [self createDetectedObservation];
-        detectedObservation.object = self.observee;
-        detectedObservation.timestamp = [NSDate date];
-        setup(detectedObservation);
-        
-        self.collated = [self.collated arrayByAddingObject:detectedObservation];
+        [self applyEvent:event toDetectedObservation:detectedObservation];
+        [self collateDetectedObservation:detectedObservation intoBuffer:self.collationBuffer];
+    }
+    else if (!self.paused && !self.inactive && PANObservationsSuspended()) {
+        if (self.collates) {
+            PANDetectedObservation *detectedObservation = [self createDetectedObservation];
+            [self applyEvent:event toDetectedObservation:detectedObservation];
+            if (![self collateDetectedObservationWhileSuspended:detectedObservation])
+                [self triggerEvent:event synchronously:synchronously]; // resumed meanwhile
+        }
+    }
+    else if (!self.paused && !self.inactive && self.rateLimiting != PANRateLimitingNone) {
+        [self rateLimitEvent:event carrier:nil synchronously:synchronously];
     }
     else if (!self.paused && !self.inactive) {
-        [self invokeSynchronously:synchronously afterSetup:^{
-            self.object = self.observee;
-            self.timestamp = [NSDate date];
-            setup(self);
-        }];
+        [self deliverEvent:event synchronously:synchronously];
     }
     // if paused or inactive, ignore the triggered observation
 }
 
-- (void)invokeSynchronously:(BOOL)synchronously afterSetup:(void(^)(void))setup
+- (void)deliverEvent:(const PANObservationEvent *)event synchronously:(BOOL)synchronously
 {
-    if (self.anonymousBlock != nil) {
-        [self invokeSynchronously:synchronously afterSetup:setup using:^{
-            self.anonymousBlock(self);
+    if (self.batchesDeliveries) {
+        [self enqueueEvent:event];
+    }
+    else if (self.deliversSnapshots) {
+        // each trigger gets its own snapshot, so deliveries can run concurrently without disturbing each other,
+        // passed as a bare +1 reference to avoid a block allocation
+        void *context = (void *)CFBridgingRetain([self newPooledSnapshot]);
+        [self applyEvent:event toDetectedObservation:(__bridge PANObservation *)context];
+        if (synchronously || (self.queue == nil && self.gcdQueue == nil)) {
+            PANDeliverPooledSnapshot(context);
+        }
+        else if (self.queue != nil) {
+            [self.queue addOperationWithBlock:^{
+                PANDeliverPooledSnapshot(context);
+            }];
+        }
+        else {
+            dispatch_async_f(self.gcdQueue, context, PANDeliverPooledSnapshot);
+        }
+    }
+    else if (synchronously || (self.queue == nil && self.gcdQueue == nil)) {
+        [self applyEvent:event toDetectedObservation:self];
+        [self invokeBlock];
+    }
+    else {
+        [self enqueueEvent:event];
+    }
+}
+
+// the same as deliverEvent:synchronously: for a trigger already copied into a detected observation, such as one
+// held by rate limiting or the carrier of a collation, which it takes ownership of
+- (void)deliverDetectedObservation:(PANDetectedObservation *)carrier synchronously:(BOOL)synchronously
+{
+    if (self.batchesDeliveries) {
+        [self enqueueDetectedObservation:carrier];
+    }
+    else if (self.deliversSnapshots) {
+        PANObservation *snapshot = [self newPooledSnapshot];
+        [snapshot duplicateFrom:carrier];
+        snapshot.deliveredCollation = carrier->_carriedCollation;
+        [self recyclePooledDetectedObservation:carrier];
+        void *context = (void *)CFBridgingRetain(snapshot);
+        if (synchronously || (self.queue == nil && self.gcdQueue == nil)) {
+            PANDeliverPooledSnapshot(context);
+        }
+        else if (self.queue != nil) {
+            [self.queue addOperationWithBlock:^{
+                PANDeliverPooledSnapshot(context);
+            }];
+        }
+        else {
+            dispatch_async_f(self.gcdQueue, context, PANDeliverPooledSnapshot);
+        }
+    }
+    else if (synchronously || (self.queue == nil && self.gcdQueue == nil)) {
+        [self invokeBlockWithDetectedObservation:carrier];
+        [self recyclePooledDetectedObservation:carrier];
+    }
+    else {
+        [self enqueueDetectedObservation:carrier];
+    }
+}
+
+- (void)invokeBlockWithDetectedObservation:(PANDetectedObservation *)detectedObservation
+{
+    PANCollationBuffer *collation = detectedObservation->_carriedCollation;
+    if (collation != nil)
+        self.deliveredCollation = collation;
+    [self duplicateFrom:detectedObservation];
+    [self invokeBlock];
+    if (collation != nil)
+        self.deliveredCollation = nil;
+}
+
+- (void)enqueueEvent:(const PANObservationEvent *)event
+{
+    const void *coalescingKey = [self queuedCoalescingKeyForEvent:event];
+    if (coalescingKey != NULL) {
+        [self enqueueEvent:event coalescingKey:coalescingKey];
+        return;
+    }
+    
+    // the event record is only valid during this call, copy its values into a pooled object to wait in the mailbox
+    PANDetectedObservation *carrier = [self dequeuePooledDetectedObservation];
+    [self applyEvent:event toDetectedObservation:carrier];
+    [self enqueueDetectedObservation:carrier];
+}
+
+- (void)enqueueDetectedObservation:(PANDetectedObservation *)carrier
+{
+    NSUInteger limit = self.maximumInFlightDeliveries;
+    if (limit > 0 && PANMailboxPendingCount(&_mailbox) >= limit && ![self makeRoomForDetectedObservation:carrier limit:limit])
+        return;
+    
+    // only scheduling a drain if there wasn't one already
+    carrier->_mailboxNode.item = (void *)CFBridgingRetain(carrier);
+    if (PANMailboxPush(&_mailbox, &carrier->_mailboxNode))
+        [self scheduleMailboxDrainAfterDelay:self.batchesDeliveries ? self.maximumBatchLatency : 0];
+}
+
+// merges into the detected observation with the same key if one's still waiting in the mailbox. otherwise queues a
+// new one, bypassing maximumInFlightDeliveries since only one per key can be waiting
+- (void)enqueueEvent:(const PANObservationEvent *)event coalescingKey:(const void *)coalescingKey
+{
+    pthread_mutex_lock(&_queuedCoalescingLock);
+    
+    PANDetectedObservation *queued = _queuedByCoalescingKey != NULL ? (__bridge PANDetectedObservation *)CFDictionaryGetValue(_queuedByCoalescingKey, coalescingKey) : nil;
+    if (queued != nil) {
+        [self mergeEvent:event intoQueuedDetectedObservation:queued];
+        pthread_mutex_unlock(&_queuedCoalescingLock);
+        return;
+    }
+    
+    PANDetectedObservation *carrier = [self dequeuePooledDetectedObservation];
+    [self applyEvent:event toDetectedObservation:carrier];
+    carrier->_queuedCoalescingKey = coalescingKey;
+    if (_queuedByCoalescingKey == NULL)
+        _queuedByCoalescingKey = CFDictionaryCreateMutable(NULL, 0, NULL, NULL);
+    CFDictionarySetValue(_queuedByCoalescingKey, coalescingKey, (__bridge const void *)carrier);
+    carrier->_mailboxNode.item = (void *)CFBridgingRetain(carrier);
+    BOOL schedule = PANMailboxPush(&_mailbox, &carrier->_mailboxNode);
+    
+    pthread_mutex_unlock(&_queuedCoalescingLock);
+    
+    if (schedule)
+        [self scheduleMailboxDrainAfterDelay:self.batchesDeliveries ? self.maximumBatchLatency : 0];
+}
+
+// called by the drain for each detected observation it pops, later triggers with its key then queue a new one
+- (void)takeQueuedDetectedObservation:(PANDetectedObservation *)carrier
+{
+    if (carrier->_queuedCoalescingKey == NULL)
+        return;
+    pthread_mutex_lock(&_queuedCoalescingLock);
+    CFDictionaryRemoveValue(_queuedByCoalescingKey, carrier->_queuedCoalescingKey);
+    carrier->_queuedCoalescingKey = NULL;
+    pthread_mutex_unlock(&_queuedCoalescingLock);
+}
+
+- (void)scheduleMailboxDrainAfterDelay:(NSTimeInterval)delay
+{
+    if (self.queue != nil && delay > 0) {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            [self scheduleMailboxDrainAfterDelay:0];
+        });
+    }
+    else if (self.queue != nil) {
+        [self.queue addOperationWithBlock:^{
+            [self drainMailbox];
         }];
     }
+    else {
+        // only batched deliveries get here without either queue, or rate limited ones if also batched
+        dispatch_queue_t gcdQueue = self.gcdQueue != nil ? self.gcdQueue : dispatch_get_main_queue();
+        if (delay > 0)
+            dispatch_after_f(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), gcdQueue, (void *)CFBridgingRetain(self), PANDrainMailbox);
+        else
+            dispatch_async_f(gcdQueue, (void *)CFBridgingRetain(self), PANDrainMailbox);
+    }
+}
+
+- (void)drainMailbox
+{
+    // only one drain runs at a time, so triggers are delivered in order and never concurrently
+    NSUInteger delivered = 0;
+    BOOL more = YES;
+    while (more) {
+        NSUInteger count = 1;
+        @autoreleasepool {
+            if (self.batchesDeliveries) {
+                count = PANMailboxPendingCount(&_mailbox);
+                if (self.maximumBatchSize > 0)
+                    count = MIN(count, self.maximumBatchSize);
+                [self deliverMailboxBatchOfCount:count];
+            }
+            else {
+                PANMailboxNode *node = PANMailboxPop(&_mailbox);
+                PANDetectedObservation *carrier = CFBridgingRelease(node->item);
+                node->item = NULL;
+                [self takeQueuedDetectedObservation:carrier];
+                [self invokeBlockWithDetectedObservation:carrier];
+                [self recyclePooledDetectedObservation:carrier];
+            }
+        }
+        // only counted as finished after the block returns, so no producer schedules another drain meanwhile
+        more = PANMailboxFinishedNodes(&_mailbox, count);
+        if (atomic_load(&_backpressureWaiters) > 0) {
+            pthread_mutex_lock(&_backpressureLock);
+            pthread_cond_broadcast(&_backpressureCondition);
+            pthread_mutex_unlock(&_backpressureLock);
+        }
+        if (!more && [self queueOverflowCarrier])
+            more = YES; // it went into the empty mailbox, so this drain delivers it
+        delivered += count;
+        if (more && delivered >= maximumDeliveriesPerDrain) {
+            [self scheduleMailboxDrainAfterDelay:0];
+            return;
+        }
+    }
+}
+
+- (void)deliverMailboxBatchOfCount:(NSUInteger)count
+{
+    // the block can keep the batch's detected observations, so they're not recycled
+    PANCollationBuffer *batch = [[PANCollationBuffer alloc] initWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        PANMailboxNode *node = PANMailboxPop(&_mailbox);
+        PANDetectedObservation *detectedObservation = CFBridgingRelease(node->item);
+        node->item = NULL;
+        [self takeQueuedDetectedObservation:detectedObservation];
+        for (PANDetectedObservation *batched in PANTakeCarriedDetectedObservations(detectedObservation)) {
+            if (batch.count == 0 || ![self mergeDetectedObservation:batched intoDetectedObservation:batch.lastObject])
+                [batch addObject:batched];
+        }
+    }
+    self.deliveredCollation = batch;
+    [self duplicateFrom:batch.lastObject];
+    [self invokeBlock];
+    self.deliveredCollation = nil;
+}
+
+- (NSUInteger)backpressureDroppedCount
+{
+    return atomic_load(&_backpressureDroppedCount);
+}
+
+- (NSUInteger)backpressureCoalescedCount
+{
+    return atomic_load(&_backpressureCoalescedCount);
+}
+
+// returns YES if there's now room to queue the detected observation, otherwise has disposed of it
+- (BOOL)makeRoomForDetectedObservation:(PANDetectedObservation *)carrier limit:(NSUInteger)limit
+{
+    switch (self.backpressurePolicy) {
+        case PANBackpressureCoalesceIntoNewest: {
+            void *replaced = atomic_exchange(&_overflowCarrier, (void *)CFBridgingRetain(carrier));
+            if (replaced != NULL) {
+                atomic_fetch_add(&_backpressureCoalescedCount, 1);
+                [self recyclePooledDetectedObservation:CFBridgingRelease(replaced)];
+            }
+            // the drain checks for a held aside trigger after emptying the mailbox, if that's already happened
+            // then queue it here instead. one of the two is sure to see it, whichever takes it queues it
+            if (PANMailboxPendingCount(&_mailbox) == 0 && [self queueOverflowCarrier])
+                [self scheduleMailboxDrainAfterDelay:0];
+            return NO;
+        }
+            
+        case PANBackpressureBlock:
+            if ([self waitForInFlightDeliveriesBelowLimit:limit])
+                return YES;
+            // fall through, timed out
+            
+        case PANBackpressureDropNewest:
+            atomic_fetch_add(&_backpressureDroppedCount, 1);
+            [self recyclePooledDetectedObservation:carrier];
+            return NO;
+    }
+}
+
+// returns YES if the held aside trigger was queued into an empty mailbox, making the caller responsible for draining
+- (BOOL)queueOverflowCarrier
+{
+    void *overflow = atomic_exchange(&_overflowCarrier, NULL);
+    if (overflow == NULL)
+        return NO;
+    PANDetectedObservation *carrier = (__bridge PANDetectedObservation *)overflow;
+    carrier->_mailboxNode.item = overflow; // its +1 moves to the mailbox
+    return PANMailboxPush(&_mailbox, &carrier->_mailboxNode);
+}
+
+- (BOOL)waitForInFlightDeliveriesBelowLimit:(NSUInteger)limit
+{
+    struct timeval now;
+    gettimeofday(&now, NULL); // clock_gettime isn't available before iOS 10
+    double deadline = now.tv_sec + now.tv_usec / 1e6 + self.backpressureTimeout;
+    struct timespec until = { (time_t)deadline, (long)((deadline - floor(deadline)) * NSEC_PER_SEC) };
+    
+    BOOL room = YES;
+    atomic_fetch_add(&_backpressureWaiters, 1);
+    pthread_mutex_lock(&_backpressureLock);
+    while (PANMailboxPendingCount(&_mailbox) >= limit) {
+        if (pthread_cond_timedwait(&_backpressureCondition, &_backpressureLock, &until) == ETIMEDOUT) {
+            room = PANMailboxPendingCount(&_mailbox) < limit;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&_backpressureLock);
+    atomic_fetch_sub(&_backpressureWaiters, 1);
+    return room;
+}
+
+// given either the event of a trigger or a detected observation it's already been copied into
+- (void)rateLimitEvent:(PAN_nullable const PANObservationEvent *)event carrier:(PAN_nullable PANDetectedObservation *)carrier synchronously:(BOOL)synchronously
+{
+    PANObservationScheduler *scheduler = [PANObservationScheduler sharedScheduler];
+    uint64_t now = scheduler.nowNanoseconds;
+    uint64_t interval = (uint64_t)(self.rateLimitInterval * NSEC_PER_SEC);
+    BOOL deliverNow = NO;
+    PANDetectedObservation *replaced = nil;
+    
+    pthread_mutex_lock(&_rateLimitLock);
+    switch (self.rateLimiting) {
+        case PANRateLimitingNone:
+            deliverNow = YES;
+            break;
+            
+        case PANRateLimitingDebounceLeading:
+            // no deadline needed, just whether the last trigger was long enough ago
+            deliverNow = _rateLimitLastTrigger == 0 || now - _rateLimitLastTrigger >= interval;
+            break;
+            
+        case PANRateLimitingThrottle:
+            // outside an interval deliver right away and start one, within one hold the trigger until it ends
+            deliverNow = !_rateLimitDeadlinePending;
+            if (deliverNow)
+                [self scheduleRateLimitDeadline:now + interval withScheduler:scheduler];
+            break;
+            
+        case PANRateLimitingDebounceTrailing:
+        case PANRateLimitingSample:
+            // a debounce deadline is pushed back when reached if there's been a trigger since, rather than on
+            // every trigger
+            if (!_rateLimitDeadlinePending)
+                [self scheduleRateLimitDeadline:now + interval withScheduler:scheduler];
+            break;
+    }
+    _rateLimitLastTrigger = now;
+    if (!deliverNow && self.rateLimiting != PANRateLimitingDebounceLeading) {
+        replaced = _rateLimitHeld;
+        if (carrier != nil) {
+            _rateLimitHeld = carrier;
+        }
+        else {
+            _rateLimitHeld = [self dequeuePooledDetectedObservation];
+            [self applyEvent:event toDetectedObservation:_rateLimitHeld];
+        }
+    }
+    else if (!deliverNow) {
+        replaced = carrier; // dropped by a leading debounce
+    }
+    pthread_mutex_unlock(&_rateLimitLock);
+    
+    if (replaced != nil)
+        [self recyclePooledDetectedObservation:replaced];
+    if (deliverNow && carrier != nil)
+        [self deliverDetectedObservation:carrier synchronously:synchronously];
+    else if (deliverNow)
+        [self deliverEvent:event synchronously:synchronously];
+}
+
+// called with _rateLimitLock held
+- (void)scheduleRateLimitDeadline:(uint64_t)deadline withScheduler:(PANObservationScheduler *)scheduler
+{
+    _rateLimitDeadline = deadline;
+    _rateLimitDeadlinePending = YES;
+    _rateLimitScheduler = scheduler;
+    [scheduler scheduleTarget:self atNanoseconds:deadline];
+}
+
+- (void)schedulerDeadlineReached:(PANObservationScheduler *)scheduler
+{
+    uint64_t now = scheduler.nowNanoseconds;
+    uint64_t interval = (uint64_t)(self.rateLimitInterval * NSEC_PER_SEC);
+    PANDetectedObservation *held = nil;
+    
+    pthread_mutex_lock(&_rateLimitLock);
+    if (!_rateLimitDeadlinePending) {
+        // cancelled after the scheduler already took the deadline
+        pthread_mutex_unlock(&_rateLimitLock);
+        return;
+    }
+    _rateLimitDeadlinePending = NO;
+    _rateLimitScheduler = nil;
+    
+    if (self.rateLimiting == PANRateLimitingDebounceTrailing && now - _rateLimitLastTrigger < interval) {
+        [self scheduleRateLimitDeadline:_rateLimitLastTrigger + interval withScheduler:scheduler];
+    }
+    else {
+        held = _rateLimitHeld;
+        _rateLimitHeld = nil;
+        // throttle and sample keep going while there are triggers, sample at a fixed rate
+        if (held != nil && self.rateLimiting == PANRateLimitingThrottle)
+            [self scheduleRateLimitDeadline:now + interval withScheduler:scheduler];
+        else if (held != nil && self.rateLimiting == PANRateLimitingSample)
+            [self scheduleRateLimitDeadline:_rateLimitDeadline + interval withScheduler:scheduler];
+    }
+    pthread_mutex_unlock(&_rateLimitLock);
+    
+    if (held != nil)
+        [self deliverHeldDetectedObservation:held];
+}
+
+- (void)deliverHeldDetectedObservation:(PANDetectedObservation *)held
+{
+    if (self.collationBuffer != nil) {
+        for (PANDetectedObservation *detectedObservation in PANTakeCarriedDetectedObservations(held))
+            [self collateDetectedObservation:detectedObservation intoBuffer:self.collationBuffer];
+    }
+    else if (self.paused || self.inactive) {
+        [self recyclePooledDetectedObservation:held];
+    }
+    else {
+        // a trailing delivery is made the same way as the trigger it stands for, into a snapshot if asked for
+        [self deliverDetectedObservation:held synchronously:NO];
+    }
+}
+
+- (void)cancelRateLimiting
+{
+    pthread_mutex_lock(&_rateLimitLock);
+    PANDetectedObservation *held = _rateLimitHeld;
+    PANObservationScheduler *scheduler = _rateLimitScheduler;
+    _rateLimitHeld = nil;
+    _rateLimitScheduler = nil;
+    _rateLimitDeadlinePending = NO;
+    _rateLimitLastTrigger = 0;
+    pthread_mutex_unlock(&_rateLimitLock);
+    
+    [scheduler cancelTarget:self];
+    if (held != nil)
+        [self recyclePooledDetectedObservation:held];
+}
+
+- (PANDetectedObservation *)dequeuePooledDetectedObservation
+{
+    PANDetectedObservation *detectedObservation = nil;
+    pthread_mutex_lock(&_poolLock);
+    if (_detectedObservationPool.count > 0) {
+        detectedObservation = _detectedObservationPool.lastObject;
+        [_detectedObservationPool removeLastObject];
+    }
+    pthread_mutex_unlock(&_poolLock);
+    return detectedObservation != nil ? detectedObservation : [self createDetectedObservation];
+}
+
+- (void)recyclePooledDetectedObservation:(PANDetectedObservation *)detectedObservation
+{
+    // the carrier of a collation is one of its objects, which the block can keep, so isn't pooled
+    if (detectedObservation->_carriedCollation != nil) {
+        detectedObservation->_carriedCollation = nil;
+        return;
+    }
+    
+    // clear so the pool doesn't keep the last event's objects alive
+    PANObservationEvent emptyEvent = { nil, nil, nil, 0 };
+    [self applyEvent:&emptyEvent toDetectedObservation:detectedObservation];
+    
+    pthread_mutex_lock(&_poolLock);
+    if (_detectedObservationPool == nil)
+        _detectedObservationPool = [NSMutableArray arrayWithCapacity:maximumPooledDetectedObservations];
+    if (_detectedObservationPool.count < maximumPooledDetectedObservations)
+        [_detectedObservationPool addObject:detectedObservation];
+    pthread_mutex_unlock(&_poolLock);
+}
+
+- (PANObservation *)newSnapshot
+{
+    // made with the base initializer so nothing is registered, subclass copies the rest of its configuration
+    PANObservation *snapshot = nil;
+    if (self.anonymousBlock != nil)
+        snapshot = [[[self class] alloc] initWithObject:self.observee queue:self.queue gcdQueue:self.gcdQueue block:self.anonymousBlock];
+    else
+        snapshot = [[[self class] alloc] initWithObserver:self.observer object:self.observee queue:self.queue gcdQueue:self.gcdQueue block:self.objectBlock];
+    snapshot.snapshotSource = self;
+    [self configureSnapshot:snapshot];
+    return snapshot;
+}
+
+- (PANObservation *)newPooledSnapshot
+{
+    PANObservation *snapshot = nil;
+    pthread_mutex_lock(&_poolLock);
+    if (_snapshotPool.count > 0) {
+        snapshot = _snapshotPool.lastObject;
+        [_snapshotPool removeLastObject];
+    }
+    pthread_mutex_unlock(&_poolLock);
+    return snapshot != nil ? snapshot : [self newSnapshot];
+}
+
+- (void)recyclePooledSnapshot:(PANObservation *)snapshot
+{
+    PANObservationEvent emptyEvent = { nil, nil, nil, 0 };
+    [self applyEvent:&emptyEvent toDetectedObservation:snapshot];
+    snapshot.deliveredCollation = nil;
+    
+    pthread_mutex_lock(&_poolLock);
+    if (_snapshotPool == nil)
+        _snapshotPool = [NSMutableArray arrayWithCapacity:maximumPooledSnapshots];
+    if (_snapshotPool.count < maximumPooledSnapshots)
+        [_snapshotPool addObject:snapshot];
+    pthread_mutex_unlock(&_poolLock);
+}
+
+- (void)collateDetectedObservation:(PANDetectedObservation *)detectedObservation intoBuffer:(PANCollationBuffer *)buffer
+{
+    NSUInteger limit = self.collationLimit;
+    NSUInteger byteLimit = self.collationByteLimit;
+    NSUInteger cost = byteLimit > 0 ? [self collationCostOfDetectedObservation:detectedObservation] : 0;
+    
+    PANDetectedObservation *previous = buffer.lastObject;
+    if (previous != nil && [self mergeDetectedObservation:detectedObservation intoDetectedObservation:previous]) {
+        // replaced with itself to update its cost, and to make it the newest
+        [buffer replaceObjectAtIndex:buffer.count - 1 withObject:previous cost:byteLimit > 0 ? [self collationCostOfDetectedObservation:previous] : 0];
+        return;
+    }
+    
+    id<NSCopying> key = nil;
+    if (self.collationOverflowPolicy == PANCollationOverflowCoalesceByKey) {
+        key = [self collationKeyForDetectedObservation:detectedObservation];
+        NSUInteger index = key != nil ? [buffer indexOfObjectWithKey:key] : NSNotFound;
+        if (index != NSNotFound) {
+            [buffer replaceObjectAtIndex:index withObject:detectedObservation cost:cost];
+            buffer.droppedCount++;
+            return;
+        }
+    }
+    
+    BOOL full = (limit > 0 && buffer.count >= limit) || (byteLimit > 0 && buffer.count > 0 && buffer.totalCost + cost > byteLimit);
+    if (full) {
+        switch (self.collationOverflowPolicy) {
+            case PANCollationOverflowDropNewest:
+                buffer.droppedCount++;
+                return;
+                
+            case PANCollationOverflowKeepFirstAndLast:
+                if (buffer.count > 1) {
+                    [buffer replaceObjectAtIndex:buffer.count - 1 withObject:detectedObservation cost:cost];
+                    buffer.droppedCount++;
+                    return;
+                }
+                // with a limit of 1 there's no first & last, keep the newest
+                
+            case PANCollationOverflowDropOldest:
+            case PANCollationOverflowCoalesceByKey:
+                while (buffer.count > 0 && ((limit > 0 && buffer.count >= limit) || (byteLimit > 0 && buffer.totalCost + cost > byteLimit))) {
+                    [buffer removeFirstObject];
+                    buffer.droppedCount++;
+                }
+                break;
+        }
+    }
+    
+    [buffer addObject:detectedObservation cost:cost key:key];
+}
+
+- (void)invokeBlock
+{
+    if (self.anonymousBlock != nil) {
+        self.anonymousBlock(self);
+    }
     else if (self.objectBlock != nil) {
-        [self invokeSynchronously:synchronously afterSetup:setup using:^{
-            self.objectBlock(self.observer, self);
-        }];
+        self.objectBlock(self.observer, self);
     }
     else
         [NSException raise:NSInternalInconsistencyException format:@"Nil 'block' & 'objectBlock' properties when invoking observation %@", self];
@@ -215,16 +1058,70 @@ static NSMutableSet *classesSwizzledSet = nil;
 - (void)duplicateFrom:(id<PANDetectedObservation>)source
 {
     self.object = source.object;
-    self.timestamp = source.timestamp;
+    self.timestampNanoseconds = source.timestampNanoseconds;
     self.payload = source.payload;
 }
 
+- (void)applyEvent:(const PANObservationEvent *)event toDetectedObservation:(id<PANMutableDetectedObservation>)detectedObservation
+{
+    detectedObservation.object = event->object;
+    detectedObservation.payload = event->payload;
+    detectedObservation.timestampNanoseconds = event->timestampNanoseconds;
+}
+
+- (PAN_nullable id<NSCopying>)collationKeyForDetectedObservation:(PANDetectedObservation *)detectedObservation
+{
+    return nil;
+}
+
+- (BOOL)mergeDetectedObservation:(PANDetectedObservation *)detectedObservation intoDetectedObservation:(PANDetectedObservation *)previous
+{
+    return NO;
+}
+
+- (PAN_nullable const void *)queuedCoalescingKeyForEvent:(const PANObservationEvent *)event
+{
+    return NULL;
+}
+
+- (void)mergeEvent:(const PANObservationEvent *)event intoQueuedDetectedObservation:(PANDetectedObservation *)queuedObservation
+{
+    [self applyEvent:event toDetectedObservation:queuedObservation];
+}
+
+- (void)configureSnapshot:(PANObservation *)snapshot
+{
+    snapshot.removeAutomatically = self.removeAutomatically;
+}
+
+- (NSUInteger)collationCostOfDetectedObservation:(PANDetectedObservation *)detectedObservation
+{
+    // malloc_size returns 0 for tagged pointers & other objects not on the heap
+    NSUInteger cost = malloc_size((__bridge const void *)detectedObservation);
+    if (detectedObservation.payload != nil)
+        cost += malloc_size((__bridge const void *)detectedObservation.payload);
+    return cost;
+}
+
 - (PANDetectedObservation *)createDetectedObservation
 {
     [NSException raise:NSInternalInconsistencyException format:@"PANObservation createDetectedObservation should not be called"];
     return [PANDetectedObservation new];
 }
 
+- (PAN_nullable id)indexSubkey
+{
+    return nil;
+}
+
++ (Class)indexClass
+{
+    Class indexClass = self;
+    while (indexClass != [PANObservation class] && [indexClass superclass] != [PANObservation class])
+        indexClass = [indexClass superclass];
+    return indexClass;
+}
+
 - (void)registerInternal
 {
     [NSException raise:NSInternalInconsistencyException format:@"PANObservation registerInternal should not be called"];
@@ -241,100 +1138,76 @@ static NSMutableSet *classesSwizzledSet = nil;
 - (void)storeAssociatedObservation
 {
     NSAssert1(self.observer != nil || self.observee != nil, @"Nil 'observer' & 'observee' properties when storing observation %@", self);
+    // the same index key goes into both, find methods look in the observer's registry if there is one, otherwise the observee's
+    id subkey = [self indexSubkey];
+    PANObservationIndexKey *key = subkey != nil ? [PANObservationIndexKey keyWithClass:[[self class] indexClass] observer:self.observer observee:self.observee subkey:subkey] : nil;
     // store into *both* observer & observee, although that may not be obvious
     // of course we want to remove the observation if the observer goes away, but also if the observee does too
     if (self.observer != nil)
-        [[self class] storeAssociatedObservation:self intoObject:self.observer];
+        [[self class] storeAssociatedObservation:self intoObject:self.observer indexKey:key];
     if (self.observee != nil && self.observee != self.observer)
-        [[self class] storeAssociatedObservation:self intoObject:self.observee];
+        [[self class] storeAssociatedObservation:self intoObject:self.observee indexKey:key];
 }
 
 - (void)removeAssociatedObservation
 {
-    NSAssert1(self.observer != nil || self.observee != nil, @"Nil 'observer' & 'observee' properties when removing observation %@", self);
+    // both may be nil when removed automatically while the only object involved is being deallocated, its own
+    // registry is already on its way out then so there's nothing to remove the observation from
     if (self.observer != nil)
         [[self class] removeAssociatedObservation:self fromObject:self.observer];
     if (self.observee != nil && self.observee != self.observer)
         [[self class] removeAssociatedObservation:self fromObject:self.observee];
 }
 
-+ (void)storeAssociatedObservation:(PANObservation *)observation intoObject:(id)associationTarget
++ (void)storeAssociatedObservation:(PANObservation *)observation intoObject:(id)associationTarget indexKey:(PAN_nullable PANObservationIndexKey *)key
 {
-    NSMutableSet *observationSet = nil;
-    @synchronized(associationTarget) {
-        
-        observationSet = objc_getAssociatedObject(associationTarget, &PANObservationSetKey);
-        if (observationSet == nil) {
-            observationSet = [NSMutableSet set];
-            objc_setAssociatedObject(associationTarget, &PANObservationSetKey, observationSet, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
-        }
-        
-    }
-    @synchronized(observationSet) {
-        
-        [observationSet addObject:observation];
-        
-    }
+    [[PANObservationRegistry registryForObject:associationTarget] addObservation:observation indexKey:key];
 }
 
 + (void)removeAssociatedObservation:(PANObservation *)observation fromObject:(id)associationTarget
 {
-    NSMutableSet *observationSet = nil;
-    @synchronized(associationTarget) {
-        
-        observationSet = objc_getAssociatedObject(associationTarget, &PANObservationSetKey);
-        
-    }
-    if (observationSet != nil) {
-        @synchronized(observationSet) {
-            
-            [observationSet removeObject:observation];
-            // don't bother removing the set when its empty, would have to use another @synchronized(associationTarget) block
-            
-        }
-    }
+    // leave the registry attached when it becomes empty, it goes away along with its object
+    [[PANObservationRegistry existingRegistryForObject:associationTarget] removeObservation:observation];
 }
 
-+ (NSSet *)associatedObservationsForObserver:(id)observer
++ (PAN_nullable NSArray *)associatedObservationsForObserver:(id)observer
 {
     return [self associatedObservationsForObject:observer];
 }
 
-+ (NSSet *)associatedObservationsForObservee:(id)observee
++ (PAN_nullable NSArray *)associatedObservationsForObservee:(id)observee
 {
     return [self associatedObservationsForObject:observee];
 }
 
-+ (NSSet *)associatedObservationsForObserver:(PAN_nullable id)observer observee:(PAN_nullable id)observee
++ (PAN_nullable NSArray *)associatedObservationsForObserver:(PAN_nullable id)observer observee:(PAN_nullable id)observee
 {
     NSParameterAssert(observer != nil || observee != nil);
     return [self associatedObservationsForObject:observer != nil ? observer : observee]; // observer if its not nil, otherwise observee
 }
 
-+ (NSSet *)associatedObservationsForObject:(id)associationTarget
++ (PAN_nullable NSArray *)associatedObservationsForObject:(id)associationTarget
 {
-    NSMutableSet *observationSet = nil;
-    @synchronized(associationTarget) {
-        
-        observationSet = objc_getAssociatedObject(associationTarget, &PANObservationSetKey);
-        
-    }
-    if (observationSet != nil) {
-        @synchronized(observationSet) {
-            
-            observationSet = [observationSet copy];
-            
-        }
-    }
-    return observationSet;
+    // an immutable snapshot, no lock or copy needed
+    return [PANObservationRegistry existingRegistryForObject:associationTarget].observations;
+}
+
++ (PAN_nullable PANObservation *)findObservationForObserver:(PAN_nullable id)observer object:(PAN_nullable id)observee indexSubkey:(id)subkey
+{
+    NSParameterAssert(observer != nil || observee != nil);
+    // note, self here is class of subclass whose class method called this superclass class method, its family
+    // shares index keys so those of its subclasses are found too, but not those of its superclasses
+    PANObservationIndexKey *key = [PANObservationIndexKey keyWithClass:[self indexClass] observer:observer observee:observee subkey:subkey];
+    PANObservationRegistry *registry = [PANObservationRegistry existingRegistryForObject:observer != nil ? observer : observee];
+    return [registry observationForIndexKey:key kindOfClass:self];
 }
 
 + (PANObservation *)findObservationForObserver:(PAN_nullable id)observer object:(PAN_nullable id)observee matchingTest:(BOOL(^)(PANObservation *observation))testBlock
 {
     PANObservation *foundObservation = nil;
-    NSSet *observationSet = [self associatedObservationsForObserver:observer observee:observee];
+    NSArray *observations = [self associatedObservationsForObserver:observer observee:observee];
     
-    for (PANObservation *observation in observationSet) {
+    for (PANObservation *observation in observations) {
         // note, self here is class of subclass whose class method called this superclass class method
         // eg. if PANNotificationObservation class method called this, then self is PANNotificationObservation instead of PANObservation
         if ([observation isKindOfClass:self] && observer == observation.observer && observee == observation.observee && testBlock(observation)) {
@@ -351,12 +1224,18 @@ static NSMutableSet *classesSwizzledSet = nil;
 - (void)adoptAutomaticRemoval
 {
     NSAssert1(self.observer != nil || self.observee != nil, @"Nil 'observer' & 'observee' properties when adopting auto-removal for observation %@", self);
-    if (self.observer != nil)
-        [[self class] swizzleDeallocIfNeededForClass:[self.observer class]];
-    if (self.observee != nil && self.observee != self.observer)
+    // the registries stored into the observer & observee by storeAssociatedObservation remove their observations
+    // when they're released along with their objects, only a few kinds of observation must instead be removed
+    // before the observee's own dealloc runs, and only for those is its class's dealloc swizzled
+    if (self.observee != nil && [[self class] requiresRemovalBeforeObserveeDeallocates])
         [[self class] swizzleDeallocIfNeededForClass:[self.observee class]];
 }
 
++ (BOOL)requiresRemovalBeforeObserveeDeallocates
+{
+    return NO;
+}
+
 + (void)swizzleDeallocIfNeededForClass:(Class)class
 {
     static dispatch_once_t onceToken;
@@ -390,13 +1269,95 @@ static NSMutableSet *classesSwizzledSet = nil;
 
 + (void)performAutomaticRemovalForObject:(id)objectBeingDeallocated
 {
-    NSSet *observationSet = [self associatedObservationsForObject:objectBeingDeallocated]; // observations both by the object & on the object
-    for (PANObservation *observation in observationSet) {
-        if (observation.removeAutomatically)
-            [observation remove];
+    // observations both by the object & on the object
+    PANObservationRegistry *registry = [PANObservationRegistry existingRegistryForObject:objectBeingDeallocated];
+    NSArray *observations = [self observationsRemovedAutomatically:registry.observations];
+    if (observations.count == 0)
+        return;
+    [registry removeObservations:observations];
+    [self tearDownObservations:observations detachedFromObject:objectBeingDeallocated];
+}
+
++ (void)performAutomaticRemovalOfObservations:(PAN_nullable NSArray *)observations
+{
+    // the registry these came from is being deallocated, so there's no need to remove them from it
+    [self tearDownObservations:[self observationsRemovedAutomatically:observations] detachedFromObject:nil];
+}
+
++ (void)removeAllObservationsOfObject:(id)object
+{
+    NSArray *observations = [[PANObservationRegistry existingRegistryForObject:object] removeAllObservations];
+    [self tearDownObservations:observations detachedFromObject:object];
+}
+
++ (void)removeObservations:(NSArray *)observations
+{
+    [self tearDownObservations:observations detachedFromObject:nil];
+}
+
++ (PAN_nullable NSArray *)observationsRemovedAutomatically:(PAN_nullable NSArray *)observations
+{
+    NSIndexSet *indexes = [observations indexesOfObjectsPassingTest:^BOOL(PANObservation *observation, NSUInteger idx, BOOL *stop) {
+        return observation.removeAutomatically;
+    }];
+    return indexes.count == observations.count ? observations : [observations objectsAtIndexes:indexes];
+}
+
+static void addToMapTableArray(NSMapTable *mapTable, id key, id object)
+{
+    NSMutableArray *array = [mapTable objectForKey:key];
+    if (array == nil)
+        [mapTable setObject:[NSMutableArray arrayWithObject:object] forKey:key];
+    else
+        [array addObject:object];
+}
+
+// the equivalent of calling `remove` on each observation, for observations already taken out of the registry of
+// `object` (if any, it may be mid-dealloc and its weak references already nil). instead of each re-entering the
+// registries of both its observer & observee, deregistration is grouped by observation class and removal from
+// the registries of the other objects involved is grouped by object, taking each registry's lock once
++ (void)tearDownObservations:(PAN_nullable NSArray *)observations detachedFromObject:(PAN_nullable id)object
+{
+    if (observations.count == 0)
+        return;
+    
+    NSMapTable *observationsByClass = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality
+                                                            valueOptions:NSPointerFunctionsStrongMemory];
+    NSMapTable *observationsByOtherObject = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality
+                                                                  valueOptions:NSPointerFunctionsStrongMemory];
+    NSMutableArray *registeredObservations = [NSMutableArray arrayWithCapacity:observations.count];
+    
+    for (PANObservation *observation in observations) {
+        if (!observation.registered)
+            continue;
+        [registeredObservations addObject:observation];
+        addToMapTableArray(observationsByClass, [observation class], observation);
+        
+        id observer = observation.observer, observee = observation.observee;
+        if (observer != nil && observer != object)
+            addToMapTableArray(observationsByOtherObject, observer, observation);
+        if (observee != nil && observee != object && observee != observer)
+            addToMapTableArray(observationsByOtherObject, observee, observation);
+    }
+    
+    for (id class in observationsByClass)
+        [(Class)class deregisterObservations:[observationsByClass objectForKey:class]];
+    
+    for (id otherObject in observationsByOtherObject)
+        [[PANObservationRegistry existingRegistryForObject:otherObject] removeObservations:[observationsByOtherObject objectForKey:otherObject]];
+    
+    for (PANObservation *observation in registeredObservations) {
+        [observation cancelRateLimiting];
+        observation.registered = NO;
     }
 }
 
++ (void)deregisterObservations:(NSArray *)observations
+{
+    for (PANObservation *observation in observations)
+        [observation deregisterInternal];
+}
+
 @end
 
 
@@ -406,9 +1367,89 @@ static NSMutableSet *classesSwizzledSet = nil;
 
 @synthesize object;
 @synthesize payload;
-@synthesize timestamp;
+@synthesize timestamp = _timestamp;
+@synthesize timestampNanoseconds = _timestampNanoseconds;
+
+- (NSDate *)timestamp
+{
+    if (_timestamp == nil && _timestampNanoseconds != 0)
+        _timestamp = PANDateFromTimestampNanoseconds(_timestampNanoseconds);
+    return _timestamp;
+}
+
+- (void)setTimestamp:(NSDate *)date
+{
+    _timestamp = date;
+    _timestampNanoseconds = PANTimestampNanosecondsFromDate(date);
+}
+
+- (void)setTimestampNanoseconds:(uint64_t)nanoseconds
+{
+    _timestampNanoseconds = nanoseconds;
+    _timestamp = nil;
+}
 
 @end
 
 
+#pragma mark -
+
+// runs on the observation's gcdQueue with a +1 observation
+static void PANDrainMailbox(void *context)
+{
+    PANObservation *observation = CFBridgingRelease(context);
+    [observation drainMailbox];
+}
+
+// runs on the observation's queue, or directly, with a +1 snapshot made by -triggerEvent:synchronously:
+static void PANDeliverPooledSnapshot(void *context)
+{
+    __unsafe_unretained PANObservation *snapshot = (__bridge PANObservation *)context;
+    [snapshot invokeBlock];
+    
+    // the block says if it's keeping the snapshot, a reference it holds can't be told apart from others reliably
+    PANObservation *source = snapshot.snapshotSource;
+    if (source != nil && !snapshot.snapshotKept)
+        [source recyclePooledSnapshot:snapshot];
+    CFRelease(context);
+}
+
+static mach_timebase_info_data_t timebaseInfo;
+static uint64_t referenceNanoseconds;
+static NSTimeInterval referenceTimeInterval; // since reference date, taken at the same moment as referenceNanoseconds
+
+static void setupTimestampClock(void)
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebaseInfo);
+        referenceTimeInterval = [NSDate timeIntervalSinceReferenceDate];
+        referenceNanoseconds = mach_absolute_time() * timebaseInfo.numer / timebaseInfo.denom;
+    });
+}
+
+uint64_t PANTimestampNanosecondsNow(void)
+{
+    setupTimestampClock();
+    return mach_absolute_time() * timebaseInfo.numer / timebaseInfo.denom;
+}
+
+// dates are derived from the clock offset at first use, so later changes to the wall clock aren't reflected
+static NSDate *PANDateFromTimestampNanoseconds(uint64_t nanoseconds)
+{
+    setupTimestampClock();
+    NSTimeInterval offset = ((double)nanoseconds - (double)referenceNanoseconds) / NSEC_PER_SEC;
+    return [NSDate dateWithTimeIntervalSinceReferenceDate:referenceTimeInterval + offset];
+}
+
+uint64_t PANTimestampNanosecondsFromDate(NSDate *date)
+{
+    if (date == nil)
+        return 0;
+    setupTimestampClock();
+    double nanoseconds = (double)referenceNanoseconds + (date.timeIntervalSinceReferenceDate - referenceTimeInterval) * NSEC_PER_SEC;
+    return nanoseconds > 1.0 ? (uint64_t)nanoseconds : 1; // 0 means no timestamp
+}
+
+
 PAN_ASSUME_NONNULL_END
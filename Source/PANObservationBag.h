@@ -0,0 +1,71 @@
+//
+//  PANObservationBag.h
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-25.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "PANObservation.h"
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+/**
+ *  A container owning a group of observations so that they can be paused, resumed, made inactive or removed
+ *  together, such as all those made by a screen which pause & resume as it's hidden & shown.
+ *
+ *  Each of these is done with a single pass over the observations while holding the bag's lock once, instead of
+ *  finding each observation and changing it separately. When resuming, the triggers collected by all the
+ *  observations are delivered with one hop onto each queue they use, instead of one per observation.
+ *
+ *  Observations stopped some other way, such as by being removed automatically, are dropped from the bag the next
+ *  time it changes them all.
+ *
+ *  The observations are removed when the bag is deallocated.
+ */
+@interface PANObservationBag : NSObject
+
+/**
+ *  Add an observation to the bag. It's given the bag's current `paused` and `inactive` states if they're `YES`.
+ *  Accepts `nil` for convenience with the `pan_observe...` methods, ignored like observations already in the bag.
+ *
+ *  @param observation The observation to add.
+ */
+- (void)addObservation:(PAN_nullable PANObservation *)observation;
+
+/**
+ *  Remove the given observation, as `-[PANObservation remove]` does, and take it out of the bag.
+ *
+ *  @param observation An observation in the bag.
+ */
+- (void)removeObservation:(PANObservation *)observation;
+
+/**
+ *  Remove all the observations in the bag in one pass, leaving the bag empty.
+ */
+- (void)removeAllObservations;
+
+/**
+ *  The observations currently in the bag, in the order they were added.
+ */
+@property (nonatomic, readonly) PAN_ARRAY(PANObservation) *observations;
+
+/**
+ *  Set to pause or resume all the observations in the bag. Observations already in the state being set are left
+ *  alone, so triggers they've collected aren't lost. Same as `-[PANObservation paused]` otherwise.
+ */
+@property (nonatomic) BOOL paused;
+
+/**
+ *  Set to make all the observations in the bag inactive, or active again. An inactive observation collects
+ *  triggers the same as a paused one, but the two are independent: collected triggers are only delivered once an
+ *  observation is neither paused nor inactive. Intended for when the app is made inactive.
+ */
+@property (nonatomic) BOOL inactive;
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
@@ -0,0 +1,181 @@
+//
+//  PANObservationBag.m
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-25.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANObservationBag.h"
+#import "PANObservation+Private.h"
+#import <pthread.h>
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+@implementation PANObservationBag
+{
+    pthread_mutex_t _lock;
+    NSMutableArray *_observations; // guarded by _lock, as are _paused & _inactive
+}
+
+@synthesize paused = _paused;
+@synthesize inactive = _inactive;
+
+- (instancetype)init
+{
+    if (!(self = [super init]))
+        return nil;
+    pthread_mutex_init(&_lock, NULL);
+    _observations = [NSMutableArray array];
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_observations.count > 0)
+        [PANObservation removeObservations:_observations];
+    pthread_mutex_destroy(&_lock);
+}
+
+- (void)addObservation:(PAN_nullable PANObservation *)observation
+{
+    if (observation == nil)
+        return;
+
+    pthread_mutex_lock(&_lock);
+
+    dispatch_block_t delivery = nil;
+    if ([_observations indexOfObjectIdenticalTo:observation] == NSNotFound) {
+        [_observations addObject:observation];
+        // only ever moving into the paused or inactive state, so there's never a delivery to make
+        if (_paused && !observation.paused)
+            delivery = [observation setPausedDeferringDelivery:YES];
+        if (_inactive && !observation.inactive)
+            delivery = [observation setInactiveDeferringDelivery:YES];
+    }
+
+    pthread_mutex_unlock(&_lock);
+    NSAssert(delivery == nil, @"Unexpected delivery from pausing %@", observation);
+}
+
+- (void)removeObservation:(PANObservation *)observation
+{
+    pthread_mutex_lock(&_lock);
+    [_observations removeObjectIdenticalTo:observation];
+    pthread_mutex_unlock(&_lock);
+
+    [observation remove];
+}
+
+- (void)removeAllObservations
+{
+    pthread_mutex_lock(&_lock);
+    NSArray *observations = [_observations copy];
+    [_observations removeAllObjects];
+    pthread_mutex_unlock(&_lock);
+
+    [PANObservation removeObservations:observations];
+}
+
+- (NSArray *)observations
+{
+    pthread_mutex_lock(&_lock);
+    NSArray *observations = [_observations copy];
+    pthread_mutex_unlock(&_lock);
+    return observations;
+}
+
+- (BOOL)paused
+{
+    pthread_mutex_lock(&_lock);
+    BOOL paused = _paused;
+    pthread_mutex_unlock(&_lock);
+    return paused;
+}
+
+- (BOOL)inactive
+{
+    pthread_mutex_lock(&_lock);
+    BOOL inactive = _inactive;
+    pthread_mutex_unlock(&_lock);
+    return inactive;
+}
+
+- (void)setPaused:(BOOL)paused
+{
+    [self changeObservationsUsing:^dispatch_block_t(PANObservation *observation) {
+        return observation.paused != paused ? [observation setPausedDeferringDelivery:paused] : nil;
+    } afterSetting:^{
+        self->_paused = paused;
+    }];
+}
+
+- (void)setInactive:(BOOL)inactive
+{
+    [self changeObservationsUsing:^dispatch_block_t(PANObservation *observation) {
+        return observation.inactive != inactive ? [observation setInactiveDeferringDelivery:inactive] : nil;
+    } afterSetting:^{
+        self->_inactive = inactive;
+    }];
+}
+
+// one pass over the observations with the lock held, pruning any that have been removed meanwhile, then once the
+// lock is released, one dispatch per distinct queue running all the deliveries for observations using that queue
+- (void)changeObservationsUsing:(PAN_nullable dispatch_block_t (^)(PANObservation *observation))change afterSetting:(void (^)(void))set
+{
+    NSMapTable *deliveriesByQueue = nil;
+
+    pthread_mutex_lock(&_lock);
+
+    set();
+    NSMutableIndexSet *removedIndexes = nil;
+    NSUInteger index = 0;
+    for (PANObservation *observation in _observations) {
+        if (!observation.registered) {
+            if (removedIndexes == nil)
+                removedIndexes = [NSMutableIndexSet indexSet];
+            [removedIndexes addIndex:index++];
+            continue;
+        }
+        index++;
+
+        dispatch_block_t delivery = change(observation);
+        if (delivery == nil)
+            continue;
+
+        if (deliveriesByQueue == nil)
+            deliveriesByQueue = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality
+                                                      valueOptions:NSPointerFunctionsStrongMemory];
+        id queue = observation.queue != nil ? observation.queue : observation.gcdQueue != nil ? (id)observation.gcdQueue : [NSNull null];
+        NSMutableArray *deliveries = [deliveriesByQueue objectForKey:queue];
+        if (deliveries == nil)
+            [deliveriesByQueue setObject:[NSMutableArray arrayWithObject:delivery] forKey:queue];
+        else
+            [deliveries addObject:delivery];
+    }
+    if (removedIndexes != nil)
+        [_observations removeObjectsAtIndexes:removedIndexes];
+
+    pthread_mutex_unlock(&_lock);
+
+    for (id queue in deliveriesByQueue) {
+        NSArray *deliveries = [deliveriesByQueue objectForKey:queue];
+        void (^deliverAll)(void) = ^{
+            for (dispatch_block_t delivery in deliveries)
+                delivery();
+        };
+
+        if ([queue isKindOfClass:[NSOperationQueue class]])
+            [(NSOperationQueue *)queue addOperationWithBlock:deliverAll];
+        else if (queue != [NSNull null])
+            dispatch_async((dispatch_queue_t)queue, deliverAll);
+        else
+            deliverAll();
+    }
+}
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
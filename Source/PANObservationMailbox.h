@@ -0,0 +1,61 @@
+//
+//  PANObservationMailbox.h
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-22.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+//  A lock-free multi-producer, single-consumer queue of triggers waiting to be delivered on an observation's
+//  queue. Intrusive, nodes are embedded in the objects being queued so pushing allocates nothing. Based on Dmitry
+//  Vyukov's non-intrusive MPSC node-based queue, plus a count of pending nodes which tells a producer when the
+//  mailbox went from empty to non-empty and so a drain needs to be scheduled, and tells the drain when to stop.
+//
+//  Any thread may push, only one drain may pop at a time, which the pending count guarantees if drains are only
+//  scheduled when push returns YES and only stop when PANMailboxFinishedNodes returns NO.
+
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+#import "PANDefines.h"
+
+
+typedef struct PANMailboxNode {
+    struct PANMailboxNode * _Atomic next;
+    void *item; // +1 retained while queued
+} PANMailboxNode;
+
+typedef struct PANMailbox {
+    PANMailboxNode * _Atomic head;  // most recently pushed, producers exchange this
+    PANMailboxNode *tail;           // next to pop, only touched by the drain
+    PANMailboxNode stub;
+    atomic_uint_fast32_t pending;
+} PANMailbox;
+
+
+PAN_ASSUME_NONNULL_BEGIN
+
+extern void PANMailboxInit(PANMailbox *mailbox);
+
+/**
+ *  Push a node with its item already set. Returns `YES` if the mailbox was empty, in which case the caller must
+ *  schedule a drain.
+ */
+extern BOOL PANMailboxPush(PANMailbox *mailbox, PANMailboxNode *node);
+
+/**
+ *  Pop the oldest node, to be called only by a drain while there's a pending node. If a producer is part way
+ *  through pushing it, waits for it to finish.
+ */
+extern PANMailboxNode *PANMailboxPop(PANMailbox *mailbox);
+
+/**
+ *  Number of nodes pushed and not yet finished, so the drain can pop this many without waiting on producers
+ *  for anything but completing their push.
+ */
+extern NSUInteger PANMailboxPendingCount(PANMailbox *mailbox);
+
+/**
+ *  Call after handling popped nodes. Returns `YES` if more are pending and the drain should continue.
+ */
+extern BOOL PANMailboxFinishedNodes(PANMailbox *mailbox, NSUInteger count);
+
+PAN_ASSUME_NONNULL_END
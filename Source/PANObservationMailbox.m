@@ -0,0 +1,80 @@
+//
+//  PANObservationMailbox.m
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-22.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANObservationMailbox.h"
+#import <sched.h>
+
+
+void PANMailboxInit(PANMailbox *mailbox)
+{
+    atomic_init(&mailbox->stub.next, NULL);
+    mailbox->stub.item = NULL;
+    atomic_init(&mailbox->head, &mailbox->stub);
+    mailbox->tail = &mailbox->stub;
+    atomic_init(&mailbox->pending, 0);
+}
+
+static void PANMailboxLink(PANMailbox *mailbox, PANMailboxNode *node)
+{
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+    PANMailboxNode *previous = atomic_exchange_explicit(&mailbox->head, node, memory_order_acq_rel);
+    // between the exchange and this store the queue is briefly disconnected, see PANMailboxPop
+    atomic_store_explicit(&previous->next, node, memory_order_release);
+}
+
+BOOL PANMailboxPush(PANMailbox *mailbox, PANMailboxNode *node)
+{
+    PANMailboxLink(mailbox, node);
+    return atomic_fetch_add(&mailbox->pending, 1) == 0;
+}
+
+// returns NULL if the next node isn't linked in yet
+static PANMailboxNode *PANMailboxTryPop(PANMailbox *mailbox)
+{
+    PANMailboxNode *tail = mailbox->tail;
+    PANMailboxNode *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (tail == &mailbox->stub) {
+        if (next == NULL)
+            return NULL;
+        mailbox->tail = tail = next;
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    }
+    if (next != NULL) {
+        mailbox->tail = next;
+        return tail;
+    }
+    if (tail != atomic_load_explicit(&mailbox->head, memory_order_acquire))
+        return NULL; // a push is in progress
+    // tail is the last node, put the stub behind it so it can be unlinked
+    PANMailboxLink(mailbox, &mailbox->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next != NULL) {
+        mailbox->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+PANMailboxNode *PANMailboxPop(PANMailbox *mailbox)
+{
+    // the pending count says a node was pushed, it just may not be linked yet
+    PANMailboxNode *node;
+    while ((node = PANMailboxTryPop(mailbox)) == NULL)
+        sched_yield();
+    return node;
+}
+
+NSUInteger PANMailboxPendingCount(PANMailbox *mailbox)
+{
+    return (NSUInteger)atomic_load(&mailbox->pending);
+}
+
+BOOL PANMailboxFinishedNodes(PANMailbox *mailbox, NSUInteger count)
+{
+    return atomic_fetch_sub(&mailbox->pending, count) > count;
+}
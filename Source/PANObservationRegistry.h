@@ -0,0 +1,108 @@
+//
+//  PANObservationRegistry.h
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-16.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+//  Per-object storage for the observations made by or on an object, attached to that object as an associated
+//  object. Replaces the @synchronized-guarded NSMutableSet that was used previously.
+//
+//  Mutations are serialized with a per-registry mutex: observations are kept in a map table, plus a secondary
+//  index from a `PANObservationIndexKey` to the observation for look-ups by `pan_stopObserving...` and the like.
+//  Each mutation publishes an immutable copy of both, an array and a dictionary, with an atomic pointer swap, so
+//  enumerating and looking up never lock or copy. A copy being replaced is only released once no reader could
+//  still be in the middle of picking it up, otherwise it's retired until the last reader leaves, or a later write
+//  sees none.
+
+#import <Foundation/Foundation.h>
+#import "PANDefines.h"
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+@class PANObservation;
+
+/**
+ *  Key identifying an observation in the registry index: the observation's class, the observer & observee
+ *  pointers, and a subclass-specific key such as a notification name or an array of key paths.
+ *
+ *  Observer and observee are compared by pointer only and aren't retained. Array subkeys are hashed by element,
+ *  not just by count like `-[NSArray hash]`.
+ */
+@interface PANObservationIndexKey : NSObject <NSCopying>
+
++ (instancetype)keyWithClass:(Class)observationClass observer:(PAN_nullable id)observer observee:(PAN_nullable id)observee subkey:(id)subkey;
+
+@end
+
+
+@interface PANObservationRegistry : NSObject
+
+/**
+ *  Returns the registry attached to an object, or `nil` if no observation has ever been stored into it.
+ *  Doesn't lock.
+ *
+ *  @param object The observer or observee object.
+ *
+ *  @return The object's registry, or `nil`.
+ */
++ (PAN_nullable instancetype)existingRegistryForObject:(id)object;
+
+/**
+ *  Returns the registry attached to an object, creating and attaching one if needed. Creation is guarded by a
+ *  small table of striped locks selected by the object's address, instead of the global @synchronized table.
+ *
+ *  @param object The observer or observee object.
+ *
+ *  @return The object's registry.
+ */
++ (instancetype)registryForObject:(id)object;
+
+/**
+ *  Add an observation to the registry, ignored if already present.
+ *
+ *  @param observation The observation.
+ *  @param key         Key for finding the observation with `observationForIndexKey:kindOfClass:`, or `nil` if it doesn't
+ *                     need to be found that way. The registry remembers it for removing the observation.
+ */
+- (void)addObservation:(PANObservation *)observation indexKey:(PAN_nullable PANObservationIndexKey *)key;
+
+/**
+ *  Remove an observation from the registry, ignored if not present.
+ */
+- (void)removeObservation:(PANObservation *)observation;
+
+/**
+ *  Remove several observations from the registry, taking its lock once. Those not present are ignored.
+ */
+- (void)removeObservations:(PAN_ARRAY(PANObservation) *)observations;
+
+/**
+ *  Empty the registry, taking its lock once.
+ *
+ *  @return The observations that were in the registry, or `nil` if it was already empty.
+ */
+- (PAN_nullable PAN_ARRAY(PANObservation) *)removeAllObservations;
+
+/**
+ *  Look-up an observation by the key it was added with. If multiple observations of the class were added with
+ *  equal keys, returns the earliest one still in the registry. Doesn't lock.
+ *
+ *  @param key              The index key.
+ *  @param observationClass The class the observation must be an instance of, or of a subclass of.
+ *
+ *  @return The matching observation, or `nil`.
+ */
+- (PAN_nullable PANObservation *)observationForIndexKey:(PANObservationIndexKey *)key kindOfClass:(Class)observationClass;
+
+/**
+ *  The current immutable snapshot of the registry's observations, in no particular order, or `nil` if there are
+ *  none. Doesn't lock or copy. Safe to enumerate while other threads add or remove observations.
+ */
+@property (nonatomic, readonly, PAN_nullable) PAN_ARRAY(PANObservation) *observations;
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
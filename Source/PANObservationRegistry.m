@@ -0,0 +1,313 @@
+//
+//  PANObservationRegistry.m
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-16.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANObservationRegistry.h"
+#import "PANObservation+Private.h"
+#import <objc/runtime.h>
+#import <pthread.h>
+#import <stdatomic.h>
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+static const int PANObservationRegistryKeyVar;
+static void *PANObservationRegistryKey = (void *)&PANObservationRegistryKeyVar;
+
+// only used when attaching a new registry to an object, stripes avoid having every object contend on one lock
+#define PAN_REGISTRY_CREATION_STRIPES 16
+static pthread_mutex_t registryCreationLocks[PAN_REGISTRY_CREATION_STRIPES] = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER
+};
+
+static inline pthread_mutex_t *creationLockForObject(id object)
+{
+    uintptr_t address = (uintptr_t)(__bridge void *)object;
+    return &registryCreationLocks[(address >> 4) % PAN_REGISTRY_CREATION_STRIPES]; // low bits are alignment
+}
+
+
+@implementation PANObservationIndexKey
+{
+    Class _observationClass;
+    const void *_observer;
+    const void *_observee;
+    id _subkey;
+    NSUInteger _hash;
+}
+
++ (instancetype)keyWithClass:(Class)observationClass observer:(PAN_nullable id)observer observee:(PAN_nullable id)observee subkey:(id)subkey
+{
+    PANObservationIndexKey *key = [[self alloc] init];
+    key->_observationClass = observationClass;
+    key->_observer = (__bridge const void *)observer;
+    key->_observee = (__bridge const void *)observee;
+    key->_subkey = subkey;
+    
+    NSUInteger hash = (NSUInteger)(__bridge void *)observationClass ^ ((uintptr_t)key->_observer >> 4) ^ ((uintptr_t)key->_observee << 5);
+    if ([subkey isKindOfClass:[NSArray class]]) {
+        for (id element in (NSArray *)subkey)
+            hash = hash * 31 + [element hash];
+    }
+    else {
+        hash = hash * 31 + [subkey hash];
+    }
+    key->_hash = hash;
+    return key;
+}
+
+- (id)copyWithZone:(PAN_nullable NSZone *)zone
+{
+    return self; // immutable
+}
+
+- (NSUInteger)hash
+{
+    return _hash;
+}
+
+- (BOOL)isEqual:(id)other
+{
+    if (other == self)
+        return YES;
+    if (![other isKindOfClass:[PANObservationIndexKey class]])
+        return NO;
+    PANObservationIndexKey *otherKey = other;
+    return _hash == otherKey->_hash && _observationClass == otherKey->_observationClass && _observer == otherKey->_observer
+        && _observee == otherKey->_observee && [_subkey isEqual:otherKey->_subkey];
+}
+
+@end
+
+
+#pragma mark -
+
+// what readers see, replaced as a whole by every mutation and never changed once published
+@interface PANObservationRegistryState : NSObject
+{
+    @public
+    NSArray *_observations; // nil when empty
+    NSDictionary *_index;   // index key -> observation, or an immutable array of them for equal keys
+}
+@end
+
+@implementation PANObservationRegistryState
+@end
+
+
+@implementation PANObservationRegistry
+{
+    pthread_mutex_t _writeLock;
+    _Atomic(void *) _state;            // +1 retained PANObservationRegistryState, never NULL
+    atomic_uint_fast32_t _readers;     // readers between loading _state and retaining what they read from it
+    atomic_bool _hasRetired;           // so readers can tell without the lock if there's anything to release
+    NSMutableArray *_retiredStates;    // replaced but maybe still being read, guarded by _writeLock
+    NSMapTable *_members;              // observation -> its index key or NSNull, guarded by _writeLock
+    NSMutableDictionary *_index;       // as published in the state, values replaced rather than mutated, guarded by _writeLock
+}
+
++ (PAN_nullable instancetype)existingRegistryForObject:(id)object
+{
+    return objc_getAssociatedObject(object, PANObservationRegistryKey);
+}
+
++ (instancetype)registryForObject:(id)object
+{
+    PANObservationRegistry *registry = objc_getAssociatedObject(object, PANObservationRegistryKey);
+    if (registry != nil)
+        return registry;
+
+    pthread_mutex_t *lock = creationLockForObject(object);
+    pthread_mutex_lock(lock);
+
+    registry = objc_getAssociatedObject(object, PANObservationRegistryKey);
+    if (registry == nil) {
+        registry = [[self alloc] init];
+        objc_setAssociatedObject(object, PANObservationRegistryKey, registry, OBJC_ASSOCIATION_RETAIN);
+    }
+
+    pthread_mutex_unlock(lock);
+    return registry;
+}
+
+- (instancetype)init
+{
+    if (!(self = [super init]))
+        return nil;
+    pthread_mutex_init(&_writeLock, NULL);
+    PANObservationRegistryState *state = [[PANObservationRegistryState alloc] init];
+    state->_index = @{};
+    atomic_init(&_state, (void *)CFBridgingRetain(state));
+    atomic_init(&_readers, 0);
+    atomic_init(&_hasRetired, false);
+    _members = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality
+                                     valueOptions:NSPointerFunctionsStrongMemory];
+    _index = [NSMutableDictionary dictionary];
+    return self;
+}
+
+- (void)dealloc
+{
+    // released along with the object it's associated with, so it doubles as the sentinel for automatic removal,
+    // costing nothing for objects that never had an observation
+    if (_members.count > 0)
+        [PANObservation performAutomaticRemovalOfObservations:[[_members keyEnumerator] allObjects]];
+    
+    CFRelease(atomic_exchange(&_state, NULL));
+    pthread_mutex_destroy(&_writeLock);
+}
+
+// the reader count keeps a writer from releasing the state between a reader's load and retaining what it reads
+- (void)endRead
+{
+    // the last reader out releases states retired meanwhile, unless a writer has the lock, then whichever of the
+    // writer or a later reader next sees no readers does
+    if (atomic_fetch_sub(&_readers, 1) == 1 && atomic_load(&_hasRetired) && pthread_mutex_trylock(&_writeLock) == 0)
+        [self unlockWriteLock];
+}
+
+- (PAN_nullable NSArray *)observations
+{
+    atomic_fetch_add(&_readers, 1);
+    PANObservationRegistryState * __unsafe_unretained state = (__bridge PANObservationRegistryState *)atomic_load(&_state);
+    NSArray *observations = state->_observations;
+    [self endRead];
+    return observations;
+}
+
+- (PAN_nullable PANObservation *)observationForIndexKey:(PANObservationIndexKey *)key kindOfClass:(Class)observationClass
+{
+    atomic_fetch_add(&_readers, 1);
+    PANObservationRegistryState * __unsafe_unretained state = (__bridge PANObservationRegistryState *)atomic_load(&_state);
+    id found = state->_index[key];
+    [self endRead];
+    
+    if ([found isKindOfClass:[NSArray class]]) {
+        for (PANObservation *observation in (NSArray *)found) {
+            if ([observation isKindOfClass:observationClass])
+                return observation;
+        }
+        return nil;
+    }
+    return [found isKindOfClass:observationClass] ? found : nil;
+}
+
+- (void)addObservation:(PANObservation *)observation indexKey:(PAN_nullable PANObservationIndexKey *)key
+{
+    pthread_mutex_lock(&_writeLock);
+
+    if ([_members objectForKey:observation] == nil) {
+        [_members setObject:key != nil ? key : [NSNull null] forKey:observation];
+        if (key != nil) {
+            id existing = _index[key];
+            if (existing == nil)
+                _index[key] = observation;
+            else if ([existing isKindOfClass:[NSArray class]])
+                _index[key] = [(NSArray *)existing arrayByAddingObject:observation];
+            else
+                _index[key] = @[existing, observation];
+        }
+        [self publishState];
+    }
+
+    [self unlockWriteLock];
+}
+
+- (void)removeObservation:(PANObservation *)observation
+{
+    pthread_mutex_lock(&_writeLock);
+    if ([self removeObservationLocked:observation])
+        [self publishState];
+    [self unlockWriteLock];
+}
+
+- (void)removeObservations:(NSArray *)observations
+{
+    pthread_mutex_lock(&_writeLock);
+    BOOL removed = NO;
+    for (PANObservation *observation in observations)
+        removed = [self removeObservationLocked:observation] || removed;
+    if (removed)
+        [self publishState];
+    [self unlockWriteLock];
+}
+
+- (PAN_nullable NSArray *)removeAllObservations
+{
+    pthread_mutex_lock(&_writeLock);
+
+    NSArray *removed = nil;
+    if (_members.count > 0) {
+        removed = [[_members keyEnumerator] allObjects];
+        [_members removeAllObjects];
+        [_index removeAllObjects];
+        [self publishState];
+    }
+
+    [self unlockWriteLock];
+    return removed;
+}
+
+// called with _writeLock held, returns YES if the observation was present
+- (BOOL)removeObservationLocked:(PANObservation *)observation
+{
+    id key = [_members objectForKey:observation];
+    if (key == nil)
+        return NO;
+    
+    [_members removeObjectForKey:observation];
+    if (key != [NSNull null]) {
+        id existing = _index[key];
+        if ([existing isKindOfClass:[NSArray class]]) {
+            NSMutableArray *observationsWithKey = [(NSArray *)existing mutableCopy]; // only ever a few with equal keys
+            [observationsWithKey removeObjectIdenticalTo:observation];
+            _index[key] = observationsWithKey.count == 1 ? observationsWithKey.firstObject : [observationsWithKey copy];
+        }
+        else if (existing == observation) {
+            [_index removeObjectForKey:key];
+        }
+    }
+    return YES;
+}
+
+// called with _writeLock held after every mutation, so readers only ever load what's published
+- (void)publishState
+{
+    PANObservationRegistryState *state = [[PANObservationRegistryState alloc] init];
+    state->_observations = _members.count > 0 ? [[_members keyEnumerator] allObjects] : nil;
+    state->_index = [_index copy];
+    void *replaced = atomic_exchange(&_state, (void *)CFBridgingRetain(state));
+    if (_retiredStates == nil)
+        _retiredStates = [NSMutableArray array];
+    [_retiredStates addObject:CFBridgingRelease(replaced)];
+    atomic_store(&_hasRetired, true);
+}
+
+// unlocks _writeLock, releasing the retired states if nobody can still be reading them. any reader that increments
+// the count after a state was replaced can only load its replacement, so if the count is zero now nobody can be
+// holding an unretained pointer to a retired one. they're released after unlocking, since that can release the
+// last reference to an observation
+- (void)unlockWriteLock
+{
+    CFTypeRef retired = NULL;
+    if (atomic_load(&_hasRetired) && atomic_load(&_readers) == 0) {
+        retired = CFBridgingRetain(_retiredStates);
+        _retiredStates = nil;
+        atomic_store(&_hasRetired, false);
+    }
+    pthread_mutex_unlock(&_writeLock);
+    if (retired != NULL)
+        CFRelease(retired);
+}
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
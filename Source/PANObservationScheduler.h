@@ -0,0 +1,82 @@
+//
+//  PANObservationScheduler.h
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-24.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+//  The one timer facility behind rate limited observations. Keeps a heap of deadlines, each target having at most
+//  one, served by a single GCD timer source instead of a timer per observation. Targets are retained until their
+//  deadline passes or they're cancelled.
+//
+//  Time can be made virtual for testing, then it only advances when told to, firing deadlines on the calling
+//  thread as it passes them.
+
+#import <Foundation/Foundation.h>
+#import "PANDefines.h"
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+@class PANObservationScheduler;
+
+@protocol PANObservationSchedulerTarget <NSObject>
+/**
+ *  Called on the scheduler's private queue, or for virtual time the thread advancing the time, once the target's
+ *  deadline has passed. The target can schedule itself again from within this.
+ */
+- (void)schedulerDeadlineReached:(PANObservationScheduler *)scheduler;
+
+/**
+ *  Where the scheduler keeps the target's deadline, so rescheduling and cancelling don't search for it. Only for
+ *  the scheduler's use, changed with its lock held. Must be `NSNotFound` until first scheduled.
+ */
+@property (nonatomic) NSUInteger schedulerHeapIndex;
+@end
+
+
+@interface PANObservationScheduler : NSObject
+
+/**
+ *  The scheduler used by all observations, one using real time unless replaced.
+ */
++ (PANObservationScheduler *)sharedScheduler;
+
+/**
+ *  Replace the shared scheduler, for tests to substitute one using virtual time. Pass `nil` to go back to one
+ *  using real time. Deadlines already scheduled stay with the previous scheduler.
+ */
++ (void)setSharedScheduler:(PAN_nullable PANObservationScheduler *)scheduler;
+
+/**
+ *  A scheduler using virtual time, starting at 1 nanosecond.
+ */
+- (instancetype)initWithVirtualTime;
+
+@property (nonatomic, readonly) BOOL usesVirtualTime;
+
+/**
+ *  Current time in nanoseconds, the same clock as `PANTimestampNanosecondsNow()` unless virtual.
+ */
+@property (nonatomic, readonly) uint64_t nowNanoseconds;
+
+/**
+ *  Advance virtual time, synchronously calling targets whose deadlines pass in order of those deadlines, with
+ *  `nowNanoseconds` equal to each deadline during its call. Raises if not using virtual time.
+ */
+- (void)advanceTimeByNanoseconds:(uint64_t)nanoseconds;
+
+/**
+ *  Schedule a target's deadline, replacing any it already has.
+ */
+- (void)scheduleTarget:(id<PANObservationSchedulerTarget>)target atNanoseconds:(uint64_t)deadline;
+
+/**
+ *  Remove a target's deadline, if it has one.
+ */
+- (void)cancelTarget:(id<PANObservationSchedulerTarget>)target;
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
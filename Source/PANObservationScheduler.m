@@ -0,0 +1,267 @@
+//
+//  PANObservationScheduler.m
+//  Panopticon
+//
+//  Created by Pierre Houston on 2016-05-24.
+//  Copyright © 2016 Pierre Houston. All rights reserved.
+//
+
+#import "PANObservationScheduler.h"
+#import "PANObservation.h"
+#import <pthread.h>
+
+PAN_ASSUME_NONNULL_BEGIN
+
+
+static const uint64_t timerLeewayNanoseconds = NSEC_PER_MSEC;
+
+typedef struct {
+    uint64_t deadline;
+    uint64_t sequence;  // breaks ties so equal deadlines fire in the order scheduled
+    void *target;       // +1 retained
+} PANSchedulerEntry;
+
+static PANObservationScheduler *sharedScheduler = nil;
+static pthread_mutex_t sharedSchedulerLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+@implementation PANObservationScheduler
+{
+    pthread_mutex_t _lock;
+    PANSchedulerEntry *_heap;   // min-heap by deadline, guarded by _lock
+    NSUInteger _count;
+    NSUInteger _capacity;
+    uint64_t _nextSequence;
+    uint64_t _virtualNow;       // guarded by _lock
+    dispatch_queue_t _queue;    // real time only
+    dispatch_source_t _timer;
+    uint64_t _timerDeadline;    // what the timer is set to, 0 for never
+}
+
++ (PANObservationScheduler *)sharedScheduler
+{
+    pthread_mutex_lock(&sharedSchedulerLock);
+    if (sharedScheduler == nil)
+        sharedScheduler = [[PANObservationScheduler alloc] init];
+    PANObservationScheduler *scheduler = sharedScheduler;
+    pthread_mutex_unlock(&sharedSchedulerLock);
+    return scheduler;
+}
+
++ (void)setSharedScheduler:(PAN_nullable PANObservationScheduler *)scheduler
+{
+    pthread_mutex_lock(&sharedSchedulerLock);
+    sharedScheduler = scheduler; // a real time one is created again when next needed
+    pthread_mutex_unlock(&sharedSchedulerLock);
+}
+
+- (instancetype)init
+{
+    if (!(self = [super init]))
+        return nil;
+    pthread_mutex_init(&_lock, NULL);
+    _queue = dispatch_queue_create("com.panopticon.scheduler", DISPATCH_QUEUE_SERIAL);
+    _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+    typeof(self) __weak welf = self;
+    dispatch_source_set_event_handler(_timer, ^{
+        [welf fireDueTargets];
+    });
+    dispatch_source_set_timer(_timer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, timerLeewayNanoseconds);
+    dispatch_resume(_timer);
+    return self;
+}
+
+- (instancetype)initWithVirtualTime
+{
+    if (!(self = [super init]))
+        return nil;
+    pthread_mutex_init(&_lock, NULL);
+    _virtualNow = 1;
+    _usesVirtualTime = YES;
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_timer != nil)
+        dispatch_source_cancel(_timer);
+    for (NSUInteger i = 0; i < _count; i++) {
+        ((__bridge id<PANObservationSchedulerTarget>)_heap[i].target).schedulerHeapIndex = NSNotFound;
+        CFRelease(_heap[i].target);
+    }
+    free(_heap);
+    pthread_mutex_destroy(&_lock);
+}
+
+- (uint64_t)nowNanoseconds
+{
+    if (!self.usesVirtualTime)
+        return PANTimestampNanosecondsNow();
+    pthread_mutex_lock(&_lock);
+    uint64_t now = _virtualNow;
+    pthread_mutex_unlock(&_lock);
+    return now;
+}
+
+- (void)advanceTimeByNanoseconds:(uint64_t)nanoseconds
+{
+    if (!self.usesVirtualTime)
+        [NSException raise:NSInternalInconsistencyException format:@"Can't advance the time of scheduler %@ using real time", self];
+    
+    pthread_mutex_lock(&_lock);
+    uint64_t end = _virtualNow + nanoseconds;
+    while (_count > 0 && _heap[0].deadline <= end) {
+        PANSchedulerEntry entry = [self popEntry];
+        if (entry.deadline > _virtualNow)
+            _virtualNow = entry.deadline;
+        pthread_mutex_unlock(&_lock);
+        
+        id<PANObservationSchedulerTarget> target = CFBridgingRelease(entry.target);
+        [target schedulerDeadlineReached:self];
+        
+        pthread_mutex_lock(&_lock);
+    }
+    _virtualNow = end;
+    pthread_mutex_unlock(&_lock);
+}
+
+- (void)scheduleTarget:(id<PANObservationSchedulerTarget>)target atNanoseconds:(uint64_t)deadline
+{
+    pthread_mutex_lock(&_lock);
+    [self removeEntryForTarget:target];
+    
+    if (_count == _capacity) {
+        _capacity = _capacity > 0 ? _capacity * 2 : 16;
+        _heap = realloc(_heap, _capacity * sizeof(PANSchedulerEntry));
+    }
+    NSUInteger i = _count++;
+    placeEntry(_heap, i, (PANSchedulerEntry){ deadline, _nextSequence++, (void *)CFBridgingRetain(target) });
+    [self siftUp:i];
+    
+    [self updateTimer];
+    pthread_mutex_unlock(&_lock);
+}
+
+- (void)cancelTarget:(id<PANObservationSchedulerTarget>)target
+{
+    pthread_mutex_lock(&_lock);
+    [self removeEntryForTarget:target];
+    [self updateTimer];
+    pthread_mutex_unlock(&_lock);
+}
+
+- (void)fireDueTargets
+{
+    NSMutableArray *due = nil;
+    pthread_mutex_lock(&_lock);
+    uint64_t now = PANTimestampNanosecondsNow();
+    while (_count > 0 && _heap[0].deadline <= now) {
+        if (due == nil)
+            due = [NSMutableArray array];
+        [due addObject:CFBridgingRelease([self popEntry].target)];
+    }
+    _timerDeadline = 0;
+    [self updateTimer];
+    pthread_mutex_unlock(&_lock);
+    
+    for (id<PANObservationSchedulerTarget> target in due)
+        [target schedulerDeadlineReached:self];
+}
+
+
+#pragma mark - heap, all called with _lock held
+
+static inline BOOL entryPrecedes(PANSchedulerEntry *a, PANSchedulerEntry *b)
+{
+    return a->deadline < b->deadline || (a->deadline == b->deadline && a->sequence < b->sequence);
+}
+
+// every move of an entry goes through here, keeping its target's index up to date
+static inline void placeEntry(PANSchedulerEntry *heap, NSUInteger i, PANSchedulerEntry entry)
+{
+    heap[i] = entry;
+    ((__bridge id<PANObservationSchedulerTarget>)entry.target).schedulerHeapIndex = i;
+}
+
+static inline void swapEntries(PANSchedulerEntry *heap, NSUInteger i, NSUInteger j)
+{
+    PANSchedulerEntry swap = heap[i];
+    placeEntry(heap, i, heap[j]);
+    placeEntry(heap, j, swap);
+}
+
+- (void)siftUp:(NSUInteger)i
+{
+    while (i > 0) {
+        NSUInteger parent = (i - 1) / 2;
+        if (!entryPrecedes(&_heap[i], &_heap[parent]))
+            break;
+        swapEntries(_heap, i, parent);
+        i = parent;
+    }
+}
+
+- (void)siftDown:(NSUInteger)i
+{
+    while (YES) {
+        NSUInteger smallest = i, left = 2 * i + 1, right = left + 1;
+        if (left < _count && entryPrecedes(&_heap[left], &_heap[smallest]))
+            smallest = left;
+        if (right < _count && entryPrecedes(&_heap[right], &_heap[smallest]))
+            smallest = right;
+        if (smallest == i)
+            break;
+        swapEntries(_heap, i, smallest);
+        i = smallest;
+    }
+}
+
+// caller takes over the entry's +1 target
+- (PANSchedulerEntry)popEntry
+{
+    return [self takeEntryAtIndex:0];
+}
+
+- (PANSchedulerEntry)takeEntryAtIndex:(NSUInteger)i
+{
+    PANSchedulerEntry entry = _heap[i];
+    ((__bridge id<PANObservationSchedulerTarget>)entry.target).schedulerHeapIndex = NSNotFound;
+    if (i < --_count) {
+        placeEntry(_heap, i, _heap[_count]);
+        [self siftDown:i];
+        [self siftUp:i];
+    }
+    return entry;
+}
+
+// checks the target's index is into this heap, a target can have been left in a scheduler that's since been
+// replaced as the shared one
+- (void)removeEntryForTarget:(id<PANObservationSchedulerTarget>)target
+{
+    NSUInteger i = target.schedulerHeapIndex;
+    if (i < _count && _heap[i].target == (__bridge void *)target)
+        CFRelease([self takeEntryAtIndex:i].target);
+}
+
+- (void)updateTimer
+{
+    if (_timer == nil)
+        return;
+    uint64_t deadline = _count > 0 ? _heap[0].deadline : 0;
+    if (deadline == _timerDeadline)
+        return;
+    _timerDeadline = deadline;
+    if (deadline == 0) {
+        dispatch_source_set_timer(_timer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, timerLeewayNanoseconds);
+    }
+    else {
+        uint64_t now = PANTimestampNanosecondsNow();
+        int64_t delta = deadline > now ? (int64_t)(deadline - now) : 0;
+        dispatch_source_set_timer(_timer, dispatch_time(DISPATCH_TIME_NOW, delta), DISPATCH_TIME_FOREVER, timerLeewayNanoseconds);
+    }
+}
+
+@end
+
+
+PAN_ASSUME_NONNULL_END
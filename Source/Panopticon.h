@@ -8,10 +8,15 @@
 
 #import "PanopticonClass.h"
 #import "PANObservation.h"
+#import "PANObservationBag.h"
+#import "NSObject+PANObservation.h"
 #import "PANKeyValueObservation.h"
+#import "PANDerivedObservation.h"
+#import "PANKeyValueCollectionObservation.h"
 #import "Panopticon+PANKeyValue.h"
 #import "NSObject+PANKeyValue.h"
 #import "PANNotificationObservation.h"
+#import "PANNotificationHub.h"
 #import "Panopticon+PANNotification.h"
 #import "NSObject+PANNotification.h"
 #import "PANAppGroupObservation.h"
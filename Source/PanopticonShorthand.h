@@ -17,12 +17,18 @@
 
 #import "PanopticonClass.h"
 #import "PANObservation.h"
+#import "PANObservationBag.h"
 #import "PANObservation+Shorthand.h"
+#import "NSObject+PANObservation.h"
+#import "NSObject+PANObservationShorthand.h"
 #import "PANKeyValueObservation.h"
+#import "PANDerivedObservation.h"
+#import "PANKeyValueCollectionObservation.h"
 #import "Panopticon+PANKeyValue.h"
 #import "NSObject+PANKeyValue.h"
 #import "NSObject+PANKeyValueShorthand.h"
 #import "PANNotificationObservation.h"
+#import "PANNotificationHub.h"
 #import "Panopticon+PANNotification.h"
 #import "NSObject+PANNotification.h"
 #import "NSObject+PANNotificationShorthand.h"
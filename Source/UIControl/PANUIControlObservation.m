@@ -58,20 +58,26 @@ PAN_ASSUME_NONNULL_BEGIN
 - (void)registerInternal
 {
     NSAssert1(!self.registered, @"Attempted double-register of %@", self);
-    NSAssert1(self.object != nil, @"Nil 'object' property when registering observation for %@", self);
-    [(UIControl *)self.object addTarget:self action:@selector(action:forEvent:) forControlEvents:self.events];
+    NSAssert1(self.observee != nil, @"Nil 'observee' property when registering observation for %@", self);
+    [(UIControl *)self.observee addTarget:self action:@selector(action:forEvent:) forControlEvents:self.events];
 }
 
 - (void)action:(id)senderobj forEvent:(UIEvent *)uievent
 {
     //NSAssert3(senderobj == self.object, @"Action called with sender %@ doesn't match control %@ for %@", senderobj, self.object, self); -- i think this is ok to happen. if not, probably can remove the sender property
-    [self triggerWithSetupBlock:^(id<PANDetectedObservation> obs) {
-        if (![obs conformsToProtocol:@protocol(PANMutableUIControlEvent)])
-            return;
-        id<PANMutableUIControlEvent> ev = (id<PANMutableUIControlEvent>)obs;
-        ev.sender = senderobj;
-        ev.event = uievent;
-    }];
+    // the sender is the control as far as UIKit is concerned, so becomes both `object` and `sender`
+    PANObservationEvent ev = PANObservationEventMake(senderobj, nil, uievent);
+    [self triggerEvent:&ev synchronously:NO];
+}
+
+- (void)applyEvent:(const PANObservationEvent *)ev toDetectedObservation:(id<PANMutableDetectedObservation>)detectedObservation
+{
+    [super applyEvent:ev toDetectedObservation:detectedObservation];
+    if (![detectedObservation conformsToProtocol:@protocol(PANMutableUIControlEvent)])
+        return;
+    id<PANMutableUIControlEvent> controlEvent = (id<PANMutableUIControlEvent>)detectedObservation;
+    controlEvent.sender = ev->object;
+    controlEvent.event = ev->detail;
 }
 
 - (void)duplicateFrom:(id<PANDetectedObservation>)source
@@ -84,11 +90,17 @@ PAN_ASSUME_NONNULL_BEGIN
     self.event = ev.event;
 }
 
+- (void)configureSnapshot:(PANObservation *)snapshot
+{
+    ((PANUIControlObservation *)snapshot).events = self.events;
+    [super configureSnapshot:snapshot];
+}
+
 - (void)deregisterInternal
 {
     NSAssert1(self.registered, @"Attempted double-removal of %@", self);
-    NSAssert1(self.object != nil, @"Nil 'object' property when deregistering observation for %@", self);
-    [(UIControl *)self.object removeTarget:self action:@selector(action:forEvent:) forControlEvents:self.events];
+    // nil while being removed automatically as the control is deallocated, its targets go away with it
+    [(UIControl *)self.observee removeTarget:self action:@selector(action:forEvent:) forControlEvents:self.events];
 }
 
 + (BOOL)removeForObserver:(PAN_nullable id)observer control:(UIControl *)control events:(UIControlEvents)events
@@ -103,9 +115,12 @@ PAN_ASSUME_NONNULL_BEGIN
 
 + (PAN_nullable PANUIControlObservation *)findObservationForObserver:(PAN_nullable id)observer control:(UIControl *)control events:(UIControlEvents)events
 {
-    return (PANUIControlObservation *)[self findObservationForObserver:observer object:control matchingTest:^BOOL(PANObservation *obs) {
-        return [obs isKindOfClass:[PANUIControlObservation class]] && ((PANUIControlObservation *)obs).events == events;
-    }];
+    return (PANUIControlObservation *)[self findObservationForObserver:observer object:control indexSubkey:@(events)];
+}
+
+- (PAN_nullable id)indexSubkey
+{
+    return @(self.events);
 }
 
 - (NSString *)description
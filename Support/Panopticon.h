@@ -15,11 +15,16 @@ FOUNDATION_EXPORT double PanopticonVersionNumber;
 FOUNDATION_EXPORT const unsigned char PanopticonVersionString[];
 
 #import "PANObservation.h"
+#import "PANObservationBag.h"
+#import "NSObject+PANObservation.h"
 #import "PanopticonClass.h"
 #import "PANKeyValueObservation.h"
+#import "PANDerivedObservation.h"
+#import "PANKeyValueCollectionObservation.h"
 #import "Panopticon+PANKeyValue.h"
 #import "NSObject+PANKeyValue.h"
 #import "PANNotificationObservation.h"
+#import "PANNotificationHub.h"
 #import "Panopticon+PANNotification.h"
 #import "NSObject+PANNotification.h"
 #import "PANAppGroupObservation.h"